@@ -16,11 +16,14 @@
 //===----------------------------------------------------------------------===//
 
 #include "ClangTidy.h"
+#include "ClangTidyCache.h"
 #include "ClangTidyDiagnosticConsumer.h"
+#include "ClangTidyHistory.h"
 #include "ClangTidyModuleRegistry.h"
 #include "clang/AST/ASTConsumer.h"
 #include "clang/AST/ASTContext.h"
 #include "clang/AST/Decl.h"
+#include "clang/AST/DeclCXX.h"
 #include "clang/ASTMatchers/ASTMatchFinder.h"
 #include "clang/Frontend/ASTConsumers.h"
 #include "clang/Frontend/CompilerInstance.h"
@@ -28,6 +31,7 @@
 #include "clang/Frontend/FrontendDiagnostic.h"
 #include "clang/Frontend/MultiplexConsumer.h"
 #include "clang/Frontend/TextDiagnosticPrinter.h"
+#include "clang/Lex/Lexer.h"
 #include "clang/Lex/PPCallbacks.h"
 #include "clang/Lex/Preprocessor.h"
 #include "clang/Rewrite/Frontend/FixItRewriter.h"
@@ -36,9 +40,25 @@
 #include "clang/Tooling/Refactoring.h"
 #include "clang/Tooling/ReplacementsYaml.h"
 #include "clang/Tooling/Tooling.h"
+#include "llvm/ADT/Hashing.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/Support/Path.h"
 #include "llvm/Support/Process.h"
 #include "llvm/Support/Signals.h"
+#include "llvm/Support/ThreadPool.h"
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <iterator>
+#include <mutex>
+#include <numeric>
+#include <set>
+#include <thread>
+#include <tuple>
 #include <utility>
 
 using namespace clang::ast_matchers;
@@ -63,6 +83,16 @@ static const StringRef StaticAnalyzerChecks[] = {
 #undef GET_CHECKERS
 };
 
+/// \brief The names of \c StaticAnalyzerChecks as clang-tidy checks.
+static const StringRef StaticAnalyzerCheckNames[] = {
+#define GET_CHECKERS
+#define CHECKER(FULLNAME, CLASS, DESCFILE, HELPTEXT, GROUPINDEX, HIDDEN)       \
+  "clang-analyzer-" FULLNAME,
+#include "clang/StaticAnalyzer/Checkers/Checkers.inc"
+#undef CHECKER
+#undef GET_CHECKERS
+};
+
 class AnalyzerDiagnosticConsumer : public ento::PathDiagnosticConsumer {
 public:
   AnalyzerDiagnosticConsumer(ClangTidyContext &Context) : Context(Context) {}
@@ -93,10 +123,21 @@ private:
   ClangTidyContext &Context;
 };
 
+// Checks that insert the same #include directive each add it to the fix of
+// every diagnostic. The fixes are kept as they are, and identical insertions
+// are only merged when the fixes are applied or exported.
+static bool isIncludeInsertion(const tooling::Replacement &Replace) {
+  return Replace.getLength() == 0 &&
+         Replace.getReplacementText().startswith("#include");
+}
+
+/// \brief Displays errors reported in a single build directory and checks
+/// whether their fixes can be applied.
 class ErrorReporter {
 public:
-  ErrorReporter(bool ApplyFixes)
-      : Files(FileSystemOptions()), DiagOpts(new DiagnosticOptions()),
+  ErrorReporter(bool ApplyFixes, StringRef BuildDirectory)
+      : Files(getFileSystemOptions(BuildDirectory)),
+        DiagOpts(new DiagnosticOptions()),
         DiagPrinter(new TextDiagnosticPrinter(llvm::outs(), &*DiagOpts)),
         Diags(IntrusiveRefCntPtr<DiagnosticIDs>(new DiagnosticIDs), &*DiagOpts,
               DiagPrinter),
@@ -107,8 +148,6 @@ public:
     DiagPrinter->BeginSourceFile(LangOpts);
   }
 
-  SourceManager &getSourceManager() { return SourceMgr; }
-
   void reportDiagnostic(const ClangTidyError &Error) {
     const ClangTidyMessage &Message = Error.Message;
     SourceLocation Loc = getLocation(Message.FilePath, Message.FileOffset);
@@ -117,7 +156,7 @@ public:
     SmallVector<std::pair<SourceLocation, bool>, 4> FixLocations;
     {
       auto Level = static_cast<DiagnosticsEngine::Level>(Error.DiagLevel);
-      std::string Name = Error.CheckName;
+      std::string Name = Error.CheckName.str();
       if (Error.IsWarningAsError) {
         Name += ",-warnings-as-errors";
         Level = DiagnosticsEngine::Error;
@@ -131,8 +170,8 @@ public:
         // have valid file paths and are therefore not applicable.
         SourceRange Range;
         SourceLocation FixLoc;
+        SmallString<128> FixAbsoluteFilePath = Fix.getFilePath();
         if (Fix.isApplicable()) {
-          SmallString<128> FixAbsoluteFilePath = Fix.getFilePath();
           Files.makeAbsolutePath(FixAbsoluteFilePath);
           FixLoc = getLocation(FixAbsoluteFilePath, Fix.getOffset());
           SourceLocation FixEndLoc = FixLoc.getLocWithOffset(Fix.getLength());
@@ -142,9 +181,25 @@ public:
 
         ++TotalFixes;
         if (ApplyFixes) {
-          bool Success = Fix.isApplicable() && Fix.apply(Rewrite);
+          // The fix is only checked here. The checked fixes of all files are
+          // applied at the end. An #include inserted by an earlier fix is
+          // inserted once.
+          auto Key = std::make_tuple(FixAbsoluteFilePath.str().str(),
+                                     Fix.getOffset(),
+                                     Fix.getReplacementText().str());
+          bool AlreadyInserted =
+              isIncludeInsertion(Fix) && InsertedIncludes.count(Key);
+          bool Success = AlreadyInserted ||
+                         (Fix.isApplicable() && Fix.apply(Rewrite));
           if (Success)
             ++AppliedFixes;
+          if (Success && !AlreadyInserted) {
+            AppliedReplacements.emplace_back(
+                FixAbsoluteFilePath, Fix.getOffset(), Fix.getLength(),
+                Fix.getReplacementText());
+            if (isIncludeInsertion(Fix))
+              InsertedIncludes.insert(std::move(Key));
+          }
           FixLocations.push_back(std::make_pair(FixLoc, Success));
         }
       }
@@ -157,25 +212,38 @@ public:
       reportNote(Note);
   }
 
-  void Finish() {
-    // FIXME: Run clang-format on changes.
-    if (ApplyFixes && TotalFixes > 0) {
-      llvm::errs() << "clang-tidy applied " << AppliedFixes << " of "
-                   << TotalFixes << " suggested fixes.\n";
-      Rewrite.overwriteChangedFiles();
-    }
-  }
-
+  unsigned getTotalFixes() const { return TotalFixes; }
+  unsigned getAppliedFixes() const { return AppliedFixes; }
   unsigned getWarningsAsErrorsCount() const { return WarningsAsErrors; }
 
+  /// \brief The fixes that can be applied, with absolute file paths.
+  ArrayRef<tooling::Replacement> getAppliedReplacements() const {
+    return AppliedReplacements;
+  }
+
 private:
+  static FileSystemOptions getFileSystemOptions(StringRef WorkingDir) {
+    FileSystemOptions Options;
+    Options.WorkingDir = WorkingDir;
+    return Options;
+  }
+
   SourceLocation getLocation(StringRef FilePath, unsigned Offset) {
     if (FilePath.empty())
       return SourceLocation();
 
-    const FileEntry *File = SourceMgr.getFileManager().getFile(FilePath);
-    FileID ID = SourceMgr.createFileID(File, SourceLocation(), SrcMgr::C_User);
-    return SourceMgr.getLocForStartOfFile(ID).getLocWithOffset(Offset);
+    // Each file is loaded once, and shared with the fixes checked in Rewrite.
+    auto Cached = FileIDs.find(FilePath);
+    if (Cached == FileIDs.end()) {
+      FileID ID;
+      if (const FileEntry *File = SourceMgr.getFileManager().getFile(FilePath))
+        ID = SourceMgr.getOrCreateFileID(File, SrcMgr::C_User);
+      Cached = FileIDs.insert(std::make_pair(FilePath, ID)).first;
+    }
+    if (Cached->second.isInvalid())
+      return SourceLocation();
+    return SourceMgr.getLocForStartOfFile(Cached->second)
+        .getLocWithOffset(Offset);
   }
 
   void reportNote(const ClangTidyMessage &Message) {
@@ -191,34 +259,322 @@ private:
   DiagnosticConsumer *DiagPrinter;
   DiagnosticsEngine Diags;
   SourceManager SourceMgr;
+  llvm::StringMap<FileID> FileIDs;
   Rewriter Rewrite;
   bool ApplyFixes;
   unsigned TotalFixes;
   unsigned AppliedFixes;
   unsigned WarningsAsErrors;
+  std::vector<tooling::Replacement> AppliedReplacements;
+  std::set<std::tuple<std::string, unsigned, std::string>> InsertedIncludes;
 };
 
 class ClangTidyASTConsumer : public MultiplexConsumer {
 public:
+  /// \p Finder and \p Checks are the checks created for this translation unit
+  /// only. The reused checks record their times in \p CheckTimes, which is
+  /// moved to \p Profile after matching.
   ClangTidyASTConsumer(std::vector<std::unique_ptr<ASTConsumer>> Consumers,
                        std::unique_ptr<ast_matchers::MatchFinder> Finder,
-                       std::vector<std::unique_ptr<ClangTidyCheck>> Checks)
+                       std::vector<std::unique_ptr<ClangTidyCheck>> Checks,
+                       llvm::StringMap<llvm::TimeRecord> *CheckTimes,
+                       ClangTidyContext &Context, ProfileData *Profile)
       : MultiplexConsumer(std::move(Consumers)), Finder(std::move(Finder)),
-        Checks(std::move(Checks)) {}
+        Checks(std::move(Checks)), CheckTimes(CheckTimes), Context(Context),
+        Profile(Profile) {}
+
+  void HandleTranslationUnit(ASTContext &Ctx) override {
+    MultiplexConsumer::HandleTranslationUnit(Ctx);
+    // The AST and all source buffers are still alive at this point.
+    const SourceManager &Sources = Ctx.getSourceManager();
+    SourceManager::MemoryBufferSizes Buffers = Sources.getMemoryBufferSizes();
+    Context.setTranslationUnitMemory(
+        Ctx.getASTAllocatedMemory() + Ctx.getSideTableAllocatedMemory() +
+        Sources.getDataStructureSizes() + Buffers.malloc_bytes +
+        Buffers.mmap_bytes);
+    if (!Profile)
+      return;
+    if (CheckTimes) {
+      FileProfile *File = Profile->getCurrentFile();
+      llvm::StringMap<llvm::TimeRecord> &Records =
+          File ? File->Checks : Profile->Records;
+      for (const auto &Time : *CheckTimes)
+        Records[Time.getKey()] += Time.getValue();
+      CheckTimes->clear();
+    }
+    if (FileProfile *File = Profile->getCurrentFile())
+      File->Memory = Context.getTranslationUnitMemory();
+    Profile->startPhase("Diagnostics");
+  }
 
 private:
   std::unique_ptr<ast_matchers::MatchFinder> Finder;
   std::vector<std::unique_ptr<ClangTidyCheck>> Checks;
+  llvm::StringMap<llvm::TimeRecord> *CheckTimes;
+  ClangTidyContext &Context;
+  ProfileData *Profile;
 };
 
+/// \brief Starts a profiling phase when the wrapped consumer gets the whole
+/// translation unit.
+class ProfilingASTConsumer : public MultiplexConsumer {
+public:
+  ProfilingASTConsumer(std::vector<std::unique_ptr<ASTConsumer>> Consumer,
+                       StringRef Phase, ProfileData &Profile)
+      : MultiplexConsumer(std::move(Consumer)), Phase(Phase),
+        Profile(Profile) {}
+
+  void HandleTranslationUnit(ASTContext &Ctx) override {
+    Profile.startPhase(Phase);
+    MultiplexConsumer::HandleTranslationUnit(Ctx);
+  }
+
+private:
+  std::string Phase;
+  ProfileData &Profile;
+};
+
+/// \brief Runs the static analyzer only if the translation unit hasn't
+/// exceeded its time budget, with the cheaper limits of the analyzer's shallow
+/// mode if more than half of the budget has been spent before.
+class BudgetedAnalysisConsumer : public MultiplexConsumer {
+public:
+  BudgetedAnalysisConsumer(std::vector<std::unique_ptr<ASTConsumer>> Consumer,
+                           AnalyzerOptionsRef Options,
+                           ClangTidyContext &Context)
+      : MultiplexConsumer(std::move(Consumer)), Options(Options),
+        Context(Context) {}
+
+  void HandleTranslationUnit(ASTContext &Ctx) override {
+    if (Context.isTranslationUnitOverTimeBudget())
+      return;
+    double Budget = Context.getGlobalOptions().TranslationUnitTimeBudget;
+    double Elapsed = Context.getTranslationUnitTime();
+    if (Elapsed > Budget / 2) {
+      // The analysis manager reads these when the analysis starts.
+      Options->Config["mode"] = "shallow";
+      Options->Config["ipa"] = "inlining";
+      Options->Config["max-nodes"] = "75000";
+      Options->InlineMaxStackDepth = 2;
+      std::string Message;
+      llvm::raw_string_ostream OS(Message);
+      OS << "translation unit used " << llvm::format("%.2f", Elapsed)
+         << "s of its time budget of " << llvm::format("%.2f", Budget)
+         << "s before the static analyzer; running it with reduced limits";
+      Context.reportTimeBudget(OS.str());
+    }
+    MultiplexConsumer::HandleTranslationUnit(Ctx);
+  }
+
+private:
+  AnalyzerOptionsRef Options;
+  ClangTidyContext &Context;
+};
+
+/// \brief Passes only the declarations in code whose diagnostics can be
+/// displayed to the static analyzer, which explores paths from the functions
+/// among them. Functions defined elsewhere, e.g. in third-party headers, are
+/// still inlined into the analysis of their callers.
+class UserCodeAnalysisConsumer : public MultiplexConsumer {
+public:
+  UserCodeAnalysisConsumer(std::vector<std::unique_ptr<ASTConsumer>> Consumer,
+                           ClangTidyContext &Context)
+      : MultiplexConsumer(std::move(Consumer)), Context(Context) {}
+
+  bool HandleTopLevelDecl(DeclGroupRef DG) override {
+    bool Continue = true;
+    for (Decl *D : DG)
+      Continue = addRoots(D) && Continue;
+    return Continue;
+  }
+
+private:
+  bool addRoots(Decl *D) {
+    SourceRange Range = D->getSourceRange();
+    if (Range.getBegin().isValid() &&
+        (Context.isAnalyzedElsewhere(Range.getBegin()) ||
+         !Context.passesFilters(Range)))
+      return true;
+    // Look into namespaces and classes, so that only the functions of a file
+    // passing the line filter that contain changed lines become roots.
+    if (isa<NamespaceDecl>(D) || isa<LinkageSpecDecl>(D) ||
+        isa<CXXRecordDecl>(D)) {
+      bool Continue = true;
+      for (Decl *Member : cast<DeclContext>(D)->decls())
+        Continue = addRoots(Member) && Continue;
+      return Continue;
+    }
+    return MultiplexConsumer::HandleTopLevelDecl(DeclGroupRef(D));
+  }
+
+  ClangTidyContext &Context;
+};
+
+/// \brief Calls a function with the whole translation unit.
+class CallbackASTConsumer : public ASTConsumer {
+public:
+  CallbackASTConsumer(std::function<void(ASTContext &)> Callback)
+      : Callback(std::move(Callback)) {}
+
+  void HandleTranslationUnit(ASTContext &Ctx) override { Callback(Ctx); }
+
+private:
+  std::function<void(ASTContext &)> Callback;
+};
+
+// Returns Consumer, wrapped to be profiled as Phase if Profile is not null.
+static std::unique_ptr<ASTConsumer>
+profilePhase(std::unique_ptr<ASTConsumer> Consumer, StringRef Phase,
+             ProfileData *Profile) {
+  if (!Profile)
+    return Consumer;
+  std::vector<std::unique_ptr<ASTConsumer>> Consumers;
+  Consumers.push_back(std::move(Consumer));
+  return llvm::make_unique<ProfilingASTConsumer>(std::move(Consumers), Phase,
+                                                 *Profile);
+}
+
 } // namespace
 
+/// \brief Checks whose matchers run on a worker thread, see
+/// \c ClangTidyGlobalOptions::MatchThreads.
+struct ClangTidyASTConsumerFactory::MatchGroup {
+  std::unique_ptr<ast_matchers::MatchFinder> Finder;
+  std::vector<ClangTidyCheck *> Checks;
+  /// \brief Time spent in each check of the group in the current translation
+  /// unit, if profiling is enabled.
+  llvm::StringMap<llvm::TimeRecord> CheckTimes;
+};
+
+/// \brief The reusable checks of one configuration, with the \c MatchFinder
+/// they registered their matchers with.
+struct ClangTidyASTConsumerFactory::CheckSet {
+  /// \brief The options the checks were created with, which their
+  /// \c OptionsView refers to.
+  std::shared_ptr<const ClangTidyOptions> Options;
+  std::vector<std::unique_ptr<ClangTidyCheck>> Checks;
+  /// \brief The matchers of the checks that run on the main thread.
+  std::unique_ptr<ast_matchers::MatchFinder> Finder;
+  bool FinderHasMatchers;
+  /// \brief The other checks, if their matchers run on several threads.
+  std::vector<std::unique_ptr<MatchGroup>> Groups;
+  /// \brief The enabled checks that need a new instance for each translation
+  /// unit.
+  std::vector<std::string> PerTranslationUnitChecks;
+  /// \brief Time spent in each check of \c Finder in the current translation
+  /// unit, if profiling is enabled.
+  llvm::StringMap<llvm::TimeRecord> CheckTimes;
+  /// \brief The enabled static analyzer checkers.
+  CheckersList AnalyzerCheckers;
+};
+
+ClangTidyASTConsumerFactory::CheckSet &
+ClangTidyASTConsumerFactory::getCheckSet() {
+  // Checks read their options in the constructor and may register different
+  // matchers depending on the language options.
+  std::shared_ptr<const ClangTidyOptions> Options = Context.getSharedOptions();
+  if (Options != KeyOptions) {
+    KeyOptions = Options;
+    OptionsKey.clear();
+    llvm::raw_string_ostream OS(OptionsKey);
+    OS << Options->Checks.getValueOr("") << '\0';
+    for (const auto &Option : Options->CheckOptions)
+      OS << Option.first << '=' << Option.second << '\0';
+  }
+
+  // The language options change with each compile command, so they are hashed
+  // instead.
+  const LangOptions &LangOpts = Context.getLangOpts();
+  llvm::hash_code Hash =
+      llvm::hash_value(static_cast<bool>(Context.getCheckProfileData()));
+#define LANGOPT(Name, Bits, Default, Description)                              \
+  Hash = llvm::hash_combine(Hash, static_cast<unsigned>(LangOpts.Name));
+#define ENUM_LANGOPT(Name, Type, Bits, Default, Description)                   \
+  Hash = llvm::hash_combine(Hash, static_cast<unsigned>(LangOpts.get##Name()));
+#include "clang/Basic/LangOptions.def"
+
+  SmallString<256> Key(OptionsKey);
+  Key += llvm::utohexstr(static_cast<size_t>(Hash));
+  std::unique_ptr<CheckSet> &Set = CheckSets[Key];
+  if (Set)
+    return *Set;
+  Set.reset(new CheckSet);
+  Set->Options = std::move(Options);
+  Set->FinderHasMatchers = false;
+
+  bool Profiling = Context.getCheckProfileData();
+  auto CreateFinder = [Profiling](llvm::StringMap<llvm::TimeRecord> &Times) {
+    ast_matchers::MatchFinder::MatchFinderOptions FinderOptions;
+    if (Profiling)
+      FinderOptions.CheckProfiling.emplace(Times);
+    return llvm::make_unique<ast_matchers::MatchFinder>(
+        std::move(FinderOptions));
+  };
+  Set->Finder = CreateFinder(Set->CheckTimes);
+
+  unsigned MatchThreads = Context.getGlobalOptions().MatchThreads;
+  if (MatchThreads == 0)
+    MatchThreads = std::thread::hardware_concurrency();
+  if (MatchThreads > 1) {
+    for (unsigned I = 0; I < MatchThreads; ++I) {
+      Set->Groups.emplace_back(new MatchGroup);
+      Set->Groups.back()->Finder = CreateFinder(Set->Groups.back()->CheckTimes);
+    }
+  }
+
+  GlobList &Filter = Context.getChecksFilter();
+  Set->AnalyzerCheckers = getCheckersControlList(Filter);
+  loadModules(Filter);
+  unsigned GroupedChecks = 0;
+  for (const auto &Factory : *CheckFactories) {
+    if (!Filter.contains(Factory.first))
+      continue;
+    std::unique_ptr<ClangTidyCheck> Check(
+        Factory.second(Factory.first, &Context));
+    if (!Check->isReusable()) {
+      Set->PerTranslationUnitChecks.push_back(Factory.first);
+      continue;
+    }
+    if (!Set->Groups.empty() && Check->canMatchConcurrently()) {
+      // Spread the checks over the groups in the order of their names.
+      MatchGroup &Group = *Set->Groups[GroupedChecks++ % Set->Groups.size()];
+      Check->registerMatchers(&*Group.Finder);
+      Group.Checks.push_back(&*Check);
+    } else {
+      Check->registerMatchers(&*Set->Finder);
+      Set->FinderHasMatchers = true;
+    }
+    Set->Checks.push_back(std::move(Check));
+  }
+  // Matching a group without checks would still traverse the whole AST.
+  Set->Groups.erase(std::remove_if(Set->Groups.begin(), Set->Groups.end(),
+                                   [](const std::unique_ptr<MatchGroup> &G) {
+                                     return G->Checks.empty();
+                                   }),
+                    Set->Groups.end());
+  return *Set;
+}
+
 ClangTidyASTConsumerFactory::ClangTidyASTConsumerFactory(
     ClangTidyContext &Context)
-    : Context(Context), CheckFactories(new ClangTidyCheckFactories) {
+    : Context(Context), CheckFactories(new ClangTidyCheckFactories),
+      ChecksNeedWholePreprocessorStream(false), PreambleInclusions(nullptr) {}
+
+ClangTidyASTConsumerFactory::~ClangTidyASTConsumerFactory() {}
+
+void ClangTidyASTConsumerFactory::loadModules(const GlobList &Filter) {
   for (ClangTidyModuleRegistry::iterator I = ClangTidyModuleRegistry::begin(),
                                          E = ClangTidyModuleRegistry::end();
        I != E; ++I) {
+    StringRef Name = I->getName();
+    if (LoadedModules.count(Name))
+      continue;
+    // Modules named "<prefix>-module" only provide checks named
+    // "<prefix>-...", so they are only needed if such a check can be enabled.
+    if (Name.endswith("-module") &&
+        !Filter.mayContainPrefix(Name.drop_back(strlen("module"))))
+      continue;
+    LoadedModules.insert(Name);
     std::unique_ptr<ClangTidyModule> Module(I->instantiate());
     Module->addCheckFactories(*CheckFactories);
   }
@@ -235,6 +591,38 @@ static void setStaticAnalyzerCheckerOpts(const ClangTidyOptions &Opts,
   }
 }
 
+// Passes the inclusion directives of the precompiled preamble of the main file,
+// which the preprocessor skips, to the PPCallbacks of the preprocessor.
+static void
+replayPreambleInclusions(CompilerInstance &Compiler,
+                         ArrayRef<PreambleInclusion> Inclusions) {
+  Preprocessor &PP = Compiler.getPreprocessor();
+  PPCallbacks *Callbacks = PP.getPPCallbacks();
+  const SourceManager &Sources = Compiler.getSourceManager();
+  SourceLocation Start = Sources.getLocForStartOfFile(Sources.getMainFileID());
+  for (const PreambleInclusion &Inclusion : Inclusions) {
+    Token Keyword;
+    Keyword.startToken();
+    Keyword.setKind(tok::identifier);
+    Keyword.setIdentifierInfo(PP.getIdentifierInfo(Inclusion.Keyword));
+    Keyword.setLocation(Start.getLocWithOffset(Inclusion.KeywordOffset));
+    Keyword.setLength(Inclusion.Keyword.size());
+    CharSourceRange FileNameRange(
+        SourceRange(Start.getLocWithOffset(Inclusion.FileNameBegin),
+                    Start.getLocWithOffset(Inclusion.FileNameEnd)),
+        Inclusion.FileNameIsTokenRange);
+    const FileEntry *File = Inclusion.File.empty()
+                                ? nullptr
+                                : Compiler.getFileManager().getFile(
+                                      Inclusion.File);
+    Callbacks->InclusionDirective(
+        Start.getLocWithOffset(Inclusion.HashOffset), Keyword,
+        Inclusion.FileName, Inclusion.IsAngled, FileNameRange, File,
+        Inclusion.SearchPath, Inclusion.RelativePath,
+        /*Imported=*/nullptr);
+  }
+}
+
 std::unique_ptr<clang::ASTConsumer>
 ClangTidyASTConsumerFactory::CreateASTConsumer(
     clang::CompilerInstance &Compiler, StringRef File) {
@@ -244,31 +632,74 @@ ClangTidyASTConsumerFactory::CreateASTConsumer(
   Context.setCurrentFile(File);
   Context.setASTContext(&Compiler.getASTContext());
 
-  auto WorkingDir = Compiler.getSourceManager()
-                        .getFileManager()
-                        .getVirtualFileSystem()
-                        ->getCurrentWorkingDirectory();
-  if (WorkingDir)
-    Context.setCurrentBuildDirectory(WorkingDir.get());
-
-  std::vector<std::unique_ptr<ClangTidyCheck>> Checks;
-  CheckFactories->createChecks(&Context, Checks);
-
-  ast_matchers::MatchFinder::MatchFinderOptions FinderOptions;
-  if (auto *P = Context.getCheckProfileData())
-    FinderOptions.CheckProfiling.emplace(P->Records);
+  // Parallel runs don't change the process working directory, but pass the
+  // build directory with -working-directory instead.
+  StringRef BuildDirectory = Compiler.getFileSystemOpts().WorkingDir;
+  if (!BuildDirectory.empty()) {
+    Context.setCurrentBuildDirectory(BuildDirectory);
+  } else {
+    auto WorkingDir = Compiler.getSourceManager()
+                          .getFileManager()
+                          .getVirtualFileSystem()
+                          ->getCurrentWorkingDirectory();
+    if (WorkingDir)
+      Context.setCurrentBuildDirectory(WorkingDir.get());
+  }
 
-  std::unique_ptr<ast_matchers::MatchFinder> Finder(
-      new ast_matchers::MatchFinder(std::move(FinderOptions)));
+  CheckSet &Set = getCheckSet();
+  ProfileData *Profile = Context.getCheckProfileData();
 
-  for (auto &Check : Checks) {
-    Check->registerMatchers(&*Finder);
-    Check->registerPPCallbacks(Compiler);
+  // Checks that can't be reused get their own MatchFinder.
+  std::vector<std::unique_ptr<ClangTidyCheck>> Checks;
+  std::unique_ptr<ast_matchers::MatchFinder> Finder;
+  if (!Set.PerTranslationUnitChecks.empty()) {
+    ast_matchers::MatchFinder::MatchFinderOptions FinderOptions;
+    if (Profile) {
+      FileProfile *File = Profile->getCurrentFile();
+      FinderOptions.CheckProfiling.emplace(File ? File->Checks
+                                                : Profile->Records);
+    }
+    Finder.reset(new ast_matchers::MatchFinder(std::move(FinderOptions)));
+    for (const std::string &Name : Set.PerTranslationUnitChecks) {
+      Checks.push_back(CheckFactories->createCheck(Name, &Context));
+      Checks.back()->registerMatchers(&*Finder);
+    }
   }
 
+  Preprocessor &PP = Compiler.getPreprocessor();
+  PPCallbacks *OtherCallbacks = PP.getPPCallbacks();
+  ChecksNeedWholePreprocessorStream = false;
+  auto RegisterPPCallbacks = [&](ClangTidyCheck &Check) {
+    PPCallbacks *Callbacks = PP.getPPCallbacks();
+    Check.registerPPCallbacks(Compiler);
+    // Adding callbacks replaces them with a chain.
+    if (PP.getPPCallbacks() != Callbacks &&
+        Check.needsWholePreprocessorStream())
+      ChecksNeedWholePreprocessorStream = true;
+  };
+  for (auto &Check : Set.Checks)
+    RegisterPPCallbacks(*Check);
+  for (auto &Check : Checks)
+    RegisterPPCallbacks(*Check);
+  if (PreambleInclusions && PP.getPPCallbacks() != OtherCallbacks)
+    replayPreambleInclusions(Compiler, *PreambleInclusions);
+
   std::vector<std::unique_ptr<ASTConsumer>> Consumers;
-  if (!Checks.empty())
-    Consumers.push_back(Finder->newASTConsumer());
+  std::vector<std::unique_ptr<ASTConsumer>> MatchConsumers;
+  if (!Set.Groups.empty())
+    MatchConsumers.push_back(llvm::make_unique<CallbackASTConsumer>(
+        [this, &Set](ASTContext &Ctx) { matchGroups(Set, Ctx); }));
+  if (Set.FinderHasMatchers)
+    MatchConsumers.push_back(Set.Finder->newASTConsumer());
+  if (Finder)
+    MatchConsumers.push_back(Finder->newASTConsumer());
+  if (MatchConsumers.size() == 1)
+    Consumers.push_back(
+        profilePhase(std::move(MatchConsumers.front()), "Matching", Profile));
+  else if (!MatchConsumers.empty())
+    Consumers.push_back(profilePhase(
+        llvm::make_unique<MultiplexConsumer>(std::move(MatchConsumers)),
+        "Matching", Profile));
 
   AnalyzerOptionsRef AnalyzerOptions = Compiler.getAnalyzerOpts();
   // FIXME: Remove this option once clang's cfg-temporary-dtors option defaults
@@ -276,8 +707,7 @@ ClangTidyASTConsumerFactory::CreateASTConsumer(
   AnalyzerOptions->Config["cfg-temporary-dtors"] =
       Context.getOptions().AnalyzeTemporaryDtors ? "true" : "false";
 
-  GlobList &Filter = Context.getChecksFilter();
-  AnalyzerOptions->CheckersControlList = getCheckersControlList(Filter);
+  AnalyzerOptions->CheckersControlList = Set.AnalyzerCheckers;
   if (!AnalyzerOptions->CheckersControlList.empty()) {
     setStaticAnalyzerCheckerOpts(Context.getOptions(), AnalyzerOptions);
     AnalyzerOptions->AnalysisStoreOpt = RegionStoreModel;
@@ -288,15 +718,93 @@ ClangTidyASTConsumerFactory::CreateASTConsumer(
         ento::CreateAnalysisConsumer(Compiler);
     AnalysisConsumer->AddDiagnosticConsumer(
         new AnalyzerDiagnosticConsumer(Context));
-    Consumers.push_back(std::move(AnalysisConsumer));
+    std::unique_ptr<ASTConsumer> Analysis = std::move(AnalysisConsumer);
+    // Restricting the roots is the default when filtered code isn't analyzed
+    // by the other checks either.
+    if (AnalyzerOptions->getBooleanOption(
+            "user-code-roots", Context.getGlobalOptions().PruneFilteredCode)) {
+      std::vector<std::unique_ptr<ASTConsumer>> Wrapped;
+      Wrapped.push_back(std::move(Analysis));
+      Analysis = llvm::make_unique<UserCodeAnalysisConsumer>(std::move(Wrapped),
+                                                             Context);
+    }
+    if (Context.getGlobalOptions().TranslationUnitTimeBudget > 0) {
+      std::vector<std::unique_ptr<ASTConsumer>> Wrapped;
+      Wrapped.push_back(std::move(Analysis));
+      Analysis = llvm::make_unique<BudgetedAnalysisConsumer>(
+          std::move(Wrapped), AnalyzerOptions, Context);
+    }
+    Consumers.push_back(
+        profilePhase(std::move(Analysis), "Static analyzer", Profile));
   }
   return llvm::make_unique<ClangTidyASTConsumer>(
-      std::move(Consumers), std::move(Finder), std::move(Checks));
+      std::move(Consumers), std::move(Finder), std::move(Checks),
+      Profile && !Set.Checks.empty() ? &Set.CheckTimes : nullptr, Context,
+      Profile);
+}
+
+void ClangTidyASTConsumerFactory::matchGroups(CheckSet &Set,
+                                              ASTContext &Ctx) {
+  // Declarations from an external source, like a precompiled preamble, are
+  // loaded lazily while matching, which isn't thread-safe. Such translation
+  // units are matched a group at a time.
+  if (Ctx.getExternalSource()) {
+    for (const auto &Group : Set.Groups)
+      Group->Finder->matchAST(Ctx);
+  } else {
+    // The parent map used by hasParent() and hasAncestor() is built on first
+    // use. Build it before the threads share it.
+    Ctx.getParents(*Ctx.getTranslationUnitDecl());
+    for (const auto &Group : Set.Groups)
+      for (ClangTidyCheck *Check : Group->Checks)
+        Check->RecordMatches = true;
+    {
+      llvm::ThreadPool Pool(Set.Groups.size());
+      for (const auto &Group : Set.Groups) {
+        ast_matchers::MatchFinder *Finder = &*Group->Finder;
+        Pool.async([Finder, &Ctx] { Finder->matchAST(Ctx); });
+      }
+      Pool.wait();
+    }
+
+    // Each check sees its matches in traversal order, but the diagnostics of
+    // different checks are reported one check after another. The errors end up
+    // in the same order as with a single traversal only because
+    // ClangTidyDiagnosticConsumer::finish() sorts them.
+    bool Profiling = Context.getCheckProfileData();
+    for (const auto &Group : Set.Groups) {
+      for (ClangTidyCheck *Check : Group->Checks) {
+        Check->RecordMatches = false;
+        std::vector<ast_matchers::MatchFinder::MatchResult> Matches;
+        Matches.swap(Check->RecordedMatches);
+        llvm::TimeRecord Start;
+        if (Profiling)
+          Start = llvm::TimeRecord::getCurrentTime(/*Start=*/true);
+        for (const auto &Match : Matches)
+          Check->run(Match);
+        if (Profiling) {
+          llvm::TimeRecord Time =
+              llvm::TimeRecord::getCurrentTime(/*Start=*/false);
+          Time -= Start;
+          Group->CheckTimes[Check->getID()] += Time;
+        }
+      }
+    }
+  }
+
+  if (Context.getCheckProfileData()) {
+    for (const auto &Group : Set.Groups) {
+      for (const auto &Time : Group->CheckTimes)
+        Set.CheckTimes[Time.getKey()] += Time.getValue();
+      Group->CheckTimes.clear();
+    }
+  }
 }
 
 std::vector<std::string> ClangTidyASTConsumerFactory::getCheckNames() {
   std::vector<std::string> CheckNames;
   GlobList &Filter = Context.getChecksFilter();
+  loadModules(Filter);
   for (const auto &CheckFactory : *CheckFactories) {
     if (Filter.contains(CheckFactory.first))
       CheckNames.push_back(CheckFactory.first);
@@ -312,6 +820,7 @@ std::vector<std::string> ClangTidyASTConsumerFactory::getCheckNames() {
 ClangTidyOptions::OptionMap ClangTidyASTConsumerFactory::getCheckOptions() {
   ClangTidyOptions::OptionMap Options;
   std::vector<std::unique_ptr<ClangTidyCheck>> Checks;
+  loadModules(Context.getChecksFilter());
   CheckFactories->createChecks(&Context, Checks);
   for (const auto &Check : Checks)
     Check->storeOptions(Options);
@@ -321,28 +830,28 @@ ClangTidyOptions::OptionMap ClangTidyASTConsumerFactory::getCheckOptions() {
 ClangTidyASTConsumerFactory::CheckersList
 ClangTidyASTConsumerFactory::getCheckersControlList(GlobList &Filter) {
   CheckersList List;
-
+  if (!Filter.mayContainPrefix(AnalyzerCheckNamePrefix))
+    return List;
+
+  // Run our regex against all possible static analyzer checkers.  Note that
+  // debug checkers print values / run programs to visualize the CFG and are
+  // thus not applicable to clang-tidy in general.
+  const size_t NumCheckers = llvm::array_lengthof(StaticAnalyzerChecks);
+  std::vector<char> Enabled(NumCheckers);
   bool AnalyzerChecksEnabled = false;
-  for (StringRef CheckName : StaticAnalyzerChecks) {
-    std::string Checker((AnalyzerCheckNamePrefix + CheckName).str());
-    AnalyzerChecksEnabled =
-        AnalyzerChecksEnabled ||
-        (!CheckName.startswith("debug") && Filter.contains(Checker));
+  for (size_t I = 0; I < NumCheckers; ++I) {
+    Enabled[I] = !StaticAnalyzerChecks[I].startswith("debug") &&
+                 Filter.contains(StaticAnalyzerCheckNames[I]);
+    AnalyzerChecksEnabled = AnalyzerChecksEnabled || Enabled[I];
   }
 
   if (AnalyzerChecksEnabled) {
-    // Run our regex against all possible static analyzer checkers.  Note that
-    // debug checkers print values / run programs to visualize the CFG and are
-    // thus not applicable to clang-tidy in general.
-    //
     // Always add all core checkers if any other static analyzer checks are
     // enabled. This is currently necessary, as other path sensitive checks
     // rely on the core checkers.
-    for (StringRef CheckName : StaticAnalyzerChecks) {
-      std::string Checker((AnalyzerCheckNamePrefix + CheckName).str());
-
-      if (CheckName.startswith("core") ||
-          (!CheckName.startswith("debug") && Filter.contains(Checker)))
+    for (size_t I = 0; I < NumCheckers; ++I) {
+      StringRef CheckName = StaticAnalyzerChecks[I];
+      if (CheckName.startswith("core") || Enabled[I])
         List.push_back(std::make_pair(CheckName, true));
     }
   }
@@ -354,9 +863,43 @@ DiagnosticBuilder ClangTidyCheck::diag(SourceLocation Loc, StringRef Message,
   return Context->diag(CheckName, Loc, Message, Level);
 }
 
+// Returns true if none of the nodes bound by a match is in the analysis scope
+// of the current translation unit.
+static bool isMatchOutOfScope(ClangTidyContext &Context,
+                              const BoundNodes &Nodes) {
+  bool HasLocation = false;
+  for (const auto &Node : Nodes.getMap()) {
+    SourceRange Range = Node.second.getSourceRange();
+    if (Range.getBegin().isInvalid())
+      continue;
+    if (Context.isInAnalysisScope(Range))
+      return false;
+    HasLocation = true;
+  }
+  return HasLocation;
+}
+
 void ClangTidyCheck::run(const ast_matchers::MatchFinder::MatchResult &Result) {
+  // Matches found on a worker thread are checked on the main thread later.
+  if (RecordMatches) {
+    RecordedMatches.push_back(Result);
+    return;
+  }
   Context->setSourceManager(Result.SourceManager);
+  if (!requiresWholeTranslationUnit() &&
+      isMatchOutOfScope(*Context, Result.Nodes))
+    return;
+  if (!Context->hasTimeBudgets()) {
+    check(Result);
+    return;
+  }
+  if (Context->isOverTimeBudget(CheckName))
+    return;
+  auto Start = std::chrono::steady_clock::now();
   check(Result);
+  Context->addCheckTime(
+      CheckName, std::chrono::duration<double>(
+                     std::chrono::steady_clock::now() - Start).count());
 }
 
 OptionsView::OptionsView(StringRef CheckName,
@@ -408,46 +951,660 @@ ClangTidyOptions::OptionMap getCheckOptions(const ClangTidyOptions &Options) {
   return Factory.getCheckOptions();
 }
 
+namespace {
+/// \brief Passes errors to a \c ClangTidyErrorSink, optionally removing the
+/// ones already passed on for a previous file, e.g. for a header included in
+/// several translation units.
+class ErrorEmitter {
+public:
+  /// \brief If \p Profile is not null, the time spent in \p Sink is added to
+  /// its \c Rendering time. Calls to \c emit must be serialized.
+  ErrorEmitter(ClangTidyErrorSink &Sink, ProfileData *Profile,
+               bool Deduplicate)
+      : Sink(Sink), Profile(Profile), Deduplicate(Deduplicate) {}
+
+  void emit(std::vector<ClangTidyError> &Errors) {
+    auto IsDuplicate = [this](const ClangTidyError &Error) {
+      const ClangTidyMessage &M = Error.Message;
+      return !Seen.insert(std::make_tuple(M.FilePath, M.FileOffset,
+                                          Error.CheckName, M.Message))
+                  .second;
+    };
+    if (Deduplicate)
+      Errors.erase(std::remove_if(Errors.begin(), Errors.end(), IsDuplicate),
+                   Errors.end());
+    if (Errors.empty())
+      return;
+    if (!Profile) {
+      Sink.handleErrors(Errors);
+      return;
+    }
+    TimeRecord Time = TimeRecord::getCurrentTime(true);
+    Sink.handleErrors(Errors);
+    TimeRecord End = TimeRecord::getCurrentTime(false);
+    End -= Time;
+    Profile->Rendering += End;
+  }
+
+private:
+  ClangTidyErrorSink &Sink;
+  ProfileData *Profile;
+  bool Deduplicate;
+  /// \brief The location, check name and message of the errors passed on so
+  /// far, if \c Deduplicate is set.
+  std::set<std::tuple<InternedString, unsigned, InternedString, std::string>>
+      Seen;
+};
+
+/// \brief Forwards all requests to a shared \c ClangTidyOptionsProvider while
+/// holding a lock, so that several \c ClangTidyContexts running on different
+/// threads can use the same (caching) provider.
+class LockedOptionsProvider : public ClangTidyOptionsProvider {
+public:
+  LockedOptionsProvider(ClangTidyOptionsProvider &Provider, std::mutex &Mutex)
+      : Provider(Provider), Mutex(Mutex) {}
+
+  const ClangTidyGlobalOptions &getGlobalOptions() override {
+    std::lock_guard<std::mutex> Lock(Mutex);
+    return Provider.getGlobalOptions();
+  }
+
+  std::vector<OptionsSource> getRawOptions(StringRef FileName) override {
+    std::lock_guard<std::mutex> Lock(Mutex);
+    return Provider.getRawOptions(FileName);
+  }
+
+  std::shared_ptr<const ClangTidyOptions>
+  getMergedOptions(StringRef FileName) override {
+    std::lock_guard<std::mutex> Lock(Mutex);
+    return Provider.getMergedOptions(FileName);
+  }
+
+  void refresh() override {
+    std::lock_guard<std::mutex> Lock(Mutex);
+    Provider.refresh();
+  }
+
+private:
+  ClangTidyOptionsProvider &Provider;
+  std::mutex &Mutex;
+};
+
+class ClangTidyActionFactory : public FrontendActionFactory {
+public:
+  ClangTidyActionFactory(ClangTidyContext &Context)
+      : Context(Context), ConsumerFactory(Context), Dependencies(nullptr),
+        Emitter(nullptr) {}
+  FrontendAction *create() override {
+    return new Action(&ConsumerFactory, Dependencies);
+  }
+
+  /// \brief If \p Deps is not null, the files read by subsequently created
+  /// actions are appended to \p Deps.
+  void setDependencies(std::vector<ClangTidyCache::Dependency> *Deps) {
+    Dependencies = Deps;
+  }
+
+  /// \brief If \p Emitter is not null, the errors of each translation unit
+  /// are passed to it and removed from the context as soon as it is processed.
+  void setErrorEmitter(ErrorEmitter *Emitter) { this->Emitter = Emitter; }
+
+  ClangTidyASTConsumerFactory &getConsumerFactory() {
+    return ConsumerFactory;
+  }
+
+  bool runInvocation(CompilerInvocation *Invocation, FileManager *Files,
+                     std::shared_ptr<PCHContainerOperations> PCHContainerOps,
+                     DiagnosticConsumer *DiagConsumer) override {
+    ProfileData *Profile = Context.getCheckProfileData();
+    const auto &Inputs = Invocation->getFrontendOpts().Inputs;
+    if (Profile)
+      Profile->startFile(Inputs.empty() ? "" : Inputs[0].getFile());
+    bool Success = FrontendActionFactory::runInvocation(
+        Invocation, Files, std::move(PCHContainerOps), DiagConsumer);
+    if (Profile)
+      Profile->finishFile();
+    // The headers of a translation unit that failed may not have been analyzed
+    // completely.
+    Context.endHeaderClaims(Success);
+    // The diagnostic consumer has stored the errors in finish().
+    if (Emitter) {
+      std::vector<ClangTidyError> Errors = Context.takeErrors();
+      Emitter->emit(Errors);
+    }
+    return Success;
+  }
+
+private:
+  class Action : public ASTFrontendAction {
+  public:
+    Action(ClangTidyASTConsumerFactory *Factory,
+           std::vector<ClangTidyCache::Dependency> *Dependencies)
+        : Factory(Factory), Dependencies(Dependencies) {}
+    std::unique_ptr<ASTConsumer> CreateASTConsumer(CompilerInstance &Compiler,
+                                                   StringRef File) override {
+      return Factory->CreateASTConsumer(Compiler, File);
+    }
+
+  protected:
+    void EndSourceFileAction() override {
+      if (Dependencies)
+        ClangTidyCache::collectDependencies(
+            getCompilerInstance().getSourceManager(),
+            getCompilerInstance().getFileSystemOpts().WorkingDir,
+            *Dependencies);
+    }
+
+  private:
+    ClangTidyASTConsumerFactory *Factory;
+    std::vector<ClangTidyCache::Dependency> *Dependencies;
+  };
+
+  ClangTidyContext &Context;
+  ClangTidyASTConsumerFactory ConsumerFactory;
+  std::vector<ClangTidyCache::Dependency> *Dependencies;
+  ErrorEmitter *Emitter;
+};
+
+/// \brief Creates actions that only preprocess the main file and append the
+/// files read to a list.
+class IncludeScannerActionFactory : public FrontendActionFactory {
+public:
+  IncludeScannerActionFactory(std::vector<ClangTidyCache::Dependency> &Deps)
+      : Dependencies(Deps) {}
+  FrontendAction *create() override { return new Action(Dependencies); }
+
+private:
+  class Action : public PreprocessOnlyAction {
+  public:
+    Action(std::vector<ClangTidyCache::Dependency> &Dependencies)
+        : Dependencies(Dependencies) {}
+
+  protected:
+    void EndSourceFileAction() override {
+      ClangTidyCache::collectDependencies(
+          getCompilerInstance().getSourceManager(),
+          getCompilerInstance().getFileSystemOpts().WorkingDir, Dependencies);
+    }
+
+  private:
+    std::vector<ClangTidyCache::Dependency> &Dependencies;
+  };
+
+  std::vector<ClangTidyCache::Dependency> &Dependencies;
+};
+
+/// \brief The state owned by each thread of a parallel clang-tidy run.
+struct ClangTidyWorker {
+  ClangTidyWorker(std::unique_ptr<ClangTidyOptionsProvider> OptionsProvider,
+                  ProfileData *Profile, const ClangTidyCache *Cache,
+                  AnalyzedHeaderRegistry *AnalyzedHeaders)
+      : Context(std::move(OptionsProvider)), DiagConsumer(Context),
+        Factory(Context), Cache(Cache), History(nullptr) {
+    if (Profile)
+      Context.setCheckProfileData(&this->Profile);
+    Context.setAnalyzedHeaderRegistry(AnalyzedHeaders);
+  }
+
+  ClangTidyContext Context;
+  ClangTidyDiagnosticConsumer DiagConsumer;
+  ClangTidyActionFactory Factory;
+  const ClangTidyCache *Cache;
+  /// \brief Receives the cost of each processed file, if not \c nullptr.
+  ClangTidyHistory *History;
+  ProfileData Profile;
+  /// \brief Counters of all files processed by this worker.
+  ClangTidyStats Stats;
+};
+
+/// \brief Limits the estimated memory of the files processed at the same time.
+///
+/// A file is always admitted when nothing else is running, so files larger
+/// than the limit are processed alone rather than never.
+class MemoryAdmission {
+public:
+  explicit MemoryAdmission(uint64_t Limit) : Limit(Limit), InUse(0) {}
+
+  void acquire(uint64_t Bytes) {
+    std::unique_lock<std::mutex> Lock(Mutex);
+    Released.wait(Lock,
+                  [&] { return InUse == 0 || InUse + Bytes <= Limit; });
+    InUse += Bytes;
+  }
+
+  void release(uint64_t Bytes) {
+    {
+      std::lock_guard<std::mutex> Lock(Mutex);
+      InUse -= Bytes;
+    }
+    Released.notify_all();
+  }
+
+private:
+  const uint64_t Limit;
+  uint64_t InUse;
+  std::mutex Mutex;
+  std::condition_variable Released;
+};
+} // namespace
+
+// Add extra arguments passed by the clang-tidy command-line.
+static ArgumentsAdjuster
+getPerFileExtraArgumentsInserter(ClangTidyContext &Context) {
+  return [&Context](const CommandLineArguments &Args, StringRef Filename) {
+    std::shared_ptr<const ClangTidyOptions> Opts =
+        Context.getOptionsForFile(Filename);
+    CommandLineArguments AdjustedArgs;
+    if (Opts->ExtraArgsBefore)
+      AdjustedArgs = *Opts->ExtraArgsBefore;
+    AdjustedArgs.insert(AdjustedArgs.begin(), Args.begin(), Args.end());
+    if (Opts->ExtraArgs)
+      AdjustedArgs.insert(AdjustedArgs.end(), Opts->ExtraArgs->begin(),
+                          Opts->ExtraArgs->end());
+    return AdjustedArgs;
+  };
+}
+
+// Remove plugins arguments.
+static ArgumentsAdjuster getPluginArgumentsRemover() {
+  return [](const CommandLineArguments &Args, StringRef Filename) {
+    CommandLineArguments AdjustedArgs;
+    for (size_t I = 0, E = Args.size(); I < E; ++I) {
+      if (I + 4 < Args.size() && Args[I] == "-Xclang" &&
+          (Args[I + 1] == "-load" || Args[I + 1] == "-add-plugin" ||
+           StringRef(Args[I + 1]).startswith("-plugin-arg-")) &&
+          Args[I + 2] == "-Xclang") {
+        I += 3;
+      } else
+        AdjustedArgs.push_back(Args[I]);
+    }
+    return AdjustedArgs;
+  };
+}
+
+static std::string getMainExecutable() {
+  // Exists solely for the purpose of lookup of the resource path, see
+  // ClangTool::run.
+  static int StaticSymbol;
+  return llvm::sys::fs::getMainExecutable("clang_tool", &StaticSymbol);
+}
+
+/// \brief Returns the compile commands for \p File, or an empty list after
+/// reporting an error. \p AbsolutePath is set to the absolute path of \p File.
+static std::vector<CompileCommand>
+getCompileCommands(const CompilationDatabase &Compilations, StringRef File,
+                   SmallVectorImpl<char> &AbsolutePath) {
+  AbsolutePath.assign(File.begin(), File.end());
+  if (std::error_code EC = llvm::sys::fs::make_absolute(AbsolutePath)) {
+    llvm::errs() << "Can't make absolute path from " << File << ": "
+                 << EC.message() << "\n";
+    return std::vector<CompileCommand>();
+  }
+  StringRef Path(AbsolutePath.data(), AbsolutePath.size());
+  std::vector<CompileCommand> Commands = Compilations.getCompileCommands(Path);
+  if (Commands.empty())
+    llvm::errs() << "Skipping " << Path << ". Compile command not found.\n";
+  return Commands;
+}
+
+/// \brief Returns the arguments clang-tidy runs \p Command with, including
+/// -working-directory so that they don't depend on the current directory.
+static CommandLineArguments getAdjustedArguments(ClangTidyContext &Context,
+                                                 const CompileCommand &Command,
+                                                 StringRef MainExecutable) {
+  ArgumentsAdjuster Adjuster = combineAdjusters(
+      combineAdjusters(getClangStripOutputAdjuster(),
+                       getClangSyntaxOnlyAdjuster()),
+      combineAdjusters(getPerFileExtraArgumentsInserter(Context),
+                       getPluginArgumentsRemover()));
+  CommandLineArguments Args = Adjuster(Command.CommandLine, Command.Filename);
+  assert(!Args.empty());
+  Args[0] = MainExecutable;
+  Args.insert(Args.begin() + 1, "-working-directory=" + Command.Directory);
+  return Args;
+}
+
+/// \brief Runs clang-tidy on all compile commands of \p File and appends the
+/// resulting errors to \p Errors.
+///
+/// Unlike \c ClangTool::run this never changes the working directory of the
+/// process (which is thread hostile). Instead relative paths are resolved
+/// against the build directory of each compile command using
+/// -working-directory, so this function can be called from several threads.
+static bool runOnFile(const CompilationDatabase &Compilations, StringRef File,
+                      ClangTidyWorker &Worker,
+                      std::vector<ClangTidyError> &Errors) {
+  SmallString<256> AbsolutePath;
+  std::vector<CompileCommand> Commands =
+      getCompileCommands(Compilations, File, AbsolutePath);
+  if (Commands.empty())
+    return false;
+
+  ClangTidyContext &Context = Worker.Context;
+  std::string MainExecutable = getMainExecutable();
+  auto PCHContainerOps = std::make_shared<PCHContainerOperations>();
+  bool Success = true;
+  auto Start = std::chrono::steady_clock::now();
+  bool Analyzed = false;
+  uint64_t Memory = 0;
+  for (const CompileCommand &Command : Commands) {
+    CommandLineArguments Args =
+        getAdjustedArguments(Context, Command, MainExecutable);
+
+    std::string CacheKey, DependenciesKey;
+    ClangTidyCache::Entry CacheEntry;
+    if (Worker.Cache) {
+      DependenciesKey = Worker.Cache->getDependenciesKey(
+          Args, Command.Directory, Command.Filename);
+      CacheKey = Worker.Cache->getKey(
+          Args, Command.Directory, Command.Filename,
+          *Context.getOptionsForFile(Command.Filename),
+          Context.getGlobalOptions());
+      if (llvm::Optional<ClangTidyCache::Entry> Cached =
+              Worker.Cache->lookup(CacheKey)) {
+        std::move(Cached->Errors.begin(), Cached->Errors.end(),
+                  std::back_inserter(Errors));
+        Worker.Stats += Cached->Stats;
+        ++Worker.Stats.CacheHits;
+        continue;
+      }
+      ++Worker.Stats.CacheMisses;
+      Worker.Factory.setDependencies(&CacheEntry.Dependencies);
+    }
+
+    FileSystemOptions FileSystemOpts;
+    FileSystemOpts.WorkingDir = Command.Directory;
+    IntrusiveRefCntPtr<FileManager> Files(new FileManager(FileSystemOpts));
+    ToolInvocation Invocation(std::move(Args), &Worker.Factory, Files.get(),
+                              PCHContainerOps);
+    Invocation.setDiagnosticConsumer(&Worker.DiagConsumer);
+    bool InvocationSucceeded = Invocation.run();
+    if (!InvocationSucceeded) {
+      llvm::errs() << "Error while processing " << AbsolutePath << ".\n";
+      Success = false;
+    }
+    Worker.Factory.setDependencies(nullptr);
+    Analyzed = true;
+    Memory = std::max(Memory, Context.getTranslationUnitMemory());
+
+    // Don't cache failed runs: they may depend on files that don't exist yet.
+    // Results of translation units that skipped headers analyzed elsewhere or
+    // ran out of time are incomplete, so don't cache them either.
+    if (Worker.Cache && InvocationSucceeded) {
+      Worker.Cache->storeDependencies(DependenciesKey, CacheEntry.Dependencies);
+      if (!Context.hasSkippedHeaders() &&
+          !Context.getStats().TimeBudgetsExceeded) {
+        CacheEntry.Errors = Context.getErrors();
+        CacheEntry.Stats = Context.getStats();
+        Worker.Cache->store(CacheKey, CacheEntry);
+      }
+    }
+    std::vector<ClangTidyError> FileErrors = Context.takeErrors();
+    Errors.insert(Errors.end(), std::make_move_iterator(FileErrors.begin()),
+                  std::make_move_iterator(FileErrors.end()));
+    Worker.Stats += Context.getStats();
+    Context.clearStats();
+  }
+  // Results taken from the cache say nothing about the cost of analysis.
+  if (Worker.History && Analyzed) {
+    std::chrono::duration<double> Seconds =
+        std::chrono::steady_clock::now() - Start;
+    Worker.History->record(AbsolutePath,
+                           ClangTidyHistory::Cost(Seconds.count(), Memory));
+  }
+  return Success;
+}
+
+/// \brief Processes \p InputFiles on \p NumThreads threads.
+///
+/// Each thread owns a separate \c ClangTidyContext and diagnostic consumer.
+/// Threads take the next unprocessed file as soon as they are done with the
+/// previous one. The errors of each file are emitted as soon as the errors of
+/// all previous files have been, so the output is the same as in a serial run.
+///
+/// With a history file, files are started in the order of decreasing recorded
+/// time, so that the most expensive files don't end up last on a single
+/// thread, and a file isn't started while its recorded memory would exceed the
+/// memory limit together with the files already running.
+static ClangTidyStats
+runClangTidyOnFiles(ClangTidyOptionsProvider &OptionsProvider,
+                    const CompilationDatabase &Compilations,
+                    ArrayRef<std::string> InputFiles, unsigned NumThreads,
+                    AnalyzedHeaderRegistry *AnalyzedHeaders,
+                    ErrorEmitter &Emitter, ProfileData *Profile) {
+  std::unique_ptr<ClangTidyCache> Cache;
+  StringRef CacheDirectory = OptionsProvider.getGlobalOptions().CacheDirectory;
+  if (!CacheDirectory.empty())
+    Cache = llvm::make_unique<ClangTidyCache>(CacheDirectory);
+
+  std::mutex OptionsMutex;
+  std::vector<std::unique_ptr<ClangTidyWorker>> Workers;
+  for (unsigned I = 0; I < NumThreads; ++I) {
+    Workers.push_back(llvm::make_unique<ClangTidyWorker>(
+        llvm::make_unique<LockedOptionsProvider>(OptionsProvider,
+                                                 OptionsMutex),
+        Profile, Cache.get(), AnalyzedHeaders));
+    Workers.back()->Profile.Thread = I;
+  }
+
+  const ClangTidyGlobalOptions &GlobalOptions =
+      OptionsProvider.getGlobalOptions();
+  std::unique_ptr<ClangTidyHistory> History;
+  std::vector<uint64_t> Memory(InputFiles.size());
+  std::vector<unsigned> Order(InputFiles.size());
+  std::iota(Order.begin(), Order.end(), 0);
+  if (!GlobalOptions.HistoryFile.empty()) {
+    History = llvm::make_unique<ClangTidyHistory>(GlobalOptions.HistoryFile);
+    std::vector<double> Seconds(InputFiles.size());
+    for (unsigned I = 0, E = InputFiles.size(); I < E; ++I) {
+      ClangTidyHistory::Cost Cost =
+          History->estimate(getHistoryPath(InputFiles[I]));
+      Seconds[I] = Cost.Seconds;
+      Memory[I] = Cost.Memory;
+    }
+    std::stable_sort(Order.begin(), Order.end(), [&](unsigned A, unsigned B) {
+      return Seconds[A] > Seconds[B];
+    });
+    for (auto &Worker : Workers)
+      Worker->History = History.get();
+  }
+  std::unique_ptr<MemoryAdmission> Admission;
+  if (History && GlobalOptions.MemoryLimit > 0)
+    Admission = llvm::make_unique<MemoryAdmission>(GlobalOptions.MemoryLimit);
+
+  // Errors of files that are done, but wait for a previous file to be emitted.
+  std::mutex EmitMutex;
+  std::vector<std::vector<ClangTidyError>> PendingErrors(InputFiles.size());
+  std::vector<char> Done(InputFiles.size());
+  unsigned NextToEmit = 0;
+  auto FileDone = [&](unsigned I, std::vector<ClangTidyError> &Errors) {
+    std::lock_guard<std::mutex> Lock(EmitMutex);
+    PendingErrors[I] = std::move(Errors);
+    Done[I] = true;
+    for (; NextToEmit < InputFiles.size() && Done[NextToEmit]; ++NextToEmit) {
+      Emitter.emit(PendingErrors[NextToEmit]);
+      std::vector<ClangTidyError>().swap(PendingErrors[NextToEmit]);
+    }
+  };
+
+  std::atomic<unsigned> NextFile(0);
+  {
+    ThreadPool Pool(NumThreads);
+    for (auto &Worker : Workers) {
+      ClangTidyWorker *W = Worker.get();
+      Pool.async([&, W] {
+        for (unsigned N = NextFile++; N < Order.size(); N = NextFile++) {
+          unsigned I = Order[N];
+          if (Admission)
+            Admission->acquire(Memory[I]);
+          std::vector<ClangTidyError> Errors;
+          runOnFile(Compilations, InputFiles[I], *W, Errors);
+          if (Admission)
+            Admission->release(Memory[I]);
+          FileDone(I, Errors);
+        }
+      });
+    }
+    Pool.wait();
+  }
+  if (History)
+    History->save(GlobalOptions.HistoryFile);
+
+  ClangTidyStats Stats;
+  for (auto &Worker : Workers) {
+    Stats += Worker->Stats;
+    if (Profile)
+      Profile->merge(Worker->Profile);
+  }
+  if (Profile)
+    std::stable_sort(Profile->Files.begin(), Profile->Files.end(),
+                     [](const FileProfile &A, const FileProfile &B) {
+                       return A.Start < B.Start;
+                     });
+  return Stats;
+}
+
+// Returns true if Path names one of the files changed by Changes. Both are
+// compared by whole trailing path components, as the changes usually have paths
+// relative to the root of the repository.
+static bool isChanged(StringRef Path, ArrayRef<FileFilter> Changes) {
+  for (const FileFilter &Change : Changes) {
+    StringRef Name = Change.Name;
+    if (Path == Name)
+      return true;
+    if (Path.endswith(Name) &&
+        llvm::sys::path::is_separator(Path[Path.size() - Name.size() - 1]))
+      return true;
+  }
+  return false;
+}
+
+/// \brief Returns \c true if \p File, or any file read by one of its compile
+/// commands, is changed by \p Changes.
+///
+/// The files read by each compile command are taken from \p Cache if it has
+/// recorded them, otherwise they are found by preprocessing the file.
+static bool isAffected(const CompilationDatabase &Compilations, StringRef File,
+                       ArrayRef<FileFilter> Changes, ClangTidyContext &Context,
+                       const ClangTidyCache *Cache) {
+  SmallString<256> AbsolutePath;
+  std::vector<CompileCommand> Commands =
+      getCompileCommands(Compilations, File, AbsolutePath);
+  if (isChanged(AbsolutePath, Changes))
+    return true;
+
+  std::string MainExecutable = getMainExecutable();
+  auto PCHContainerOps = std::make_shared<PCHContainerOperations>();
+  for (const CompileCommand &Command : Commands) {
+    CommandLineArguments Args =
+        getAdjustedArguments(Context, Command, MainExecutable);
+    std::string DependenciesKey;
+    if (Cache) {
+      DependenciesKey =
+          Cache->getDependenciesKey(Args, Command.Directory, Command.Filename);
+      if (llvm::Optional<std::vector<ClangTidyCache::Dependency>> Deps =
+              Cache->lookupDependencies(DependenciesKey)) {
+        // The recorded list is exact unless one of the files has changed since,
+        // in which case the file needs to be analyzed again anyway.
+        for (const ClangTidyCache::Dependency &Dep : *Deps)
+          if (isChanged(Dep.Path, Changes) || !ClangTidyCache::isUpToDate(Dep))
+            return true;
+        continue;
+      }
+    }
+
+    std::vector<ClangTidyCache::Dependency> Deps;
+    IncludeScannerActionFactory Factory(Deps);
+    FileSystemOptions FileSystemOpts;
+    FileSystemOpts.WorkingDir = Command.Directory;
+    IntrusiveRefCntPtr<FileManager> Files(new FileManager(FileSystemOpts));
+    ToolInvocation Invocation(std::move(Args), &Factory, Files.get(),
+                              PCHContainerOps);
+    IgnoringDiagConsumer DiagConsumer;
+    Invocation.setDiagnosticConsumer(&DiagConsumer);
+    // Analyze files that can't be preprocessed rather than dropping them.
+    if (!Invocation.run())
+      return true;
+    if (Cache)
+      Cache->storeDependencies(DependenciesKey, Deps);
+    for (const ClangTidyCache::Dependency &Dep : Deps)
+      if (isChanged(Dep.Path, Changes))
+        return true;
+  }
+  return false;
+}
+
+std::vector<std::string>
+getAffectedFiles(ClangTidyOptionsProvider &OptionsProvider,
+                 const tooling::CompilationDatabase &Compilations,
+                 ArrayRef<std::string> Candidates,
+                 ArrayRef<FileFilter> Changes) {
+  const ClangTidyGlobalOptions &GlobalOptions =
+      OptionsProvider.getGlobalOptions();
+  std::unique_ptr<ClangTidyCache> Cache;
+  if (!GlobalOptions.CacheDirectory.empty())
+    Cache = llvm::make_unique<ClangTidyCache>(GlobalOptions.CacheDirectory);
+
+  unsigned NumThreads = GlobalOptions.Jobs;
+  if (NumThreads == 0)
+    NumThreads = std::thread::hardware_concurrency();
+  NumThreads = std::max(1u, std::min<unsigned>(NumThreads, Candidates.size()));
+
+  std::mutex OptionsMutex;
+  // Not std::vector<bool>, which can't be written concurrently.
+  std::vector<char> Affected(Candidates.size());
+  std::atomic<unsigned> NextFile(0);
+  {
+    ThreadPool Pool(NumThreads);
+    for (unsigned Thread = 0; Thread < NumThreads; ++Thread) {
+      Pool.async([&] {
+        ClangTidyContext Context(llvm::make_unique<LockedOptionsProvider>(
+            OptionsProvider, OptionsMutex));
+        for (unsigned I = NextFile++; I < Candidates.size(); I = NextFile++)
+          Affected[I] = isAffected(Compilations, Candidates[I], Changes,
+                                   Context, Cache.get());
+      });
+    }
+    Pool.wait();
+  }
+
+  std::vector<std::string> Files;
+  for (unsigned I = 0, E = Candidates.size(); I < E; ++I)
+    if (Affected[I])
+      Files.push_back(Candidates[I]);
+  return Files;
+}
+
 ClangTidyStats
 runClangTidy(std::unique_ptr<ClangTidyOptionsProvider> OptionsProvider,
              const tooling::CompilationDatabase &Compilations,
-             ArrayRef<std::string> InputFiles,
-             std::vector<ClangTidyError> *Errors, ProfileData *Profile) {
+             ArrayRef<std::string> InputFiles, ClangTidyErrorSink &Sink,
+             ProfileData *Profile) {
+  const ClangTidyGlobalOptions &GlobalOptions =
+      OptionsProvider->getGlobalOptions();
+  AnalyzedHeaderRegistry AnalyzedHeaders;
+  AnalyzedHeaderRegistry *Registry =
+      GlobalOptions.AnalyzeHeadersOnce ? &AnalyzedHeaders : nullptr;
+  // Without -analyze-headers-once, each translation unit reports the
+  // diagnostics of the headers it includes.
+  ErrorEmitter Emitter(Sink, Profile, GlobalOptions.AnalyzeHeadersOnce);
+
+  unsigned NumThreads = GlobalOptions.Jobs;
+  if (NumThreads == 0)
+    NumThreads = std::thread::hardware_concurrency();
+  NumThreads = std::min<unsigned>(NumThreads, InputFiles.size());
+  if (NumThreads > 1 || !GlobalOptions.CacheDirectory.empty() ||
+      !GlobalOptions.HistoryFile.empty())
+    return runClangTidyOnFiles(*OptionsProvider, Compilations, InputFiles,
+                               std::max(NumThreads, 1u), Registry, Emitter,
+                               Profile);
+
   ClangTool Tool(Compilations, InputFiles);
   clang::tidy::ClangTidyContext Context(std::move(OptionsProvider));
+  Context.setAnalyzedHeaderRegistry(Registry);
 
-  // Add extra arguments passed by the clang-tidy command-line.
-  ArgumentsAdjuster PerFileExtraArgumentsInserter =
-      [&Context](const CommandLineArguments &Args, StringRef Filename) {
-        ClangTidyOptions Opts = Context.getOptionsForFile(Filename);
-        CommandLineArguments AdjustedArgs;
-        if (Opts.ExtraArgsBefore)
-          AdjustedArgs = *Opts.ExtraArgsBefore;
-        AdjustedArgs.insert(AdjustedArgs.begin(), Args.begin(), Args.end());
-        if (Opts.ExtraArgs)
-          AdjustedArgs.insert(AdjustedArgs.end(), Opts.ExtraArgs->begin(),
-                              Opts.ExtraArgs->end());
-        return AdjustedArgs;
-      };
-
-  // Remove plugins arguments.
-  ArgumentsAdjuster PluginArgumentsRemover =
-      [&Context](const CommandLineArguments &Args, StringRef Filename) {
-        CommandLineArguments AdjustedArgs;
-        for (size_t I = 0, E = Args.size(); I < E; ++I) {
-          if (I + 4 < Args.size() && Args[I] == "-Xclang" &&
-              (Args[I + 1] == "-load" || Args[I + 1] == "-add-plugin" ||
-               StringRef(Args[I + 1]).startswith("-plugin-arg-")) &&
-              Args[I + 2] == "-Xclang") {
-            I += 3;
-          } else
-            AdjustedArgs.push_back(Args[I]);
-        }
-        return AdjustedArgs;
-      };
-
-  Tool.appendArgumentsAdjuster(PerFileExtraArgumentsInserter);
-  Tool.appendArgumentsAdjuster(PluginArgumentsRemover);
+  Tool.appendArgumentsAdjuster(getPerFileExtraArgumentsInserter(Context));
+  Tool.appendArgumentsAdjuster(getPluginArgumentsRemover());
   if (Profile)
     Context.setCheckProfileData(Profile);
 
@@ -455,56 +1612,900 @@ runClangTidy(std::unique_ptr<ClangTidyOptionsProvider> OptionsProvider,
 
   Tool.setDiagnosticConsumer(&DiagConsumer);
 
-  class ActionFactory : public FrontendActionFactory {
+  ClangTidyActionFactory Factory(Context);
+  Factory.setErrorEmitter(&Emitter);
+  Tool.run(&Factory);
+  return Context.getStats();
+}
+
+namespace {
+class CollectingErrorSink : public ClangTidyErrorSink {
+public:
+  CollectingErrorSink(std::vector<ClangTidyError> &Errors) : Errors(Errors) {}
+  void handleErrors(ArrayRef<ClangTidyError> NewErrors) override {
+    Errors.insert(Errors.end(), NewErrors.begin(), NewErrors.end());
+  }
+
+private:
+  std::vector<ClangTidyError> &Errors;
+};
+} // namespace
+
+ClangTidyStats
+runClangTidy(std::unique_ptr<ClangTidyOptionsProvider> OptionsProvider,
+             const tooling::CompilationDatabase &Compilations,
+             ArrayRef<std::string> InputFiles,
+             std::vector<ClangTidyError> *Errors, ProfileData *Profile) {
+  Errors->clear();
+  CollectingErrorSink Sink(*Errors);
+  return runClangTidy(std::move(OptionsProvider), Compilations, InputFiles,
+                      Sink, Profile);
+}
+
+namespace {
+/// \brief Adds the options of the current request to the options of another
+/// provider.
+class RequestOptionsProvider : public ClangTidyOptionsProvider {
+public:
+  RequestOptionsProvider(std::unique_ptr<ClangTidyOptionsProvider> Provider)
+      : Provider(std::move(Provider)) {}
+
+  const ClangTidyGlobalOptions &getGlobalOptions() override {
+    return Provider->getGlobalOptions();
+  }
+
+  std::vector<OptionsSource> getRawOptions(StringRef FileName) override {
+    std::vector<OptionsSource> RawOptions = Provider->getRawOptions(FileName);
+    if (RequestOptions.Checks)
+      RawOptions.emplace_back(RequestOptions, "request");
+    return RawOptions;
+  }
+
+  std::shared_ptr<const ClangTidyOptions>
+  getMergedOptions(StringRef FileName) override {
+    std::shared_ptr<const ClangTidyOptions> Options =
+        Provider->getMergedOptions(FileName);
+    if (!RequestOptions.Checks)
+      return Options;
+    if (Options != LastOptions || *RequestOptions.Checks != LastChecks) {
+      LastOptions = Options;
+      LastChecks = *RequestOptions.Checks;
+      LastMergedOptions = std::make_shared<const ClangTidyOptions>(
+          Options->mergeWith(RequestOptions));
+    }
+    return LastMergedOptions;
+  }
+
+  void refresh() override { Provider->refresh(); }
+
+  ClangTidyOptions RequestOptions;
+
+private:
+  std::unique_ptr<ClangTidyOptionsProvider> Provider;
+  /// \brief The options last merged with the request options, and the result.
+  std::shared_ptr<const ClangTidyOptions> LastOptions;
+  std::string LastChecks;
+  std::shared_ptr<const ClangTidyOptions> LastMergedOptions;
+};
+
+/// \brief A file read while building a precompiled preamble, with its status at
+/// that time.
+typedef std::pair<std::string, llvm::sys::fs::file_status> PreambleDependency;
+
+/// \brief A precompiled preamble of a main file, stored in a temporary file.
+struct CachedPreamble {
+  CachedPreamble() : Size(0), EndsAtStartOfLine(false) {}
+  ~CachedPreamble() {
+    if (!PCHPath.empty())
+      llvm::sys::fs::remove(PCHPath);
+  }
+
+  /// \brief The hash of the compile command and the preamble.
+  std::string Key;
+  SmallString<128> PCHPath;
+  unsigned Size;
+  bool EndsAtStartOfLine;
+  std::vector<PreambleDependency> Dependencies;
+  std::vector<PreambleInclusion> Inclusions;
+};
+
+/// \brief Records the inclusion directives of the main file.
+class InclusionRecorder : public PPCallbacks {
+public:
+  InclusionRecorder(const SourceManager &Sources,
+                    std::vector<PreambleInclusion> &Inclusions)
+      : Sources(Sources), Inclusions(Inclusions) {}
+
+  void InclusionDirective(SourceLocation HashLoc, const Token &IncludeTok,
+                          StringRef FileName, bool IsAngled,
+                          CharSourceRange FileNameRange, const FileEntry *File,
+                          StringRef SearchPath, StringRef RelativePath,
+                          const Module *Imported) override {
+    if (!Sources.isInMainFile(HashLoc))
+      return;
+    PreambleInclusion Inclusion;
+    Inclusion.HashOffset = Sources.getFileOffset(HashLoc);
+    Inclusion.KeywordOffset = Sources.getFileOffset(IncludeTok.getLocation());
+    Inclusion.Keyword = IncludeTok.getIdentifierInfo()->getName();
+    Inclusion.FileName = FileName;
+    Inclusion.IsAngled = IsAngled;
+    // The file name may be spelled in a macro.
+    SourceLocation Begin = Sources.getExpansionLoc(FileNameRange.getBegin());
+    SourceLocation End = Sources.getExpansionLoc(FileNameRange.getEnd());
+    Inclusion.FileNameBegin = Sources.getFileOffset(Begin);
+    Inclusion.FileNameEnd = Sources.getFileOffset(End);
+    Inclusion.FileNameIsTokenRange = FileNameRange.isTokenRange();
+    Inclusion.File = File ? File->getName() : "";
+    Inclusion.SearchPath = SearchPath;
+    Inclusion.RelativePath = RelativePath;
+    Inclusions.push_back(std::move(Inclusion));
+  }
+
+private:
+  const SourceManager &Sources;
+  std::vector<PreambleInclusion> &Inclusions;
+};
+
+/// \brief Creates actions that write a precompiled header of the (remapped)
+/// main file to the \c PCHPath of a \c CachedPreamble and record the files
+/// read and the inclusion directives of the main file in it.
+class PreambleActionFactory : public FrontendActionFactory {
+public:
+  PreambleActionFactory(CachedPreamble &Preamble) : Preamble(Preamble) {}
+
+  FrontendAction *create() override { return new Action(Preamble); }
+
+  bool runInvocation(CompilerInvocation *Invocation, FileManager *Files,
+                     std::shared_ptr<PCHContainerOperations> PCHContainerOps,
+                     DiagnosticConsumer *DiagConsumer) override {
+    Invocation->getFrontendOpts().OutputFile = Preamble.PCHPath.str();
+    return FrontendActionFactory::runInvocation(
+        Invocation, Files, std::move(PCHContainerOps), DiagConsumer);
+  }
+
+private:
+  class Action : public GeneratePCHAction {
   public:
-    ActionFactory(ClangTidyContext &Context) : ConsumerFactory(Context) {}
-    FrontendAction *create() override { return new Action(&ConsumerFactory); }
+    Action(CachedPreamble &Preamble) : Preamble(Preamble) {}
+
+  protected:
+    std::unique_ptr<ASTConsumer>
+    CreateASTConsumer(CompilerInstance &Compiler, StringRef InFile) override {
+      Compiler.getPreprocessor().addPPCallbacks(
+          llvm::make_unique<InclusionRecorder>(Compiler.getSourceManager(),
+                                               Preamble.Inclusions));
+      return GeneratePCHAction::CreateASTConsumer(Compiler, InFile);
+    }
 
-  private:
-    class Action : public ASTFrontendAction {
-    public:
-      Action(ClangTidyASTConsumerFactory *Factory) : Factory(Factory) {}
-      std::unique_ptr<ASTConsumer> CreateASTConsumer(CompilerInstance &Compiler,
-                                                     StringRef File) override {
-        return Factory->CreateASTConsumer(Compiler, File);
+    void EndSourceFileAction() override {
+      const SourceManager &Sources = getCompilerInstance().getSourceManager();
+      const FileEntry *MainFile =
+          Sources.getFileEntryForID(Sources.getMainFileID());
+      for (auto I = Sources.fileinfo_begin(), E = Sources.fileinfo_end();
+           I != E; ++I) {
+        if (I->first == MainFile)
+          continue;
+        SmallString<256> Path(I->first->getName());
+        getCompilerInstance().getFileManager().makeAbsolutePath(Path);
+        llvm::sys::fs::file_status Status;
+        llvm::sys::fs::status(Path, Status);
+        Preamble.Dependencies.emplace_back(Path.str(), Status);
       }
+      GeneratePCHAction::EndSourceFileAction();
+    }
+
+  private:
+    CachedPreamble &Preamble;
+  };
+
+  CachedPreamble &Preamble;
+};
+
+// Returns true if none of Dependencies has changed since it was recorded.
+static bool isUpToDate(ArrayRef<PreambleDependency> Dependencies) {
+  for (const PreambleDependency &Dep : Dependencies) {
+    llvm::sys::fs::file_status Status;
+    if (llvm::sys::fs::status(Dep.first, Status) ||
+        Status.getSize() != Dep.second.getSize() ||
+        Status.getLastModificationTime() !=
+            Dep.second.getLastModificationTime())
+      return false;
+  }
+  return true;
+}
+
+/// \brief A \c FileManager shared by the compile commands run in the same
+/// directory.
+struct CachedFileManager {
+  CachedFileManager() : HadCompilerErrors(false) {}
+
+  IntrusiveRefCntPtr<FileManager> Files;
+  /// \brief The absolute path of the file whose contents were replaced in the
+  /// last run, if any.
+  std::string RemappedFile;
+  /// \brief Whether the last run had compiler errors. These may be caused by
+  /// missing files, whose absence the \c FileManager caches.
+  bool HadCompilerErrors;
+};
+} // namespace
+
+struct ClangTidyServer::State {
+  State(std::unique_ptr<ClangTidyOptionsProvider> OptionsProvider,
+        const CompilationDatabase &Compilations)
+      : Provider(new RequestOptionsProvider(std::move(OptionsProvider))),
+        Worker(std::unique_ptr<ClangTidyOptionsProvider>(Provider), nullptr,
+               nullptr, nullptr),
+        Compilations(Compilations), MainExecutable(getMainExecutable()),
+        PCHContainerOps(std::make_shared<PCHContainerOperations>()),
+        NumCommands(0), NumPreambleCommands(0) {}
+
+  CachedPreamble *getPreamble(const CompileCommand &Command,
+                              const CommandLineArguments &Args,
+                              StringRef MainFile,
+                              llvm::Optional<StringRef> Content);
+
+  /// \brief Owned by the context of \c Worker.
+  RequestOptionsProvider *Provider;
+  ClangTidyWorker Worker;
+  const CompilationDatabase &Compilations;
+  std::string MainExecutable;
+  std::shared_ptr<PCHContainerOperations> PCHContainerOps;
+  llvm::StringMap<CachedFileManager> FileManagers;
+  /// \brief Preambles by build directory and main file.
+  llvm::StringMap<std::unique_ptr<CachedPreamble>> Preambles;
+  /// \brief Whether the checks enabled by each \c Checks option have been
+  /// seen needing the preprocessor callbacks of the whole main file.
+  llvm::StringMap<bool> ChecksNeedWholePreprocessorStream;
+  unsigned NumCommands;
+  unsigned NumPreambleCommands;
+};
+
+/// \brief Returns the up-to-date preamble of \p MainFile, building it if
+/// needed, or \c nullptr if the file has no preamble or it can't be built.
+CachedPreamble *ClangTidyServer::State::getPreamble(
+    const CompileCommand &Command, const CommandLineArguments &Args,
+    StringRef MainFile, llvm::Optional<StringRef> Content) {
+  std::unique_ptr<llvm::MemoryBuffer> Buffer;
+  StringRef Text;
+  if (Content) {
+    Text = *Content;
+  } else {
+    llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> File =
+        llvm::MemoryBuffer::getFile(MainFile);
+    if (!File)
+      return nullptr;
+    Buffer = std::move(*File);
+    Text = Buffer->getBuffer();
+  }
+  std::pair<unsigned, bool> Bounds =
+      Lexer::ComputePreamble(Text, LangOptions());
+  if (Bounds.first == 0)
+    return nullptr;
+  StringRef PreambleText = Text.substr(0, Bounds.first);
+
+  llvm::MD5 Hash;
+  for (const std::string &Arg : Args) {
+    Hash.update(Arg);
+    Hash.update(StringRef("\0", 1));
+  }
+  Hash.update(PreambleText);
+  llvm::MD5::MD5Result Result;
+  Hash.final(Result);
+  SmallString<32> Key;
+  llvm::MD5::stringifyResult(Result, Key);
+
+  std::unique_ptr<CachedPreamble> &Preamble =
+      Preambles[(Command.Directory + "\n" + MainFile).str()];
+  if (Preamble && Preamble->Key == Key && isUpToDate(Preamble->Dependencies))
+    return Preamble.get();
+  Preamble.reset();
+
+  auto NewPreamble = llvm::make_unique<CachedPreamble>();
+  if (llvm::sys::fs::createTemporaryFile("clang-tidy-preamble", "pch",
+                                         NewPreamble->PCHPath))
+    return nullptr;
+  // Use a separate FileManager, as remapping the main file changes its size
+  // in the FileManager.
+  FileSystemOptions FileSystemOpts;
+  FileSystemOpts.WorkingDir = Command.Directory;
+  IntrusiveRefCntPtr<FileManager> Files(new FileManager(FileSystemOpts));
+  PreambleActionFactory Factory(*NewPreamble);
+  ToolInvocation Invocation(Args, &Factory, Files.get(), PCHContainerOps);
+  IgnoringDiagConsumer DiagConsumer;
+  Invocation.setDiagnosticConsumer(&DiagConsumer);
+  Invocation.mapVirtualFile(MainFile, PreambleText);
+  if (!Invocation.run())
+    return nullptr;
+
+  NewPreamble->Key = Key.str();
+  NewPreamble->Size = Bounds.first;
+  NewPreamble->EndsAtStartOfLine = Bounds.second;
+  Preamble = std::move(NewPreamble);
+  return Preamble.get();
+}
+
+ClangTidyServer::ClangTidyServer(
+    std::unique_ptr<ClangTidyOptionsProvider> OptionsProvider,
+    const CompilationDatabase &Compilations)
+    : S(new State(std::move(OptionsProvider), Compilations)) {}
+
+ClangTidyServer::~ClangTidyServer() {}
 
-    private:
-      ClangTidyASTConsumerFactory *Factory;
+unsigned ClangTidyServer::getNumCommands() const { return S->NumCommands; }
+
+unsigned ClangTidyServer::getNumPreambleCommands() const {
+  return S->NumPreambleCommands;
+}
+
+// Returns true if no file seen by Files has changed on disk since it was first
+// looked up. The file named Ignored is not checked.
+static bool isUpToDate(FileManager &Files, StringRef Ignored) {
+  SmallVector<const FileEntry *, 256> Entries;
+  Files.GetUniqueIDMapping(Entries);
+  for (const FileEntry *Entry : Entries) {
+    if (!Entry)
+      continue;
+    SmallString<256> Path(Entry->getName());
+    Files.makeAbsolutePath(Path);
+    if (Path == Ignored)
+      continue;
+    llvm::sys::fs::file_status Status;
+    if (llvm::sys::fs::status(Path, Status) ||
+        Status.getSize() != uint64_t(Entry->getSize()) ||
+        Status.getLastModificationTime().toEpochTime() !=
+            uint64_t(Entry->getModificationTime()))
+      return false;
+  }
+  return true;
+}
+
+bool ClangTidyServer::run(StringRef File, llvm::Optional<StringRef> Content,
+                          llvm::Optional<StringRef> Checks,
+                          std::vector<ClangTidyError> &Errors) {
+  Errors.clear();
+  S->Provider->refresh();
+  S->Provider->RequestOptions = ClangTidyOptions();
+  if (Checks)
+    S->Provider->RequestOptions.Checks = Checks->str();
+
+  SmallString<256> AbsolutePath;
+  std::vector<CompileCommand> Commands =
+      getCompileCommands(S->Compilations, File, AbsolutePath);
+  if (Commands.empty())
+    return false;
+
+  ClangTidyContext &Context = S->Worker.Context;
+  CollectingErrorSink Sink(Errors);
+  // The compile commands of a file share its diagnostics.
+  ErrorEmitter Emitter(Sink, nullptr, /*Deduplicate=*/true);
+  bool Success = true;
+  for (const CompileCommand &Command : Commands) {
+    CommandLineArguments Args =
+        getAdjustedArguments(Context, Command, S->MainExecutable);
+
+    // Preambles are only used once the checks are known not to need the
+    // preprocessor callbacks of the whole file. The inclusion directives of
+    // the preamble are replayed to the others.
+    std::string EnabledChecks =
+        Context.getOptionsForFile(Command.Filename)->Checks.getValueOr("");
+    auto NeedsWholeStream =
+        S->ChecksNeedWholePreprocessorStream.find(EnabledChecks);
+    CachedPreamble *Preamble = nullptr;
+    if (NeedsWholeStream != S->ChecksNeedWholePreprocessorStream.end() &&
+        !NeedsWholeStream->second)
+      Preamble = S->getPreamble(Command, Args, AbsolutePath, Content);
+
+    StringRef Remapped = Content ? AbsolutePath.str() : StringRef();
+    CachedFileManager &Cached = S->FileManagers[Command.Directory];
+    if (Cached.Files &&
+        (Cached.HadCompilerErrors || Cached.RemappedFile != Remapped ||
+         !isUpToDate(*Cached.Files, Cached.RemappedFile)))
+      Cached.Files.reset();
+    if (!Cached.Files) {
+      FileSystemOptions FileSystemOpts;
+      FileSystemOpts.WorkingDir = Command.Directory;
+      Cached.Files = new FileManager(FileSystemOpts);
+    }
+    Cached.RemappedFile = Remapped;
+
+    auto RunInvocation = [&](CachedPreamble *Preamble) {
+      CommandLineArguments InvocationArgs = Args;
+      if (Preamble) {
+        // The preamble is validated above, not by the PCH reader.
+        const char *PreambleArgs[] = {"-include-pch", Preamble->PCHPath.c_str(),
+                                      "-fno-validate-pch"};
+        for (const char *Arg : PreambleArgs) {
+          InvocationArgs.push_back("-Xclang");
+          InvocationArgs.push_back(Arg);
+        }
+        InvocationArgs.push_back("-Xclang");
+        InvocationArgs.push_back(
+            "-preamble-bytes=" + llvm::utostr(Preamble->Size) + "," +
+            (Preamble->EndsAtStartOfLine ? "1" : "0"));
+      }
+      ToolInvocation Invocation(std::move(InvocationArgs), &S->Worker.Factory,
+                                Cached.Files.get(), S->PCHContainerOps);
+      Invocation.setDiagnosticConsumer(&S->Worker.DiagConsumer);
+      if (Content)
+        Invocation.mapVirtualFile(AbsolutePath, *Content);
+      ClangTidyASTConsumerFactory &ConsumerFactory =
+          S->Worker.Factory.getConsumerFactory();
+      ConsumerFactory.setPreambleInclusions(Preamble ? &Preamble->Inclusions
+                                                     : nullptr);
+      bool Result = Invocation.run();
+      ConsumerFactory.setPreambleInclusions(nullptr);
+      return Result;
     };
+    bool InvocationSucceeded = RunInvocation(Preamble);
+    if (!InvocationSucceeded && Preamble) {
+      // The errors may be caused by a stale preamble, retry without it.
+      S->Preambles.erase((Command.Directory + "\n" + AbsolutePath).str());
+      Context.clearErrors();
+      Context.clearStats();
+      InvocationSucceeded = RunInvocation(nullptr);
+      Preamble = nullptr;
+    }
+    ++S->NumCommands;
+    if (Preamble)
+      ++S->NumPreambleCommands;
+    else
+      S->ChecksNeedWholePreprocessorStream[EnabledChecks] =
+          S->Worker.Factory.getConsumerFactory()
+              .checksNeedWholePreprocessorStream();
+    if (!InvocationSucceeded)
+      Success = false;
+
+    std::vector<ClangTidyError> CommandErrors = Context.takeErrors();
+    Context.clearStats();
+    Cached.HadCompilerErrors = !InvocationSucceeded;
+    for (const ClangTidyError &Error : CommandErrors)
+      if (Error.DiagLevel == ClangTidyError::Error)
+        Cached.HadCompilerErrors = true;
+    Emitter.emit(CommandErrors);
+  }
+  return Success;
+}
 
-    ClangTidyASTConsumerFactory ConsumerFactory;
-  };
+void MultiplexErrorSink::handleErrors(ArrayRef<ClangTidyError> Errors) {
+  for (ClangTidyErrorSink *Sink : Sinks)
+    Sink->handleErrors(Errors);
+}
 
-  ActionFactory Factory(Context);
-  Tool.run(&Factory);
-  *Errors = Context.getErrors();
-  return Context.getStats();
+ErrorDisplaySink::ErrorDisplaySink(bool ApplyFixes)
+    : ApplyFixes(ApplyFixes), TotalFixes(0), AppliedFixes(0),
+      WarningsAsErrors(0), SpillFailed(false) {}
+
+ErrorDisplaySink::~ErrorDisplaySink() { removeSpillFiles(); }
+
+void ErrorDisplaySink::handleErrors(ArrayRef<ClangTidyError> Errors) {
+  // Each reporter only keeps the files of a single batch of errors in memory.
+  // Relative paths are resolved against the build directory of each error.
+  for (auto I = Errors.begin(), E = Errors.end(); I != E;) {
+    ErrorReporter Reporter(ApplyFixes, I->BuildDirectory);
+    auto GroupEnd = std::find_if(I, E, [I](const ClangTidyError &Error) {
+      return Error.BuildDirectory != I->BuildDirectory;
+    });
+    for (; I != GroupEnd; ++I)
+      Reporter.reportDiagnostic(*I);
+    TotalFixes += Reporter.getTotalFixes();
+    AppliedFixes += Reporter.getAppliedFixes();
+    WarningsAsErrors += Reporter.getWarningsAsErrorsCount();
+    spillFixes(Reporter.getAppliedReplacements());
+  }
+}
+
+void ErrorDisplaySink::spillFixes(ArrayRef<tooling::Replacement> Fixes) {
+  if (Fixes.empty() || SpillFailed)
+    return;
+  if (SpillDirectory.empty()) {
+    if (std::error_code EC = llvm::sys::fs::createUniqueDirectory(
+            "clang-tidy-fixes", SpillDirectory)) {
+      llvm::errs() << "Can't create a temporary directory for fixes: "
+                   << EC.message() << "\n";
+      SpillDirectory.clear();
+      SpillFailed = true;
+      return;
+    }
+  }
+
+  // Group the fixes by file, keeping their order.
+  llvm::StringMap<std::vector<tooling::Replacement>> FixesByFile;
+  std::vector<StringRef> FileOrder;
+  for (const tooling::Replacement &Fix : Fixes) {
+    auto &FileFixes = FixesByFile[Fix.getFilePath()];
+    if (FileFixes.empty())
+      FileOrder.push_back(Fix.getFilePath());
+    FileFixes.push_back(Fix);
+  }
+
+  for (StringRef File : FileOrder) {
+    auto Inserted = SpillFileIndex.insert(
+        std::make_pair(File, static_cast<size_t>(SpillFiles.size())));
+    if (Inserted.second) {
+      SmallString<128> SpillFile(SpillDirectory);
+      llvm::sys::path::append(SpillFile,
+                              Twine(SpillFiles.size()) + ".yaml");
+      SpillFiles.emplace_back(File, SpillFile.str());
+    }
+    StringRef SpillFile = SpillFiles[Inserted.first->second].second;
+    std::error_code EC;
+    llvm::raw_fd_ostream OS(SpillFile, EC, llvm::sys::fs::F_Append);
+    if (EC) {
+      llvm::errs() << "Can't write fixes to " << SpillFile << ": "
+                   << EC.message() << "\n";
+      SpillFailed = true;
+      return;
+    }
+    llvm::yaml::Output YAML(OS);
+    YAML << FixesByFile[File];
+    OS.close();
+    if (OS.has_error()) {
+      llvm::errs() << "Can't write fixes to " << SpillFile << "\n";
+      OS.clear_error();
+      SpillFailed = true;
+      return;
+    }
+  }
+}
+
+namespace {
+/// \brief A file changed by -fix. Its new and original contents are written
+/// to temporary files next to it, so that it can be replaced, and restored,
+/// by renaming.
+struct FixedFile {
+  FixedFile() : Committed(false) {}
+
+  std::string Path;
+  SmallString<128> NewPath;
+  SmallString<128> BackupPath;
+  /// \brief Describes why the file can't be changed, if it can't.
+  std::string Error;
+  bool Committed;
+};
+} // namespace
+
+// Writes Contents to a new file named like Model with the given Permissions,
+// and stores its name in Path. The file replaces the original one by renaming,
+// so it needs the original's permissions.
+static std::error_code writeUniqueFile(const Twine &Model, StringRef Contents,
+                                       llvm::sys::fs::perms Permissions,
+                                       SmallVectorImpl<char> &Path) {
+  int FD;
+  if (std::error_code EC = llvm::sys::fs::createUniqueFile(Model, FD, Path))
+    return EC;
+  llvm::raw_fd_ostream OS(FD, /*shouldClose=*/true);
+  OS << Contents;
+  OS.close();
+  std::error_code EC;
+  if (OS.has_error()) {
+    OS.clear_error();
+    EC = std::make_error_code(std::errc::io_error);
+  } else {
+    EC = llvm::sys::fs::setPermissions(Path, Permissions);
+  }
+  if (EC)
+    llvm::sys::fs::remove(Path);
+  return EC;
+}
+
+// Applies the fixes spilled to SpillFile to File.Path, and writes the result
+// and the original contents next to it. Doesn't change File.Path itself. The
+// fixes of all translation units are merged first, so that overlapping fixes
+// made to a header by different translation units fail the whole apply.
+static void prepareFixedFile(StringRef SpillFile, FixedFile &File) {
+  llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> Text =
+      llvm::MemoryBuffer::getFile(SpillFile);
+  if (!Text) {
+    File.Error = "Can't read fixes for " + File.Path + ": " +
+                 Text.getError().message();
+    return;
+  }
+
+  FileManager Files((FileSystemOptions()));
+  IntrusiveRefCntPtr<DiagnosticOptions> DiagOpts(new DiagnosticOptions());
+  DiagnosticsEngine Diags(IntrusiveRefCntPtr<DiagnosticIDs>(new DiagnosticIDs),
+                          &*DiagOpts, new IgnoringDiagConsumer());
+  SourceManager SourceMgr(Diags, Files);
+  LangOptions LangOpts;
+  Rewriter Rewrite(SourceMgr, LangOpts);
+  std::vector<tooling::Replacement> AllFixes;
+  llvm::yaml::Input YAML((*Text)->getBuffer());
+  do {
+    std::vector<tooling::Replacement> Fixes;
+    YAML >> Fixes;
+    if (YAML.error()) {
+      File.Error = "Can't read fixes for " + File.Path + ": " +
+                   YAML.error().message();
+      return;
+    }
+    AllFixes.insert(AllFixes.end(), Fixes.begin(), Fixes.end());
+  } while (YAML.nextDocument());
+
+  // Identical fixes, e.g. of a header included by several translation units,
+  // are applied once.
+  std::vector<tooling::Range> Conflicts;
+  tooling::deduplicate(AllFixes, Conflicts);
+  if (!Conflicts.empty()) {
+    File.Error = "Conflicting fixes in " + File.Path;
+    return;
+  }
+  if (!tooling::applyAllReplacements(AllFixes, Rewrite)) {
+    File.Error = "Can't apply fixes to " + File.Path;
+    return;
+  }
+
+  llvm::sys::fs::file_status Status;
+  if (std::error_code EC = llvm::sys::fs::status(File.Path, Status)) {
+    File.Error = "Can't write " + File.Path + ": " + EC.message();
+    return;
+  }
+  // All fixes in a spill file are for the same file.
+  for (auto I = Rewrite.buffer_begin(), E = Rewrite.buffer_end(); I != E;
+       ++I) {
+    std::string NewContents;
+    llvm::raw_string_ostream OS(NewContents);
+    I->second.write(OS);
+    OS.flush();
+    std::error_code EC =
+        writeUniqueFile(File.Path + "-%%%%%%%%.tmp", NewContents,
+                        Status.permissions(), File.NewPath);
+    if (!EC)
+      EC = writeUniqueFile(File.Path + "-%%%%%%%%.orig",
+                           SourceMgr.getBufferData(I->first),
+                           Status.permissions(), File.BackupPath);
+    if (EC)
+      File.Error = "Can't write " + File.Path + ": " + EC.message();
+  }
+}
+
+// Replaces each of Files with its new contents. If any of them can't be
+// replaced, restores the ones replaced before. Returns false in that case.
+static bool commitFixedFiles(MutableArrayRef<FixedFile> Files) {
+  bool Failed = false;
+  for (const FixedFile &File : Files) {
+    if (!File.Error.empty()) {
+      llvm::errs() << File.Error << "\n";
+      Failed = true;
+    }
+  }
+  for (auto I = Files.begin(), E = Files.end(); I != E && !Failed; ++I) {
+    if (I->NewPath.empty())
+      continue;
+    if (std::error_code EC = llvm::sys::fs::rename(I->NewPath, I->Path)) {
+      llvm::errs() << "Can't write " << I->Path << ": " << EC.message()
+                   << "\n";
+      Failed = true;
+      break;
+    }
+    I->NewPath.clear();
+    I->Committed = true;
+  }
+
+  for (FixedFile &File : Files) {
+    if (Failed && File.Committed &&
+        !llvm::sys::fs::rename(File.BackupPath, File.Path))
+      File.BackupPath.clear();
+    if (!File.NewPath.empty())
+      llvm::sys::fs::remove(File.NewPath);
+    if (!File.BackupPath.empty()) {
+      // Keep the original contents if they couldn't be restored.
+      if (Failed && File.Committed)
+        llvm::errs() << "Can't restore " << File.Path << ", its original "
+                     << "contents are in " << File.BackupPath << "\n";
+      else
+        llvm::sys::fs::remove(File.BackupPath);
+    }
+  }
+  if (Failed)
+    llvm::errs() << "Fixes have NOT been applied.\n";
+  return !Failed;
+}
+
+bool ErrorDisplaySink::finish() {
+  // FIXME: Run clang-format on changes.
+  bool Success = true;
+  if (ApplyFixes && TotalFixes > 0 && SpillFailed) {
+    // Applying the fixes that were spilled would only change some files.
+    llvm::errs() << "Fixes have NOT been applied.\n";
+    Success = false;
+  } else if (ApplyFixes && TotalFixes > 0) {
+    llvm::errs() << "clang-tidy applied " << AppliedFixes << " of "
+                 << TotalFixes << " suggested fixes.\n";
+    // Files are fixed in parallel, but only written once all of them could be
+    // prepared, so that either all or none of the fixes are applied.
+    std::vector<FixedFile> Files(SpillFiles.size());
+    {
+      ThreadPool Pool;
+      for (size_t I = 0, E = SpillFiles.size(); I < E; ++I) {
+        Files[I].Path = SpillFiles[I].first;
+        Pool.async([this, &Files, I] {
+          prepareFixedFile(SpillFiles[I].second, Files[I]);
+        });
+      }
+      Pool.wait();
+    }
+    Success = commitFixedFiles(Files);
+  }
+  removeSpillFiles();
+  return Success;
+}
+
+void ErrorDisplaySink::removeSpillFiles() {
+  if (SpillDirectory.empty())
+    return;
+  for (const auto &File : SpillFiles)
+    llvm::sys::fs::remove(File.second);
+  llvm::sys::fs::remove(SpillDirectory);
+  SpillFiles.clear();
+  SpillFileIndex.clear();
+  SpillDirectory.clear();
+}
+
+ReplacementsExportSink::ReplacementsExportSink(StringRef FileName)
+    : FileName(FileName), HasErrors(false), Failed(false) {}
+
+ReplacementsExportSink::~ReplacementsExportSink() {
+  OS.reset();
+  if (!SpillPath.empty())
+    llvm::sys::fs::remove(SpillPath);
+}
+
+void ReplacementsExportSink::handleErrors(ArrayRef<ClangTidyError> Errors) {
+  if (Errors.empty() || Failed)
+    return;
+  HasErrors = true;
+  std::vector<tooling::Replacement> Fixes;
+  for (const ClangTidyError &Error : Errors)
+    Fixes.insert(Fixes.end(), Error.Fix.begin(), Error.Fix.end());
+  if (Fixes.empty())
+    return;
+
+  // Spill the replacements, so that the ones of all files don't need to be
+  // kept in memory during the run.
+  if (!OS) {
+    int FD;
+    if (std::error_code EC = llvm::sys::fs::createTemporaryFile(
+            "clang-tidy-export", "yaml", FD, SpillPath)) {
+      llvm::errs() << "Can't create a temporary file for fixes: "
+                   << EC.message() << "\n";
+      SpillPath.clear();
+      Failed = true;
+      return;
+    }
+    OS = llvm::make_unique<llvm::raw_fd_ostream>(FD, /*shouldClose=*/true);
+  }
+  yaml::Output YAML(*OS);
+  YAML << Fixes;
+}
+
+bool ReplacementsExportSink::finish() {
+  if (Failed)
+    return false;
+  if (!HasErrors)
+    return true;
+
+  tooling::TranslationUnitReplacements TUR;
+  if (OS) {
+    OS->close();
+    if (OS->has_error()) {
+      OS->clear_error();
+      llvm::errs() << "Can't write fixes to " << SpillPath << "\n";
+      return false;
+    }
+    OS.reset();
+    llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> Text =
+        llvm::MemoryBuffer::getFile(SpillPath);
+    if (!Text) {
+      llvm::errs() << "Can't read fixes from " << SpillPath << ": "
+                   << Text.getError().message() << "\n";
+      return false;
+    }
+    // Identical #include insertions of all translation units are merged.
+    std::set<std::tuple<std::string, unsigned, std::string>> InsertedIncludes;
+    llvm::yaml::Input YAML((*Text)->getBuffer());
+    do {
+      std::vector<tooling::Replacement> Fixes;
+      YAML >> Fixes;
+      if (YAML.error()) {
+        llvm::errs() << "Can't read fixes from " << SpillPath << "\n";
+        return false;
+      }
+      for (const tooling::Replacement &Fix : Fixes) {
+        if (isIncludeInsertion(Fix) &&
+            !InsertedIncludes
+                 .insert(std::make_tuple(Fix.getFilePath().str(),
+                                         Fix.getOffset(),
+                                         Fix.getReplacementText().str()))
+                 .second)
+          continue;
+        TUR.Replacements.push_back(Fix);
+      }
+    } while (YAML.nextDocument());
+  }
+
+  std::error_code EC;
+  llvm::raw_fd_ostream Out(FileName, EC, llvm::sys::fs::F_None);
+  if (EC) {
+    llvm::errs() << "Error opening output file: " << EC.message() << '\n';
+    return false;
+  }
+  yaml::Output YAML(Out);
+  YAML << TUR;
+  Out.close();
+  if (Out.has_error()) {
+    llvm::errs() << "Error writing " << FileName << "\n";
+    Out.clear_error();
+    return false;
+  }
+  return true;
+}
+
+SpillingErrorSink::SpillingErrorSink()
+    : HasCompilerErrors(false), Failed(false) {}
+
+SpillingErrorSink::~SpillingErrorSink() {
+  OS.reset();
+  if (!SpillPath.empty())
+    llvm::sys::fs::remove(SpillPath);
+}
+
+void SpillingErrorSink::handleErrors(ArrayRef<ClangTidyError> Errors) {
+  for (const ClangTidyError &Error : Errors)
+    if (Error.DiagLevel == ClangTidyError::Error)
+      HasCompilerErrors = true;
+  if (Errors.empty() || Failed)
+    return;
+  if (!OS) {
+    int FD;
+    if (std::error_code EC = llvm::sys::fs::createTemporaryFile(
+            "clang-tidy-errors", "yaml", FD, SpillPath)) {
+      llvm::errs() << "Can't create a temporary file for errors: "
+                   << EC.message() << "\n";
+      SpillPath.clear();
+      Failed = true;
+      return;
+    }
+    OS = llvm::make_unique<llvm::raw_fd_ostream>(FD, /*shouldClose=*/true);
+  }
+  writeErrors(Errors, *OS);
+}
+
+bool SpillingErrorSink::replay(ClangTidyErrorSink &Sink) {
+  if (Failed)
+    return false;
+  if (!OS)
+    return true;
+  OS->close();
+  if (OS->has_error()) {
+    OS->clear_error();
+    llvm::errs() << "Can't write errors to " << SpillPath << "\n";
+    return false;
+  }
+  OS.reset();
+
+  llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> Text =
+      llvm::MemoryBuffer::getFile(SpillPath);
+  if (!Text) {
+    llvm::errs() << "Can't read errors from " << SpillPath << ": "
+                 << Text.getError().message() << "\n";
+    return false;
+  }
+  if (!readErrors((*Text)->getBuffer(), [&Sink](
+                      std::vector<ClangTidyError> &Errors) {
+        Sink.handleErrors(Errors);
+      })) {
+    llvm::errs() << "Can't read errors from " << SpillPath << "\n";
+    return false;
+  }
+  return true;
 }
 
 void handleErrors(const std::vector<ClangTidyError> &Errors, bool Fix,
                   unsigned &WarningsAsErrorsCount) {
-  ErrorReporter Reporter(Fix);
-  vfs::FileSystem &FileSystem =
-      *Reporter.getSourceManager().getFileManager().getVirtualFileSystem();
-  auto InitialWorkingDir = FileSystem.getCurrentWorkingDirectory();
-  if (!InitialWorkingDir)
-    llvm::report_fatal_error("Cannot get current working path.");
-
-  for (const ClangTidyError &Error : Errors) {
-    if (!Error.BuildDirectory.empty()) {
-      // By default, the working directory of file system is the current
-      // clang-tidy running directory.
-      //
-      // Change the directory to the one used during the analysis.
-      FileSystem.setCurrentWorkingDirectory(Error.BuildDirectory);
-    }
-    Reporter.reportDiagnostic(Error);
-    // Return to the initial directory to correctly resolve next Error.
-    FileSystem.setCurrentWorkingDirectory(InitialWorkingDir.get());
-  }
-  Reporter.Finish();
-  WarningsAsErrorsCount += Reporter.getWarningsAsErrorsCount();
+  ErrorDisplaySink Sink(Fix);
+  Sink.handleErrors(Errors);
+  Sink.finish();
+  WarningsAsErrorsCount += Sink.getWarningsAsErrorsCount();
 }
 
 void exportReplacements(const std::vector<ClangTidyError> &Errors,
@@ -17,6 +17,8 @@
 #include "clang/Basic/SourceManager.h"
 #include "clang/Tooling/Refactoring.h"
 #include "llvm/ADT/StringExtras.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringSet.h"
 #include "llvm/Support/raw_ostream.h"
 #include <memory>
 #include <type_traits>
@@ -103,10 +105,12 @@ private:
 /// and then override ``check(const MatchResult &Result)`` to do the actual
 /// check for each match.
 ///
-/// A new ``ClangTidyCheck`` instance is created per translation unit.
-///
-/// FIXME: Figure out whether carrying information from one TU to another is
-/// useful/necessary.
+/// Check instances are created once for each distinct configuration (enabled
+/// checks, check options and language options) and reused for all translation
+/// units with that configuration, so ``registerMatchers`` is only called once
+/// per instance. Checks that collect state while matching should reset it in
+/// ``onStartOfTranslationUnit``, or override ``isReusable``.
+/// ``registerPPCallbacks`` is called for every translation unit.
 class ClangTidyCheck : public ast_matchers::MatchFinder::MatchCallback {
 public:
   /// \brief Initializes the check with \p CheckName and \p Context.
@@ -115,7 +119,7 @@ public:
   /// delegate it. If a check needs to read options, it can do this in the
   /// constructor using the Options.get() methods below.
   ClangTidyCheck(StringRef CheckName, ClangTidyContext *Context)
-      : CheckName(CheckName), Context(Context),
+      : CheckName(CheckName), Context(Context), RecordMatches(false),
         Options(CheckName, Context->getOptions().CheckOptions) {
     assert(Context != nullptr);
     assert(!CheckName.empty());
@@ -156,11 +160,59 @@ public:
   /// whether it has the default value or it has been overridden.
   virtual void storeOptions(ClangTidyOptions::OptionMap &Options) {}
 
+  /// \brief Override this to return ``true`` if the check needs to see all
+  /// matches in the translation unit, e.g. because it collects declarations and
+  /// their uses and only reports in ``onEndOfTranslationUnit``.
+  ///
+  /// For other checks, matches are skipped if all matched nodes are located in
+  /// headers that have already been analyzed by another translation unit
+  /// (with ``-analyze-headers-once``) or in code whose diagnostics would be
+  /// filtered out anyway (with ``-prune-filtered-code``).
+  virtual bool requiresWholeTranslationUnit() const { return false; }
+
+  /// \brief Override this to return ``false`` if the check can't be reused
+  /// for another translation unit, e.g. because it keeps state that can't be
+  /// reset in ``onStartOfTranslationUnit``. A new instance of such a check is
+  /// created for each translation unit.
+  virtual bool isReusable() const { return true; }
+
+  /// \brief Override this to return ``false`` if the ``PPCallbacks`` of the
+  /// check only need the inclusion directives of the main file, e.g. to insert
+  /// ``#include`` directives with \c utils::IncludeInserter.
+  ///
+  /// When a main file is parsed with a precompiled preamble, the preprocessor
+  /// skips the directives at its start. Only their inclusion directives are
+  /// replayed to the ``PPCallbacks``, so checks that register callbacks and
+  /// need the whole preprocessor stream disable preambles.
+  virtual bool needsWholePreprocessorStream() const { return true; }
+
+  /// \brief Override this to return ``true`` if the matchers of the check may
+  /// run on a worker thread while other matchers run on the same AST.
+  ///
+  /// With ``-match-threads``, the matchers of such reusable checks run on
+  /// worker threads together with their ``onStartOfTranslationUnit`` and
+  /// ``onEndOfTranslationUnit`` callbacks. ``check`` is called on the main
+  /// thread afterwards, for each match in the order of the AST traversal.
+  ///
+  /// Only checks whose matchers just read the AST qualify: the
+  /// \c SourceManager and the lazily computed parts of the \c ASTContext are
+  /// not thread-safe, so matchers must not use them (e.g. through
+  /// ``isExpansionInMainFile``), and the check must not override the
+  /// translation unit callbacks. Checks must register themselves as the
+  /// callback of their matchers.
+  virtual bool canMatchConcurrently() const { return false; }
+
 private:
+  friend class ClangTidyASTConsumerFactory;
+
   void run(const ast_matchers::MatchFinder::MatchResult &Result) override;
   StringRef getID() const override { return CheckName; }
   std::string CheckName;
   ClangTidyContext *Context;
+  /// \brief If set, \c run stores matches in \c RecordedMatches instead of
+  /// checking them.
+  bool RecordMatches;
+  std::vector<ast_matchers::MatchFinder::MatchResult> RecordedMatches;
 
 protected:
   OptionsView Options;
@@ -168,13 +220,51 @@ protected:
   StringRef getCurrentMainFile() const { return Context->getCurrentFile(); }
   /// \brief Returns the language options from the context.
   LangOptions getLangOpts() const { return Context->getLangOpts(); }
+  /// \brief Returns the index of the current translation unit from the
+  /// context.
+  const ASTIndex &getASTIndex() const { return Context->getASTIndex(); }
+  /// \brief Returns the raw tokens of the file containing \p Loc from the
+  /// context.
+  const TokenBuffer &getTokenBuffer(SourceLocation Loc) const {
+    return Context->getTokenBuffer(Loc);
+  }
+  /// \brief Returns the state of type \c T shared by all checks in the
+  /// current translation unit from the context.
+  template <typename T, typename... ArgTs>
+  T &getSharedState(ArgTs &&... Args) const {
+    return Context->getSharedState<T>(std::forward<ArgTs>(Args)...);
+  }
 };
 
 class ClangTidyCheckFactories;
 
+/// \brief An inclusion directive at the start of a main file that was parsed
+/// into a precompiled preamble, recorded to replay it to the \c PPCallbacks
+/// of the checks when the preamble is used.
+///
+/// Locations are stored as offsets into the main file.
+struct PreambleInclusion {
+  unsigned HashOffset;
+  /// \brief The offset of the \c include, \c import or \c include_next
+  /// keyword token.
+  unsigned KeywordOffset;
+  std::string Keyword;
+  std::string FileName;
+  bool IsAngled;
+  unsigned FileNameBegin;
+  unsigned FileNameEnd;
+  bool FileNameIsTokenRange;
+  /// \brief The path of the included file, or an empty string if it wasn't
+  /// found.
+  std::string File;
+  std::string SearchPath;
+  std::string RelativePath;
+};
+
 class ClangTidyASTConsumerFactory {
 public:
   ClangTidyASTConsumerFactory(ClangTidyContext &Context);
+  ~ClangTidyASTConsumerFactory();
 
   /// \brief Returns an ASTConsumer that runs the specified clang-tidy checks.
   std::unique_ptr<clang::ASTConsumer>
@@ -186,12 +276,54 @@ public:
   /// \brief Get the union of options from all checks.
   ClangTidyOptions::OptionMap getCheckOptions();
 
+  /// \brief Returns \c true if any check created by the last call to
+  /// \c CreateASTConsumer registered \c PPCallbacks and needs the whole
+  /// preprocessor stream (see \c ClangTidyCheck::needsWholePreprocessorStream).
+  ///
+  /// Such checks need to see all preprocessor directives of the main file, so
+  /// it can't be parsed with a precompiled preamble.
+  bool checksNeedWholePreprocessorStream() const {
+    return ChecksNeedWholePreprocessorStream;
+  }
+
+  /// \brief Sets the inclusion directives of the precompiled preamble that
+  /// the next translation units are parsed with, to replay them to the
+  /// \c PPCallbacks of the checks. \p Inclusions must outlive their use.
+  void setPreambleInclusions(const std::vector<PreambleInclusion> *Inclusions) {
+    PreambleInclusions = Inclusions;
+  }
+
 private:
   typedef std::vector<std::pair<std::string, bool>> CheckersList;
   CheckersList getCheckersControlList(GlobList &Filter);
 
+  /// \brief Registers the checks of the modules that may provide checks
+  /// enabled by \p Filter and haven't been loaded yet.
+  void loadModules(const GlobList &Filter);
+
+  struct CheckSet;
+  /// \brief Returns the checks for the current file of the context, creating
+  /// them on first use of its configuration.
+  CheckSet &getCheckSet();
+
+  struct MatchGroup;
+  /// \brief Runs the matchers of the check groups of \p Set on \p Ctx
+  /// concurrently, then checks the matches of each group in turn.
+  void matchGroups(CheckSet &Set, ASTContext &Ctx);
+
   ClangTidyContext &Context;
   std::unique_ptr<ClangTidyCheckFactories> CheckFactories;
+  /// \brief Names of the modules whose checks are registered.
+  llvm::StringSet<> LoadedModules;
+  bool ChecksNeedWholePreprocessorStream;
+  const std::vector<PreambleInclusion> *PreambleInclusions;
+  /// \brief Reusable checks by their configuration, see \c getCheckSet.
+  llvm::StringMap<std::unique_ptr<CheckSet>> CheckSets;
+  /// \brief The options of the last check set lookup, and the part of the
+  /// keys of \c CheckSets computed from them. Files with the same
+  /// configuration share the options object of the provider.
+  std::shared_ptr<const ClangTidyOptions> KeyOptions;
+  std::string OptionsKey;
 };
 
 /// \brief Fills the list of check names that are enabled when the provided
@@ -206,17 +338,193 @@ std::vector<std::string> getCheckNames(const ClangTidyOptions &Options);
 /// Options.
 ClangTidyOptions::OptionMap getCheckOptions(const ClangTidyOptions &Options);
 
+/// \brief Receives the errors found by \c runClangTidy as soon as each input
+/// file is processed, so that they don't need to be kept in memory.
+class ClangTidyErrorSink {
+public:
+  virtual ~ClangTidyErrorSink() {}
+
+  /// \brief Called with the errors of each input file, in the order of the
+  /// input files. Errors already passed for a previous file are left out.
+  virtual void handleErrors(ArrayRef<ClangTidyError> Errors) = 0;
+};
+
+/// \brief Passes all errors to each of a list of sinks.
+class MultiplexErrorSink : public ClangTidyErrorSink {
+public:
+  void addSink(ClangTidyErrorSink *Sink) { Sinks.push_back(Sink); }
+  void handleErrors(ArrayRef<ClangTidyError> Errors) override;
+
+private:
+  std::vector<ClangTidyErrorSink *> Sinks;
+};
+
+/// \brief Displays errors to the user as they arrive.
+///
+/// If \p ApplyFixes is true, the fixes of the displayed errors are written to
+/// a temporary file per changed file, and applied by \c finish().
+class ErrorDisplaySink : public ClangTidyErrorSink {
+public:
+  ErrorDisplaySink(bool ApplyFixes);
+  ~ErrorDisplaySink() override;
+
+  void handleErrors(ArrayRef<ClangTidyError> Errors) override;
+
+  /// \brief Applies the collected fixes, if requested. Either all files are
+  /// changed or none is. Returns \c false if the changes couldn't be written.
+  bool finish();
+
+  unsigned getWarningsAsErrorsCount() const { return WarningsAsErrors; }
+
+private:
+  void spillFixes(ArrayRef<tooling::Replacement> Fixes);
+  void removeSpillFiles();
+
+  bool ApplyFixes;
+  unsigned TotalFixes;
+  unsigned AppliedFixes;
+  unsigned WarningsAsErrors;
+  /// \brief Whether any fixes couldn't be spilled, in which case none are
+  /// applied.
+  bool SpillFailed;
+  /// \brief The temporary directory holding the fixes for each file.
+  SmallString<128> SpillDirectory;
+  /// \brief Absolute paths of the changed files, in the order of their first
+  /// fix, and the files their fixes are spilled to.
+  std::vector<std::pair<std::string, std::string>> SpillFiles;
+  llvm::StringMap<size_t> SpillFileIndex;
+};
+
+/// \brief Writes the replacements of all errors to a YAML file as a single
+/// \c tooling::TranslationUnitReplacements document.
+///
+/// The replacements are spilled to a temporary file as they arrive, and merged
+/// into the document by \c finish. The file is only created if there are any
+/// errors.
+class ReplacementsExportSink : public ClangTidyErrorSink {
+public:
+  ReplacementsExportSink(StringRef FileName);
+  ~ReplacementsExportSink() override;
+
+  void handleErrors(ArrayRef<ClangTidyError> Errors) override;
+
+  /// \brief Writes the file. Returns \c false if it couldn't be written.
+  bool finish();
+
+private:
+  std::string FileName;
+  SmallString<128> SpillPath;
+  std::unique_ptr<llvm::raw_fd_ostream> OS;
+  bool HasErrors;
+  bool Failed;
+};
+
+/// \brief Stores all errors in a temporary file, to be passed on to another
+/// sink once all files are processed.
+class SpillingErrorSink : public ClangTidyErrorSink {
+public:
+  SpillingErrorSink();
+  ~SpillingErrorSink() override;
+
+  void handleErrors(ArrayRef<ClangTidyError> Errors) override;
+
+  /// \brief Returns \c true if any of the errors is a compiler error.
+  bool hasCompilerErrors() const { return HasCompilerErrors; }
+
+  /// \brief Passes the stored errors to \p Sink in their original batches.
+  /// Returns \c false if the errors couldn't be stored or read back.
+  bool replay(ClangTidyErrorSink &Sink);
+
+private:
+  SmallString<128> SpillPath;
+  std::unique_ptr<llvm::raw_fd_ostream> OS;
+  bool HasCompilerErrors;
+  bool Failed;
+};
+
 /// \brief Run a set of clang-tidy checks on a set of files.
 ///
+/// The errors of each file are passed to \p Sink as soon as they are known,
+/// without duplicates.
+///
 /// \param Profile if provided, it enables check profile collection in
 /// MatchFinder, and will contain the result of the profile.
 ClangTidyStats
+runClangTidy(std::unique_ptr<ClangTidyOptionsProvider> OptionsProvider,
+             const tooling::CompilationDatabase &Compilations,
+             ArrayRef<std::string> InputFiles, ClangTidyErrorSink &Sink,
+             ProfileData *Profile = nullptr);
+
+/// \brief Run a set of clang-tidy checks on a set of files and store all
+/// errors in \p Errors.
+ClangTidyStats
 runClangTidy(std::unique_ptr<ClangTidyOptionsProvider> OptionsProvider,
              const tooling::CompilationDatabase &Compilations,
              ArrayRef<std::string> InputFiles,
              std::vector<ClangTidyError> *Errors,
              ProfileData *Profile = nullptr);
 
+/// \brief Returns the files of \p Candidates that need to be analyzed to see
+/// all diagnostics in the lines changed by \p Changes.
+///
+/// These are the changed files themselves and files including any changed
+/// file. The files included by each candidate are read from the cache
+/// directory, if any, where \c runClangTidy records them, and are otherwise
+/// found by preprocessing the candidate.
+std::vector<std::string>
+getAffectedFiles(ClangTidyOptionsProvider &OptionsProvider,
+                 const tooling::CompilationDatabase &Compilations,
+                 ArrayRef<std::string> Candidates,
+                 ArrayRef<FileFilter> Changes);
+
+/// \brief Runs clang-tidy on one file at a time on request, e.g. for an editor.
+///
+/// The state that doesn't depend on the file is kept between requests: the
+/// registered checks, the options provider with the configuration files it has
+/// read, and a \c FileManager per build directory with the results of all file
+/// system lookups. Before each request the options provider is refreshed, and
+/// a \c FileManager is dropped if any file it has seen has changed since.
+///
+/// When the same file is linted again, its includes are read from a
+/// precompiled preamble, which is rebuilt when the directives at the start of
+/// the file, the compile command or any included file change. The inclusion
+/// directives of the preamble are replayed to the \c PPCallbacks of the
+/// checks, so preambles are only disabled when an enabled check registers
+/// callbacks and \c ClangTidyCheck::needsWholePreprocessorStream returns
+/// \c true. This is known after the first request with the same checks, which
+/// is parsed without a preamble.
+class ClangTidyServer {
+public:
+  ClangTidyServer(std::unique_ptr<ClangTidyOptionsProvider> OptionsProvider,
+                  const tooling::CompilationDatabase &Compilations);
+  ~ClangTidyServer();
+
+  /// \brief Runs clang-tidy on all compile commands of \p File and stores the
+  /// resulting errors in \p Errors.
+  ///
+  /// \param Content if set, is used instead of the contents of \p File on
+  /// disk, e.g. for an unsaved editor buffer.
+  ///
+  /// \param Checks if set, is appended to the checks configured for \p File
+  /// for this request only.
+  ///
+  /// Returns \c false if \p File couldn't be processed.
+  bool run(StringRef File, llvm::Optional<StringRef> Content,
+           llvm::Optional<StringRef> Checks,
+           std::vector<ClangTidyError> &Errors);
+
+  /// \brief Returns the number of compile commands run so far.
+  unsigned getNumCommands() const;
+
+  /// \brief Returns the number of compile commands that were parsed with a
+  /// precompiled preamble.
+  unsigned getNumPreambleCommands() const;
+
+private:
+  struct State;
+  std::unique_ptr<State> S;
+};
+
 // FIXME: This interface will need to be significantly extended to be useful.
 // FIXME: Implement confidence levels for displaying/fixing errors.
 //
@@ -0,0 +1,71 @@
+//===--- ClangTidyASTIndex.cpp - clang-tidy ---------------------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "ClangTidyASTIndex.h"
+#include "clang/AST/ASTContext.h"
+#include "clang/AST/RecursiveASTVisitor.h"
+#include "llvm/ADT/SmallVector.h"
+
+namespace clang {
+namespace tidy {
+
+class ASTIndex::Builder : public RecursiveASTVisitor<Builder> {
+public:
+  Builder(ASTIndex &Index) : Index(Index) { StmtStack.push_back(nullptr); }
+
+  // Cover the same code as the MatchFinder.
+  bool shouldVisitTemplateInstantiations() const { return true; }
+  bool shouldVisitImplicitCode() const { return true; }
+
+  bool TraverseStmt(Stmt *S) {
+    if (!S)
+      return true;
+    // The subtree of a statement reached again has already been indexed.
+    if (!Index.StmtParents.insert(std::make_pair(S, StmtStack.back())).second)
+      return true;
+    index(S);
+    StmtStack.push_back(S);
+    RecursiveASTVisitor<Builder>::TraverseStmt(S);
+    StmtStack.pop_back();
+    return true;
+  }
+
+private:
+  void index(const Stmt *S) {
+    if (const auto *Call = dyn_cast<CallExpr>(S)) {
+      if (const Decl *Callee = Call->getCalleeDecl())
+        Index.Calls[Callee].push_back(Call);
+    } else if (const auto *DeclRef = dyn_cast<DeclRefExpr>(S)) {
+      Index.DeclRefs[DeclRef->getDecl()].push_back(DeclRef);
+    } else if (const auto *Member = dyn_cast<MemberExpr>(S)) {
+      Index.MemberRefs[Member->getMemberDecl()].push_back(Member);
+    } else if (const auto *Decls = dyn_cast<DeclStmt>(S)) {
+      for (const Decl *D : Decls->decls())
+        if (const auto *Var = dyn_cast<VarDecl>(D))
+          Index.DeclParents.insert(std::make_pair(Var, Decls));
+    }
+  }
+
+  ASTIndex &Index;
+  llvm::SmallVector<const Stmt *, 32> StmtStack;
+};
+
+ASTIndex::ASTIndex(ASTContext &Context) {
+  Builder(*this).TraverseDecl(Context.getTranslationUnitDecl());
+}
+
+bool ASTIndex::isDescendant(const Stmt *S, const Stmt *Ancestor) const {
+  for (; S; S = getParent(S))
+    if (S == Ancestor)
+      return true;
+  return false;
+}
+
+} // end namespace tidy
+} // end namespace clang
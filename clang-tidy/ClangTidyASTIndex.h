@@ -0,0 +1,94 @@
+//===--- ClangTidyASTIndex.h - clang-tidy -----------------------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_CLANG_TOOLS_EXTRA_CLANG_TIDY_CLANGTIDYASTINDEX_H
+#define LLVM_CLANG_TOOLS_EXTRA_CLANG_TIDY_CLANGTIDYASTINDEX_H
+
+#include "clang/AST/Expr.h"
+#include "clang/AST/Stmt.h"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/DenseMap.h"
+#include <vector>
+
+namespace clang {
+
+class ASTContext;
+
+namespace tidy {
+
+/// \brief Reverse lookups over all statements of a translation unit.
+///
+/// Checks that need to find the uses of a declaration or the ancestors of a
+/// statement would otherwise run matchers over the whole translation unit for
+/// each candidate. The index is built in a single traversal, which visits
+/// template instantiations and implicit code like the \c MatchFinder does, and
+/// is shared by all checks through \c ClangTidyContext::getASTIndex.
+///
+/// Each statement is indexed once, even if the traversal reaches it twice (as
+/// for the syntactic and semantic forms of an \c InitListExpr). Statements are
+/// listed in traversal order.
+class ASTIndex {
+public:
+  typedef llvm::DenseMap<const Stmt *, const Stmt *> StmtParentMap;
+  typedef llvm::DenseMap<const VarDecl *, const DeclStmt *> DeclParentMap;
+
+  /// \brief Builds the index of all statements in \p Context.
+  explicit ASTIndex(ASTContext &Context);
+
+  /// \brief Returns the calls with \p Callee as their callee declaration.
+  ArrayRef<const CallExpr *> getCalls(const Decl *Callee) const {
+    return lookup(Calls, Callee);
+  }
+
+  /// \brief Returns the \c DeclRefExprs referring to \p D.
+  ArrayRef<const DeclRefExpr *> getDeclRefs(const ValueDecl *D) const {
+    return lookup(DeclRefs, D);
+  }
+
+  /// \brief Returns the \c MemberExprs referring to \p D.
+  ArrayRef<const MemberExpr *> getMemberRefs(const ValueDecl *D) const {
+    return lookup(MemberRefs, D);
+  }
+
+  /// \brief Returns the statement containing \p S, or \c nullptr if \p S is
+  /// the outermost statement of a declaration.
+  const Stmt *getParent(const Stmt *S) const { return StmtParents.lookup(S); }
+
+  /// \brief Returns \c true if \p S is \p Ancestor or nested in it.
+  bool isDescendant(const Stmt *S, const Stmt *Ancestor) const;
+
+  /// \brief Maps each statement to the statement containing it.
+  const StmtParentMap &getStmtParents() const { return StmtParents; }
+
+  /// \brief Maps each variable declared in a \c DeclStmt to that statement.
+  const DeclParentMap &getDeclParents() const { return DeclParents; }
+
+private:
+  class Builder;
+
+  template <typename K, typename V>
+  static ArrayRef<V>
+  lookup(const llvm::DenseMap<K, std::vector<V>> &Map, K Key) {
+    auto I = Map.find(Key);
+    if (I == Map.end())
+      return None;
+    return I->second;
+  }
+
+  StmtParentMap StmtParents;
+  DeclParentMap DeclParents;
+  llvm::DenseMap<const Decl *, std::vector<const CallExpr *>> Calls;
+  llvm::DenseMap<const ValueDecl *, std::vector<const DeclRefExpr *>> DeclRefs;
+  llvm::DenseMap<const ValueDecl *, std::vector<const MemberExpr *>> MemberRefs;
+};
+
+} // end namespace tidy
+} // end namespace clang
+
+#endif // LLVM_CLANG_TOOLS_EXTRA_CLANG_TIDY_CLANGTIDYASTINDEX_H
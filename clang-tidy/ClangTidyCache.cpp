@@ -0,0 +1,370 @@
+//===--- tools/extra/clang-tidy/ClangTidyCache.cpp - clang-tidy -----------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+///
+///  \file This file implements an on-disk cache of clang-tidy results.
+///
+//===----------------------------------------------------------------------===//
+
+#include "ClangTidyCache.h"
+#include "clang/Basic/SourceManager.h"
+#include "clang/Basic/Version.h"
+#include "clang/Tooling/ReplacementsYaml.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/YAMLTraits.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace clang;
+using namespace clang::tidy;
+
+namespace {
+// Plain, default-constructible mirrors of the cached data for YAML I/O.
+struct SerializedError {
+  InternedString CheckName;
+  ClangTidyMessage Message;
+  std::vector<tooling::Replacement> Replacements;
+  std::vector<ClangTidyMessage> Notes;
+  InternedString BuildDirectory;
+  unsigned Level;
+  bool IsWarningAsError;
+};
+
+struct SerializedEntry {
+  std::vector<ClangTidyCache::Dependency> Dependencies;
+  std::vector<SerializedError> Errors;
+  ClangTidyStats Stats;
+};
+
+struct SerializedDependencies {
+  std::vector<ClangTidyCache::Dependency> Dependencies;
+};
+} // end anonymous namespace
+
+LLVM_YAML_IS_SEQUENCE_VECTOR(ClangTidyCache::Dependency)
+LLVM_YAML_IS_SEQUENCE_VECTOR(ClangTidyMessage)
+LLVM_YAML_IS_SEQUENCE_VECTOR(SerializedError)
+
+namespace llvm {
+namespace yaml {
+
+template <> struct ScalarTraits<InternedString> {
+  static void output(const InternedString &Value, void *, raw_ostream &OS) {
+    OS << Value.str();
+  }
+  static StringRef input(StringRef Scalar, void *, InternedString &Value) {
+    Value = InternedString::get(Scalar);
+    return StringRef();
+  }
+  static bool mustQuote(StringRef Scalar) { return needsQuotes(Scalar); }
+};
+
+template <> struct MappingTraits<ClangTidyCache::Dependency> {
+  static void mapping(IO &IO, ClangTidyCache::Dependency &Dep) {
+    IO.mapRequired("Path", Dep.Path);
+    IO.mapRequired("Hash", Dep.Hash);
+  }
+};
+
+template <> struct MappingTraits<ClangTidyMessage> {
+  static void mapping(IO &IO, ClangTidyMessage &Message) {
+    IO.mapRequired("Message", Message.Message);
+    IO.mapRequired("FilePath", Message.FilePath);
+    IO.mapRequired("FileOffset", Message.FileOffset);
+  }
+};
+
+template <> struct MappingTraits<SerializedError> {
+  static void mapping(IO &IO, SerializedError &Error) {
+    IO.mapRequired("CheckName", Error.CheckName);
+    IO.mapRequired("Message", Error.Message);
+    IO.mapOptional("Replacements", Error.Replacements);
+    IO.mapOptional("Notes", Error.Notes);
+    IO.mapRequired("BuildDirectory", Error.BuildDirectory);
+    IO.mapRequired("Level", Error.Level);
+    IO.mapRequired("IsWarningAsError", Error.IsWarningAsError);
+  }
+};
+
+template <> struct MappingTraits<ClangTidyStats> {
+  static void mapping(IO &IO, ClangTidyStats &Stats) {
+    IO.mapRequired("ErrorsDisplayed", Stats.ErrorsDisplayed);
+    IO.mapRequired("ErrorsIgnoredCheckFilter",
+                   Stats.ErrorsIgnoredCheckFilter);
+    IO.mapRequired("ErrorsIgnoredNOLINT", Stats.ErrorsIgnoredNOLINT);
+    IO.mapRequired("ErrorsIgnoredNonUserCode",
+                   Stats.ErrorsIgnoredNonUserCode);
+    IO.mapRequired("ErrorsIgnoredLineFilter", Stats.ErrorsIgnoredLineFilter);
+  }
+};
+
+template <> struct MappingTraits<SerializedEntry> {
+  static void mapping(IO &IO, SerializedEntry &Entry) {
+    IO.mapRequired("Dependencies", Entry.Dependencies);
+    IO.mapOptional("Errors", Entry.Errors);
+    IO.mapRequired("Stats", Entry.Stats);
+  }
+};
+
+template <> struct MappingTraits<SerializedDependencies> {
+  static void mapping(IO &IO, SerializedDependencies &Deps) {
+    IO.mapRequired("Dependencies", Deps.Dependencies);
+  }
+};
+
+} // namespace yaml
+} // namespace llvm
+
+static SerializedError serializeError(const ClangTidyError &Error) {
+  SerializedError S;
+  S.CheckName = Error.CheckName;
+  S.Message = Error.Message;
+  S.Replacements = Error.Fix;
+  S.Notes.assign(Error.Notes.begin(), Error.Notes.end());
+  S.BuildDirectory = Error.BuildDirectory;
+  S.Level = Error.DiagLevel;
+  S.IsWarningAsError = Error.IsWarningAsError;
+  return S;
+}
+
+static void deserializeErrors(std::vector<SerializedError> &Serialized,
+                              std::vector<ClangTidyError> &Errors) {
+  for (SerializedError &Error : Serialized) {
+    Errors.emplace_back(Error.CheckName,
+                        static_cast<ClangTidyError::Level>(Error.Level),
+                        Error.IsWarningAsError, Error.BuildDirectory);
+    ClangTidyError &Restored = Errors.back();
+    Restored.Message = std::move(Error.Message);
+    Restored.Fix = std::move(Error.Replacements);
+    Restored.Notes.append(Error.Notes.begin(), Error.Notes.end());
+  }
+}
+
+namespace clang {
+namespace tidy {
+
+void writeErrors(ArrayRef<ClangTidyError> Errors, raw_ostream &OS) {
+  std::vector<SerializedError> Serialized;
+  for (const ClangTidyError &Error : Errors)
+    Serialized.push_back(serializeError(Error));
+  llvm::yaml::Output YAML(OS);
+  YAML << Serialized;
+}
+
+bool readErrors(StringRef Text,
+                llvm::function_ref<void(std::vector<ClangTidyError> &)>
+                    Callback) {
+  llvm::yaml::Input YAML(Text);
+  do {
+    std::vector<SerializedError> Serialized;
+    YAML >> Serialized;
+    if (YAML.error())
+      return false;
+    std::vector<ClangTidyError> Errors;
+    deserializeErrors(Serialized, Errors);
+    Callback(Errors);
+  } while (YAML.nextDocument());
+  return true;
+}
+
+} // end namespace tidy
+} // end namespace clang
+
+static std::string hashString(StringRef Data) {
+  llvm::MD5 Hash;
+  Hash.update(Data);
+  llvm::MD5::MD5Result Result;
+  Hash.final(Result);
+  SmallString<32> Text;
+  llvm::MD5::stringifyResult(Result, Text);
+  return Text.str();
+}
+
+// Identifies the clang-tidy binary, so that a rebuilt clang-tidy (possibly with
+// different checks) doesn't reuse results of an older one.
+static std::string getBuildID() {
+  // Exists solely for the purpose of looking up the executable path.
+  static int StaticSymbol;
+  std::string Executable =
+      llvm::sys::fs::getMainExecutable("clang-tidy", &StaticSymbol);
+  std::string ID = getClangFullVersion();
+  llvm::sys::fs::file_status Status;
+  if (!llvm::sys::fs::status(Executable, Status))
+    ID += (" " + Executable + " " + Twine(Status.getSize()) + " " +
+           Twine(Status.getLastModificationTime().toEpochTime()))
+              .str();
+  return ID;
+}
+
+ClangTidyCache::ClangTidyCache(StringRef Directory)
+    : Directory(Directory), BuildID(getBuildID()) {}
+
+std::string
+ClangTidyCache::getKey(const tooling::CommandLineArguments &Args,
+                       StringRef BuildDirectory, StringRef File,
+                       const ClangTidyOptions &Options,
+                       const ClangTidyGlobalOptions &GlobalOptions) const {
+  std::string Text;
+  llvm::raw_string_ostream OS(Text);
+  OS << BuildID << '\0' << BuildDirectory << '\0' << File << '\0';
+  for (const std::string &Arg : Args)
+    OS << Arg << '\0';
+  // SystemHeaders isn't part of the configuration text.
+  OS << configurationAsText(Options) << '\0' << *Options.SystemHeaders << '\0'
+     << GlobalOptions.PruneFilteredCode << '\0';
+  for (const FileFilter &Filter : GlobalOptions.LineFilter) {
+    OS << Filter.Name;
+    for (const FileFilter::LineRange &Range : Filter.LineRanges)
+      OS << ':' << Range.first << '-' << Range.second;
+    OS << '\0';
+  }
+  return hashString(OS.str());
+}
+
+std::string
+ClangTidyCache::getDependenciesKey(const tooling::CommandLineArguments &Args,
+                                   StringRef BuildDirectory,
+                                   StringRef File) const {
+  std::string Text;
+  llvm::raw_string_ostream OS(Text);
+  // Keep these keys distinct from the ones of result entries.
+  OS << "dependencies" << '\0' << BuildID << '\0' << BuildDirectory << '\0'
+     << File << '\0';
+  for (const std::string &Arg : Args)
+    OS << Arg << '\0';
+  return hashString(OS.str());
+}
+
+std::string ClangTidyCache::getEntryPath(StringRef Key) const {
+  // Spread entries over subdirectories to keep directory sizes manageable.
+  SmallString<256> Path(Directory);
+  llvm::sys::path::append(Path, Key.substr(0, 2), Key.substr(2) + ".yaml");
+  return Path.str();
+}
+
+llvm::Optional<ClangTidyCache::Entry>
+ClangTidyCache::lookup(StringRef Key) const {
+  llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> Text =
+      llvm::MemoryBuffer::getFile(getEntryPath(Key));
+  if (!Text)
+    return llvm::None;
+
+  SerializedEntry Serialized;
+  llvm::yaml::Input YAML((*Text)->getBuffer());
+  YAML >> Serialized;
+  // Treat unreadable entries, e.g. from a different version, as misses.
+  if (YAML.error())
+    return llvm::None;
+
+  for (const Dependency &Dep : Serialized.Dependencies) {
+    if (!isUpToDate(Dep))
+      return llvm::None;
+  }
+
+  Entry Result;
+  Result.Dependencies = std::move(Serialized.Dependencies);
+  Result.Stats = Serialized.Stats;
+  deserializeErrors(Serialized.Errors, Result.Errors);
+  return Result;
+}
+
+void ClangTidyCache::store(StringRef Key, const Entry &Value) const {
+  SerializedEntry Serialized;
+  Serialized.Dependencies = Value.Dependencies;
+  Serialized.Stats = Value.Stats;
+  for (const ClangTidyError &Error : Value.Errors)
+    Serialized.Errors.push_back(serializeError(Error));
+
+  std::string Text;
+  llvm::raw_string_ostream OS(Text);
+  llvm::yaml::Output YAML(OS);
+  YAML << Serialized;
+  writeEntry(Key, OS.str());
+}
+
+llvm::Optional<std::vector<ClangTidyCache::Dependency>>
+ClangTidyCache::lookupDependencies(StringRef Key) const {
+  llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> Text =
+      llvm::MemoryBuffer::getFile(getEntryPath(Key));
+  if (!Text)
+    return llvm::None;
+
+  SerializedDependencies Serialized;
+  llvm::yaml::Input YAML((*Text)->getBuffer());
+  YAML >> Serialized;
+  if (YAML.error())
+    return llvm::None;
+  return std::move(Serialized.Dependencies);
+}
+
+void ClangTidyCache::storeDependencies(
+    StringRef Key, const std::vector<Dependency> &Dependencies) const {
+  SerializedDependencies Serialized;
+  Serialized.Dependencies = Dependencies;
+  std::string Text;
+  llvm::raw_string_ostream OS(Text);
+  llvm::yaml::Output YAML(OS);
+  YAML << Serialized;
+  writeEntry(Key, OS.str());
+}
+
+bool ClangTidyCache::isUpToDate(const Dependency &Dep) {
+  llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> Content =
+      llvm::MemoryBuffer::getFile(Dep.Path);
+  return Content && hashString((*Content)->getBuffer()) == Dep.Hash;
+}
+
+void ClangTidyCache::writeEntry(StringRef Key, StringRef Text) const {
+  std::string Path = getEntryPath(Key);
+  StringRef EntryDirectory = llvm::sys::path::parent_path(Path);
+  if (std::error_code EC = llvm::sys::fs::create_directories(EntryDirectory)) {
+    llvm::errs() << "Can't create cache directory " << EntryDirectory << ": "
+                 << EC.message() << "\n";
+    return;
+  }
+
+  // Write to a unique temporary file and rename it, so that concurrent readers
+  // and writers never see a partially written entry.
+  int FD;
+  SmallString<256> TempPath;
+  if (std::error_code EC = llvm::sys::fs::createUniqueFile(
+          Path + ".%%%%%%%%.tmp", FD, TempPath)) {
+    llvm::errs() << "Can't create cache entry in " << EntryDirectory << ": "
+                 << EC.message() << "\n";
+    return;
+  }
+  {
+    llvm::raw_fd_ostream OS(FD, /*shouldClose=*/true);
+    OS << Text;
+  }
+  if (std::error_code EC = llvm::sys::fs::rename(TempPath, Path)) {
+    llvm::errs() << "Can't write cache entry " << Path << ": " << EC.message()
+                 << "\n";
+    llvm::sys::fs::remove(TempPath);
+  }
+}
+
+void ClangTidyCache::collectDependencies(
+    const SourceManager &Sources, StringRef BuildDirectory,
+    std::vector<Dependency> &Dependencies) {
+  for (auto I = Sources.fileinfo_begin(), E = Sources.fileinfo_end(); I != E;
+       ++I) {
+    // Files that were looked up but never read can't affect the result.
+    const llvm::MemoryBuffer *Buffer = I->second->getRawBuffer();
+    if (!Buffer)
+      continue;
+    SmallString<256> Path(I->first->getName());
+    if (!llvm::sys::path::is_absolute(Path)) {
+      Path = BuildDirectory;
+      llvm::sys::path::append(Path, I->first->getName());
+    }
+    Dependencies.push_back({Path.str(), hashString(Buffer->getBuffer())});
+  }
+}
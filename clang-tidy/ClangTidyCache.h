@@ -0,0 +1,123 @@
+//===--- ClangTidyCache.h - clang-tidy --------------------------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_CLANG_TOOLS_EXTRA_CLANG_TIDY_CLANGTIDYCACHE_H
+#define LLVM_CLANG_TOOLS_EXTRA_CLANG_TIDY_CLANGTIDYCACHE_H
+
+#include "ClangTidyDiagnosticConsumer.h"
+#include "clang/Tooling/ArgumentsAdjusters.h"
+#include "llvm/ADT/Optional.h"
+#include "llvm/ADT/STLExtras.h"
+#include <string>
+#include <vector>
+
+namespace clang {
+
+class SourceManager;
+
+namespace tidy {
+
+/// \brief An on-disk cache of the results of running clang-tidy on a single
+/// compile command.
+///
+/// Entries are looked up by a key built from the compile command, the effective
+/// options and the clang-tidy build. Each entry records the content hashes of
+/// all files read while processing the translation unit, and is only used if
+/// none of them has changed since.
+///
+/// The cache also records the files read by each compile command, which serves
+/// as an include graph for selecting the translation units affected by changes.
+///
+/// Entries are written to a temporary file and atomically renamed into place,
+/// so several clang-tidy processes can share the same cache directory.
+class ClangTidyCache {
+public:
+  /// \brief A file read while processing a translation unit.
+  struct Dependency {
+    std::string Path;
+    std::string Hash;
+  };
+
+  /// \brief The stored results of a single compile command.
+  struct Entry {
+    std::vector<Dependency> Dependencies;
+    std::vector<ClangTidyError> Errors;
+    ClangTidyStats Stats;
+  };
+
+  /// \brief Initializes the cache stored in \p Directory. The directory is
+  /// created on the first \c store, if needed.
+  ClangTidyCache(StringRef Directory);
+
+  /// \brief Returns the key for a compile command with the (adjusted)
+  /// arguments \p Args run in \p BuildDirectory on \p File.
+  ///
+  /// \p Options and \p GlobalOptions are the effective options for \p File.
+  std::string getKey(const tooling::CommandLineArguments &Args,
+                     StringRef BuildDirectory, StringRef File,
+                     const ClangTidyOptions &Options,
+                     const ClangTidyGlobalOptions &GlobalOptions) const;
+
+  /// \brief Returns the entry stored for \p Key if all of its dependencies are
+  /// unchanged.
+  llvm::Optional<Entry> lookup(StringRef Key) const;
+
+  /// \brief Stores \p Value for \p Key. Errors are reported to stderr, but
+  /// otherwise ignored.
+  void store(StringRef Key, const Entry &Value) const;
+
+  /// \brief Returns the key for the list of files read by a compile command
+  /// with the (adjusted) arguments \p Args run in \p BuildDirectory on \p File.
+  std::string getDependenciesKey(const tooling::CommandLineArguments &Args,
+                                 StringRef BuildDirectory,
+                                 StringRef File) const;
+
+  /// \brief Returns the files last recorded for \p Key, without checking
+  /// whether they have changed since.
+  llvm::Optional<std::vector<Dependency>>
+  lookupDependencies(StringRef Key) const;
+
+  /// \brief Records \p Dependencies for \p Key.
+  void storeDependencies(StringRef Key,
+                         const std::vector<Dependency> &Dependencies) const;
+
+  /// \brief Returns \c true if the contents of \p Dep haven't changed since
+  /// it was recorded.
+  static bool isUpToDate(const Dependency &Dep);
+
+  /// \brief Appends the files read through \p Sources and hashes of their
+  /// contents to \p Dependencies. Relative file names are resolved against
+  /// \p BuildDirectory.
+  static void collectDependencies(const SourceManager &Sources,
+                                  StringRef BuildDirectory,
+                                  std::vector<Dependency> &Dependencies);
+
+private:
+  std::string getEntryPath(StringRef Key) const;
+  void writeEntry(StringRef Key, StringRef Text) const;
+
+  std::string Directory;
+  std::string BuildID;
+};
+
+/// \brief Writes \p Errors to \p OS as a YAML document, in the same format as
+/// cache entries.
+void writeErrors(ArrayRef<ClangTidyError> Errors, raw_ostream &OS);
+
+/// \brief Reads the YAML documents written by \c writeErrors from \p Text and
+/// calls \p Callback with the errors of each one, in order. Returns \c false
+/// if \p Text can't be parsed.
+bool readErrors(StringRef Text,
+                llvm::function_ref<void(std::vector<ClangTidyError> &)>
+                    Callback);
+
+} // end namespace tidy
+} // end namespace clang
+
+#endif // LLVM_CLANG_TOOLS_EXTRA_CLANG_TIDY_CLANGTIDYCACHE_H
@@ -21,7 +21,12 @@
 #include "clang/AST/ASTDiagnostic.h"
 #include "clang/Basic/DiagnosticOptions.h"
 #include "clang/Frontend/DiagnosticRenderer.h"
+#include "llvm/ADT/Hashing.h"
 #include "llvm/ADT/SmallString.h"
+#include "llvm/Support/Format.h"
+#include <algorithm>
+#include <iterator>
+#include <limits>
 #include <tuple>
 #include <vector>
 using namespace clang;
@@ -45,7 +50,8 @@ protected:
     // FIXME: Remove this once there's a better way to pass check names than
     // appending the check name to the message in ClangTidyContext::diag and
     // using getCustomDiagID.
-    std::string CheckNameInMessage = " [" + Error.CheckName + "]";
+    std::string CheckNameInMessage =
+        (" [" + Error.CheckName.str() + "]").str();
     if (Message.endswith(CheckNameInMessage))
       Message = Message.substr(0, Message.size() - CheckNameInMessage.size());
 
@@ -77,7 +83,7 @@ protected:
       assert(Range.getBegin().isFileID() && Range.getEnd().isFileID() &&
              "Only file locations supported in fix-it hints.");
 
-      Error.Fix.insert(tooling::Replacement(SM, Range, FixIt.CodeToInsert));
+      Error.Fix.push_back(tooling::Replacement(SM, Range, FixIt.CodeToInsert));
     }
   }
 
@@ -95,6 +101,9 @@ protected:
   void endDiagnostic(DiagOrStoredDiag D,
                      DiagnosticsEngine::Level Level) override {
     assert(!Error.Message.Message.empty() && "Message has not been set");
+    std::sort(Error.Fix.begin(), Error.Fix.end());
+    Error.Fix.erase(std::unique(Error.Fix.begin(), Error.Fix.end()),
+                    Error.Fix.end());
   }
 
 private:
@@ -102,6 +111,24 @@ private:
 };
 } // end anonymous namespace
 
+InternedString InternedString::get(StringRef S) {
+  if (S.empty())
+    return InternedString();
+  // Each thread looks up the strings it has seen before without taking the
+  // lock of the shared table.
+  static thread_local llvm::StringMap<const llvm::StringMapEntry<char> *>
+      ThreadCache;
+  const llvm::StringMapEntry<char> *&Cached = ThreadCache[S];
+  if (!Cached) {
+    static std::mutex Mutex;
+    static llvm::StringSet<llvm::BumpPtrAllocator> *Strings =
+        new llvm::StringSet<llvm::BumpPtrAllocator>();
+    std::lock_guard<std::mutex> Lock(Mutex);
+    Cached = &*Strings->insert(S).first;
+  }
+  return InternedString(Cached);
+}
+
 ClangTidyMessage::ClangTidyMessage(StringRef Message)
     : Message(Message), FileOffset(0) {}
 
@@ -110,14 +137,14 @@ ClangTidyMessage::ClangTidyMessage(StringRef Message,
                                    SourceLocation Loc)
     : Message(Message) {
   assert(Loc.isValid() && Loc.isFileID());
-  FilePath = Sources.getFilename(Loc);
+  FilePath = InternedString::get(Sources.getFilename(Loc));
   FileOffset = Sources.getFileOffset(Loc);
 }
 
-ClangTidyError::ClangTidyError(StringRef CheckName,
+ClangTidyError::ClangTidyError(InternedString CheckName,
                                ClangTidyError::Level DiagLevel,
                                bool IsWarningAsError,
-                               StringRef BuildDirectory)
+                               InternedString BuildDirectory)
     : CheckName(CheckName), BuildDirectory(BuildDirectory), DiagLevel(DiagLevel),
       IsWarningAsError(IsWarningAsError) {}
 
@@ -130,41 +157,250 @@ static bool ConsumeNegativeIndicator(StringRef &GlobList) {
   }
   return false;
 }
-// Converts first glob from the comma-separated list of globs to Regex and
-// removes it and the trailing comma from the GlobList.
-static llvm::Regex ConsumeGlob(StringRef &GlobList) {
+// Returns the first glob from the comma-separated list of globs and removes it
+// and the trailing comma from the GlobList.
+static StringRef ConsumeGlob(StringRef &GlobList) {
   StringRef Glob = GlobList.substr(0, GlobList.find(',')).trim();
   GlobList = GlobList.substr(Glob.size() + 1);
-  SmallString<128> RegexText("^");
-  StringRef MetaChars("()^$|*+?.[]\\{}");
-  for (char C : Glob) {
-    if (C == '*')
-      RegexText.push_back('.');
-    else if (MetaChars.find(C) != StringRef::npos)
-      RegexText.push_back('\\');
-    RegexText.push_back(C);
+  return Glob;
+}
+
+// Returns true if the whole of S matches Pattern, where '*' matches any
+// (possibly empty) sequence of characters and any other character matches
+// itself. Backtracks only to the most recent '*', which is sufficient for this
+// kind of pattern and keeps matching linear in practice.
+static bool matchesWildcard(StringRef Pattern, StringRef S) {
+  size_t P = 0, I = 0;
+  size_t StarP = StringRef::npos, StarI = 0;
+  while (I < S.size()) {
+    if (P < Pattern.size() && Pattern[P] == '*') {
+      StarP = P++;
+      StarI = I;
+    } else if (P < Pattern.size() && Pattern[P] == S[I]) {
+      ++P;
+      ++I;
+    } else if (StarP != StringRef::npos) {
+      P = StarP + 1;
+      I = ++StarI;
+    } else {
+      return false;
+    }
   }
-  RegexText.push_back('$');
-  return llvm::Regex(RegexText);
+  while (P < Pattern.size() && Pattern[P] == '*')
+    ++P;
+  return P == Pattern.size();
 }
 
-GlobList::GlobList(StringRef Globs)
-    : Positive(!ConsumeNegativeIndicator(Globs)), Regex(ConsumeGlob(Globs)),
-      NextGlob(Globs.empty() ? nullptr : new GlobList(Globs)) {}
+GlobList::GlobList(StringRef Globs) {
+  do {
+    bool Positive = !ConsumeNegativeIndicator(Globs);
+    this->Globs.push_back({Positive, ConsumeGlob(Globs)});
+  } while (!Globs.empty());
+}
 
-bool GlobList::contains(StringRef S, bool Contains) {
-  if (Regex.match(S))
-    Contains = Positive;
+bool GlobList::contains(StringRef S) {
+  auto Cached = Cache.find(S);
+  if (Cached != Cache.end())
+    return Cached->second;
+  bool Result = computeContains(S);
+  Cache[S] = Result;
+  return Result;
+}
 
-  if (NextGlob)
-    Contains = NextGlob->contains(S, Contains);
-  return Contains;
+bool GlobList::mayContainPrefix(StringRef Prefix) const {
+  for (const Glob &G : Globs) {
+    if (!G.Positive)
+      continue;
+    size_t Star = G.Pattern.find('*');
+    if (Star == std::string::npos) {
+      if (StringRef(G.Pattern).startswith(Prefix))
+        return true;
+      continue;
+    }
+    StringRef Literal = StringRef(G.Pattern).substr(0, Star);
+    if (Literal.startswith(Prefix) || Prefix.startswith(Literal))
+      return true;
+  }
+  return false;
+}
+
+bool GlobList::computeContains(StringRef S) const {
+  // The last matching glob decides, so search from the end.
+  for (auto I = Globs.rbegin(), E = Globs.rend(); I != E; ++I)
+    if (matchesWildcard(I->Pattern, S))
+      return I->Positive;
+  return false;
+}
+
+NoLintIndex::NoLintIndex(StringRef Buffer) {
+  // Suppressed lines with the index of their check list.
+  std::vector<std::pair<unsigned, unsigned>> SuppressedLines;
+  // Blocks as the first and last line and the index of their check list.
+  std::vector<std::tuple<unsigned, unsigned, unsigned>> Ranges;
+  std::vector<std::pair<unsigned, unsigned>> OpenBlocks;
+  llvm::StringMap<unsigned> CheckListIndexes;
+
+  unsigned Line = 1;
+  size_t Scanned = 0;
+  for (size_t Pos = Buffer.find("NOLINT"); Pos != StringRef::npos;
+       Pos = Buffer.find("NOLINT", Pos)) {
+    Line += Buffer.slice(Scanned, Pos).count('\n');
+    Scanned = Pos;
+    StringRef Rest = Buffer.substr(Pos);
+    auto Consume = [&Rest](StringRef Prefix) {
+      if (!Rest.startswith(Prefix))
+        return false;
+      Rest = Rest.drop_front(Prefix.size());
+      return true;
+    };
+    Consume("NOLINT");
+    enum { SameLine, NextLine, Begin, End } Kind = SameLine;
+    if (Consume("NEXTLINE"))
+      Kind = NextLine;
+    else if (Consume("BEGIN"))
+      Kind = Begin;
+    else if (Consume("END"))
+      Kind = End;
+    // As in cpplint.py, a list that isn't closed on the same line suppresses
+    // all checks.
+    StringRef Checks;
+    if (Rest.startswith("(")) {
+      size_t Close = Rest.find_first_of(")\n");
+      if (Close != StringRef::npos && Rest[Close] == ')') {
+        Checks = Rest.slice(1, Close);
+        Rest = Rest.drop_front(Close + 1);
+      }
+    }
+    Pos = Rest.data() - Buffer.data();
+
+    auto Inserted = CheckListIndexes.insert(
+        std::make_pair(Checks.trim(), unsigned(CheckLists.size())));
+    unsigned Index = Inserted.first->second;
+    if (Inserted.second) {
+      SmallVector<StringRef, 4> Names;
+      Checks.split(Names, ',', /*MaxSplit=*/-1, /*KeepEmpty=*/false);
+      CheckList List;
+      for (StringRef Name : Names)
+        if (!Name.trim().empty())
+          List.push_back(Name.trim().str());
+      CheckLists.push_back(std::move(List));
+    }
+
+    switch (Kind) {
+    case SameLine:
+      SuppressedLines.push_back(std::make_pair(Line, Index));
+      break;
+    case NextLine:
+      SuppressedLines.push_back(std::make_pair(Line + 1, Index));
+      break;
+    case Begin:
+      OpenBlocks.push_back(std::make_pair(Line, Index));
+      break;
+    case End: {
+      auto Open = std::find_if(OpenBlocks.rbegin(), OpenBlocks.rend(),
+                               [Index](const std::pair<unsigned, unsigned> &B) {
+                                 return B.second == Index;
+                               });
+      if (Open != OpenBlocks.rend()) {
+        Ranges.push_back(std::make_tuple(Open->first, Line, Index));
+        OpenBlocks.erase(std::next(Open).base());
+      }
+      break;
+    }
+    }
+  }
+  for (const auto &Open : OpenBlocks)
+    Ranges.push_back(std::make_tuple(
+        Open.first, std::numeric_limits<unsigned>::max(), Open.second));
+
+  std::sort(SuppressedLines.begin(), SuppressedLines.end());
+  for (const auto &Suppressed : SuppressedLines) {
+    if (Lines.empty() || Lines.back().first != Suppressed.first)
+      Lines.push_back(
+          std::make_pair(Suppressed.first, std::vector<unsigned>()));
+    Lines.back().second.push_back(Suppressed.second);
+  }
+
+  if (Ranges.empty())
+    return;
+  // Split the file into segments at each line where a block starts or ends.
+  // There are usually only a few blocks, so each segment simply collects the
+  // blocks overlapping it.
+  std::vector<unsigned> Boundaries(1, 1);
+  for (const auto &Range : Ranges) {
+    Boundaries.push_back(std::get<0>(Range));
+    if (std::get<1>(Range) != std::numeric_limits<unsigned>::max())
+      Boundaries.push_back(std::get<1>(Range) + 1);
+  }
+  std::sort(Boundaries.begin(), Boundaries.end());
+  Boundaries.erase(std::unique(Boundaries.begin(), Boundaries.end()),
+                   Boundaries.end());
+  for (unsigned Boundary : Boundaries) {
+    Segment S;
+    S.Line = Boundary;
+    for (const auto &Range : Ranges)
+      if (std::get<0>(Range) <= Boundary && Boundary <= std::get<1>(Range))
+        S.Suppressions.push_back(std::get<2>(Range));
+    Blocks.push_back(std::move(S));
+  }
+}
+
+bool NoLintIndex::isSuppressed(unsigned Line, StringRef CheckName) const {
+  auto Suppresses = [&](unsigned Index) {
+    const CheckList &Checks = CheckLists[Index];
+    return Checks.empty() ||
+           std::any_of(Checks.begin(), Checks.end(),
+                       [&](const std::string &Pattern) {
+                         return matchesWildcard(Pattern, CheckName);
+                       });
+  };
+
+  auto L = std::lower_bound(
+      Lines.begin(), Lines.end(), Line,
+      [](const std::pair<unsigned, std::vector<unsigned>> &Entry,
+         unsigned Line) { return Entry.first < Line; });
+  if (L != Lines.end() && L->first == Line &&
+      std::any_of(L->second.begin(), L->second.end(), Suppresses))
+    return true;
+
+  auto B = std::upper_bound(
+      Blocks.begin(), Blocks.end(), Line,
+      [](unsigned Line, const Segment &S) { return Line < S.Line; });
+  if (B == Blocks.begin())
+    return false;
+  --B;
+  return std::any_of(B->Suppressions.begin(), B->Suppressions.end(),
+                     Suppresses);
+}
+
+AnalyzedHeaderRegistry::Header
+AnalyzedHeaderRegistry::getHeader(const FileEntry *File, StringRef Contents,
+                                  size_t OptionsHash) {
+  return std::make_tuple(File->getUniqueID(), llvm::hash_value(Contents),
+                         OptionsHash);
+}
+
+bool AnalyzedHeaderRegistry::claim(const Header &H) {
+  std::lock_guard<std::mutex> Lock(Mutex);
+  return Claimed.insert(H).second;
+}
+
+void AnalyzedHeaderRegistry::release(ArrayRef<Header> Headers) {
+  std::lock_guard<std::mutex> Lock(Mutex);
+  for (const Header &H : Headers)
+    Claimed.erase(H);
 }
 
 ClangTidyContext::ClangTidyContext(
     std::unique_ptr<ClangTidyOptionsProvider> OptionsProvider)
     : DiagEngine(nullptr), OptionsProvider(std::move(OptionsProvider)),
-      Profile(nullptr) {
+      CurrentOptionsHash(0), CheckFilter(nullptr),
+      WarningAsErrorFilter(nullptr), HeaderFilter(nullptr),
+      CurrentASTContext(nullptr), Profile(nullptr), AnalyzedHeaders(nullptr),
+      HasSkippedHeaders(false),
+      TranslationUnitOverBudget(false), TranslationUnitMemory(0) {
+  TranslationUnitTimeBudget = getGlobalOptions().TranslationUnitTimeBudget;
+  CheckTimeBudget = getGlobalOptions().CheckTimeBudget;
   // Before the first translation unit we can get errors related to command-line
   // parsing, use empty string for the file name in this case.
   setCurrentFile("");
@@ -177,7 +413,8 @@ DiagnosticBuilder ClangTidyContext::diag(
   unsigned ID = DiagEngine->getDiagnosticIDs()->getCustomDiagID(
       Level, (Description + " [" + CheckName + "]").str());
   if (CheckNamesByDiagnosticID.count(ID) == 0)
-    CheckNamesByDiagnosticID.insert(std::make_pair(ID, CheckName.str()));
+    CheckNamesByDiagnosticID.insert(
+        std::make_pair(ID, InternedString::get(CheckName)));
   return DiagEngine->Report(Loc, ID);
 }
 
@@ -192,13 +429,64 @@ void ClangTidyContext::setSourceManager(SourceManager *SourceMgr) {
 void ClangTidyContext::setCurrentFile(StringRef File) {
   CurrentFile = File;
   CurrentOptions = getOptionsForFile(CurrentFile);
-  CheckFilter.reset(new GlobList(*getOptions().Checks));
-  WarningAsErrorFilter.reset(new GlobList(*getOptions().WarningsAsErrors));
+  CheckFilter = &getGlobList(*getOptions().Checks);
+  WarningAsErrorFilter = &getGlobList(*getOptions().WarningsAsErrors);
+  std::unique_ptr<llvm::Regex> &Regex =
+      HeaderFilters[*getOptions().HeaderFilterRegex];
+  if (!Regex)
+    Regex.reset(new llvm::Regex(*getOptions().HeaderFilterRegex));
+  HeaderFilter = Regex.get();
+  // The checks, the header filter and the check options are all part of the
+  // configuration text; SystemHeaders isn't.
+  if (CurrentOptions != HashedOptions) {
+    HashedOptions = CurrentOptions;
+    CurrentOptionsHash = llvm::hash_combine(
+        configurationAsText(getOptions()), *getOptions().SystemHeaders);
+  }
+  FileIsAnalyzedElsewhere.clear();
+  HasSkippedHeaders = false;
+  FileScopes.clear();
+  NoLintIndexes.clear();
+  TokenBuffers.clear();
+  SharedStates.clear();
+  TranslationUnitStart = std::chrono::steady_clock::now();
+  TranslationUnitOverBudget = false;
+  CheckTimes.clear();
+  ChecksOverBudget.clear();
+  TranslationUnitMemory = 0;
+}
+
+GlobList &ClangTidyContext::getGlobList(StringRef Globs) {
+  std::unique_ptr<GlobList> &Result = GlobLists[Globs];
+  if (!Result)
+    Result.reset(new GlobList(Globs));
+  return *Result;
 }
 
 void ClangTidyContext::setASTContext(ASTContext *Context) {
   DiagEngine->SetArgToStringFn(&FormatASTNodeDiagnosticArgument, Context);
   LangOpts = Context->getLangOpts();
+  CurrentASTContext = Context;
+  Index.reset();
+  TokenBuffers.clear();
+}
+
+const ASTIndex &ClangTidyContext::getASTIndex() {
+  assert(CurrentASTContext && "No translation unit is being processed");
+  if (!Index)
+    Index.reset(new ASTIndex(*CurrentASTContext));
+  return *Index;
+}
+
+const TokenBuffer &ClangTidyContext::getTokenBuffer(SourceLocation Loc) {
+  if (!Loc.isFileID())
+    return EmptyTokenBuffer;
+  const SourceManager &Sources = DiagEngine->getSourceManager();
+  FileID FID = Sources.getFileID(Loc);
+  std::unique_ptr<TokenBuffer> &Tokens = TokenBuffers[FID];
+  if (!Tokens)
+    Tokens.reset(new TokenBuffer(Sources, FID, LangOpts));
+  return *Tokens;
 }
 
 const ClangTidyGlobalOptions &ClangTidyContext::getGlobalOptions() const {
@@ -206,14 +494,12 @@ const ClangTidyGlobalOptions &ClangTidyContext::getGlobalOptions() const {
 }
 
 const ClangTidyOptions &ClangTidyContext::getOptions() const {
-  return CurrentOptions;
+  return *CurrentOptions;
 }
 
-ClangTidyOptions ClangTidyContext::getOptionsForFile(StringRef File) const {
-  // Merge options on top of getDefaults() as a safeguard against options with
-  // unset values.
-  return ClangTidyOptions::getDefaults().mergeWith(
-      OptionsProvider->getOptions(File));
+std::shared_ptr<const ClangTidyOptions>
+ClangTidyContext::getOptionsForFile(StringRef File) const {
+  return OptionsProvider->getMergedOptions(File);
 }
 
 void ClangTidyContext::setCheckProfileData(ProfileData *P) { Profile = P; }
@@ -228,22 +514,213 @@ GlobList &ClangTidyContext::getWarningAsErrorFilter() {
   return *WarningAsErrorFilter;
 }
 
+llvm::Regex &ClangTidyContext::getHeaderFilter() {
+  assert(HeaderFilter != nullptr);
+  return *HeaderFilter;
+}
+
+bool ClangTidyContext::isAnalyzedElsewhere(SourceLocation Loc) {
+  if (!AnalyzedHeaders || Loc.isInvalid())
+    return false;
+  const SourceManager &Sources = DiagEngine->getSourceManager();
+  FileID FID = Sources.getFileID(Sources.getExpansionLoc(Loc));
+  const FileEntry *File = Sources.getFileEntryForID(FID);
+  if (!File || FID == Sources.getMainFileID())
+    return false;
+
+  // Cache per FileEntry rather than per FileID, as a header without include
+  // guards may be entered several times.
+  auto Iter = FileIsAnalyzedElsewhere.find(File);
+  if (Iter != FileIsAnalyzedElsewhere.end())
+    return Iter->second;
+  bool Invalid = false;
+  StringRef Contents = Sources.getBufferData(FID, &Invalid);
+  bool Result = false;
+  if (!Invalid) {
+    AnalyzedHeaderRegistry::Header Header =
+        AnalyzedHeaderRegistry::getHeader(File, Contents, CurrentOptionsHash);
+    Result = !AnalyzedHeaders->claim(Header);
+    if (!Result)
+      ClaimedHeaders.push_back(Header);
+  }
+  FileIsAnalyzedElsewhere[File] = Result;
+  HasSkippedHeaders = HasSkippedHeaders || Result;
+  return Result;
+}
+
+void ClangTidyContext::endHeaderClaims(bool Analyzed) {
+  if (AnalyzedHeaders && !Analyzed)
+    AnalyzedHeaders->release(ClaimedHeaders);
+  ClaimedHeaders.clear();
+}
+
+// Mirrors the file-level part of ClangTidyDiagnosticConsumer::checkFilters.
+ClangTidyContext::FileScope ClangTidyContext::getFileScope(FileID FID) {
+  auto Iter = FileScopes.find(FID);
+  if (Iter != FileScopes.end())
+    return Iter->second;
+
+  FileScope Scope = {true, nullptr};
+  const SourceManager &Sources = DiagEngine->getSourceManager();
+  SourceLocation Loc = Sources.getLocForStartOfFile(FID);
+  const FileEntry *File = Sources.getFileEntryForID(FID);
+  if (!*getOptions().SystemHeaders && Sources.isInSystemHeader(Loc)) {
+    Scope.Visible = false;
+  } else if (File) {
+    if (FID != Sources.getMainFileID()) {
+      Scope.Visible = getHeaderFilter().match(File->getName());
+    }
+    const std::vector<FileFilter> &LineFilters = getGlobalOptions().LineFilter;
+    if (Scope.Visible && !LineFilters.empty()) {
+      Scope.Visible = false;
+      for (const FileFilter &Filter : LineFilters) {
+        if (StringRef(File->getName()).endswith(Filter.Name)) {
+          Scope.Visible = true;
+          Scope.LineFilter = &Filter;
+          break;
+        }
+      }
+    }
+  }
+  FileScopes[FID] = Scope;
+  return Scope;
+}
+
+bool ClangTidyContext::isInAnalysisScope(SourceRange Range) {
+  SourceLocation Begin = Range.getBegin();
+  if (Begin.isInvalid())
+    return true;
+  if (isAnalyzedElsewhere(Begin))
+    return false;
+  return !getGlobalOptions().PruneFilteredCode || passesFilters(Range);
+}
+
+bool ClangTidyContext::passesFilters(SourceRange Range) {
+  SourceLocation Begin = Range.getBegin();
+  if (Begin.isInvalid())
+    return true;
+  const SourceManager &Sources = DiagEngine->getSourceManager();
+  SourceLocation ExpansionBegin = Sources.getExpansionLoc(Begin);
+  FileID FID = Sources.getFileID(ExpansionBegin);
+  FileScope Scope = getFileScope(FID);
+  if (!Scope.Visible)
+    return false;
+  if (!Scope.LineFilter || Scope.LineFilter->LineRanges.empty())
+    return true;
+
+  // Keep the code if any line of the range passes the line filter.
+  unsigned BeginLine = Sources.getExpansionLineNumber(Begin);
+  unsigned EndLine = std::numeric_limits<unsigned>::max();
+  SourceLocation ExpansionEnd = Sources.getExpansionLoc(Range.getEnd());
+  if (ExpansionEnd.isValid() && Sources.getFileID(ExpansionEnd) == FID)
+    EndLine = Sources.getExpansionLineNumber(ExpansionEnd);
+  for (const FileFilter::LineRange &LineRange : Scope.LineFilter->LineRanges) {
+    if (LineRange.first <= EndLine && BeginLine <= LineRange.second)
+      return true;
+  }
+  return false;
+}
+
+bool ClangTidyContext::passesLineFilter(StringRef FileName,
+                                        unsigned LineNumber) const {
+  if (getGlobalOptions().LineFilter.empty())
+    return true;
+  for (const FileFilter &Filter : getGlobalOptions().LineFilter) {
+    if (FileName.endswith(Filter.Name)) {
+      if (Filter.LineRanges.empty())
+        return true;
+      for (const FileFilter::LineRange &Range : Filter.LineRanges) {
+        if (Range.first <= LineNumber && LineNumber <= Range.second)
+          return true;
+      }
+      return false;
+    }
+  }
+  return false;
+}
+
+bool ClangTidyContext::isSuppressedByNOLINT(SourceLocation Loc,
+                                            StringRef CheckName) {
+  const SourceManager &Sources = DiagEngine->getSourceManager();
+  std::pair<FileID, unsigned> Decomposed =
+      Sources.getDecomposedSpellingLoc(Loc);
+  std::unique_ptr<NoLintIndex> &Index = NoLintIndexes[Decomposed.first];
+  if (!Index) {
+    bool Invalid = false;
+    StringRef Buffer = Sources.getBufferData(Decomposed.first, &Invalid);
+    Index.reset(new NoLintIndex(Invalid ? StringRef() : Buffer));
+  }
+  return Index->isSuppressed(
+      Sources.getLineNumber(Decomposed.first, Decomposed.second), CheckName);
+}
+
+double ClangTidyContext::getTranslationUnitTime() const {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       TranslationUnitStart)
+      .count();
+}
+
+bool ClangTidyContext::isTranslationUnitOverTimeBudget() {
+  if (TranslationUnitOverBudget)
+    return true;
+  if (TranslationUnitTimeBudget <= 0)
+    return false;
+  double Elapsed = getTranslationUnitTime();
+  if (Elapsed <= TranslationUnitTimeBudget)
+    return false;
+  TranslationUnitOverBudget = true;
+  std::string Message;
+  llvm::raw_string_ostream OS(Message);
+  OS << "translation unit exceeded its time budget of "
+     << llvm::format("%.2f", TranslationUnitTimeBudget) << "s after "
+     << llvm::format("%.2f", Elapsed) << "s; no more checks are run on it";
+  reportTimeBudget(OS.str());
+  return true;
+}
+
+bool ClangTidyContext::isOverTimeBudget(StringRef CheckName) {
+  return isTranslationUnitOverTimeBudget() ||
+         ChecksOverBudget.count(CheckName) != 0;
+}
+
+void ClangTidyContext::addCheckTime(StringRef CheckName, double Seconds) {
+  if (CheckTimeBudget <= 0)
+    return;
+  double &Time = CheckTimes[CheckName];
+  Time += Seconds;
+  if (Time <= CheckTimeBudget || !ChecksOverBudget.insert(CheckName).second)
+    return;
+  std::string Message;
+  llvm::raw_string_ostream OS(Message);
+  OS << "check '" << CheckName << "' exceeded its time budget of "
+     << llvm::format("%.2f", CheckTimeBudget) << "s after "
+     << llvm::format("%.2f", Time)
+     << "s; it is disabled for the rest of the translation unit";
+  reportTimeBudget(OS.str());
+}
+
+void ClangTidyContext::reportTimeBudget(StringRef Message) {
+  ClangTidyError Error(InternedString::get("clang-tidy-budget"),
+                       ClangTidyError::Warning, /*IsWarningAsError=*/false,
+                       CurrentBuildDirectory);
+  Error.Message.Message = Message;
+  Error.Message.FilePath = InternedString::get(CurrentFile);
+  storeError(std::move(Error));
+  ++Stats.TimeBudgetsExceeded;
+}
+
 /// \brief Store a \c ClangTidyError.
-void ClangTidyContext::storeError(const ClangTidyError &Error) {
-  Errors.push_back(Error);
+void ClangTidyContext::storeError(ClangTidyError Error) {
+  Errors.push_back(std::move(Error));
 }
 
-StringRef ClangTidyContext::getCheckName(unsigned DiagnosticID) const {
-  llvm::DenseMap<unsigned, std::string>::const_iterator I =
-      CheckNamesByDiagnosticID.find(DiagnosticID);
-  if (I != CheckNamesByDiagnosticID.end())
-    return I->second;
-  return "";
+InternedString ClangTidyContext::getCheckName(unsigned DiagnosticID) const {
+  return CheckNamesByDiagnosticID.lookup(DiagnosticID);
 }
 
 ClangTidyDiagnosticConsumer::ClangTidyDiagnosticConsumer(ClangTidyContext &Ctx)
     : Context(Ctx), LastErrorRelatesToUserCode(false),
-      LastErrorPassesLineFilter(false) {
+      LastErrorPassesLineFilter(false), LastErrorIsSuppressed(false) {
   IntrusiveRefCntPtr<DiagnosticOptions> DiagOpts = new DiagnosticOptions();
   Diags.reset(new DiagnosticsEngine(
       IntrusiveRefCntPtr<DiagnosticIDs>(new DiagnosticIDs), &*DiagOpts, this,
@@ -252,7 +729,9 @@ ClangTidyDiagnosticConsumer::ClangTidyDiagnosticConsumer(ClangTidyContext &Ctx)
 }
 
 void ClangTidyDiagnosticConsumer::finalizeLastError() {
-  if (!Errors.empty()) {
+  // A suppressed diagnostic isn't stored, and the last stored one has already
+  // been finalized.
+  if (!Errors.empty() && !LastErrorIsSuppressed) {
     ClangTidyError &Error = Errors.back();
     if (!Context.getChecksFilter().contains(Error.CheckName) &&
         Error.DiagLevel != ClangTidyError::Error) {
@@ -270,37 +749,16 @@ void ClangTidyDiagnosticConsumer::finalizeLastError() {
   }
   LastErrorRelatesToUserCode = false;
   LastErrorPassesLineFilter = false;
-}
-
-static bool LineIsMarkedWithNOLINT(SourceManager& SM, SourceLocation Loc) {
-  bool Invalid;
-  const char *CharacterData = SM.getCharacterData(Loc, &Invalid);
-  if (!Invalid) {
-    const char *P = CharacterData;
-    while (*P != '\0' && *P != '\r' && *P != '\n')
-      ++P;
-    StringRef RestOfLine(CharacterData, P - CharacterData + 1);
-    // FIXME: Handle /\bNOLINT\b(\([^)]*\))?/ as cpplint.py does.
-    if (RestOfLine.find("NOLINT") != StringRef::npos) {
-      return true;
-    }
-  }
-  return false;
+  LastErrorIsSuppressed = false;
 }
 
 void ClangTidyDiagnosticConsumer::HandleDiagnostic(
     DiagnosticsEngine::Level DiagLevel, const Diagnostic &Info) {
-  if (Info.getLocation().isValid() &&
-      DiagLevel != DiagnosticsEngine::Error &&
-      DiagLevel != DiagnosticsEngine::Fatal &&
-      LineIsMarkedWithNOLINT(Diags->getSourceManager(), Info.getLocation())) {
-    ++Context.Stats.ErrorsIgnoredNOLINT;
-    return;
-  }
-  // Count warnings/errors.
-  DiagnosticConsumer::HandleDiagnostic(DiagLevel, Info);
-
   if (DiagLevel == DiagnosticsEngine::Note) {
+    if (LastErrorIsSuppressed)
+      return;
+    // Count warnings/errors.
+    DiagnosticConsumer::HandleDiagnostic(DiagLevel, Info);
     assert(!Errors.empty() &&
            "A diagnostic note can only be appended to a message.");
   } else {
@@ -308,9 +766,12 @@ void ClangTidyDiagnosticConsumer::HandleDiagnostic(
     StringRef WarningOption =
         Context.DiagEngine->getDiagnosticIDs()->getWarningOptionForDiag(
             Info.getID());
-    std::string CheckName = !WarningOption.empty()
-                                ? ("clang-diagnostic-" + WarningOption).str()
-                                : Context.getCheckName(Info.getID()).str();
+    // The names of the checks are interned when their diagnostic IDs are
+    // created.
+    InternedString CheckName =
+        !WarningOption.empty()
+            ? InternedString::get(("clang-diagnostic-" + WarningOption).str())
+            : Context.getCheckName(Info.getID());
 
     if (CheckName.empty()) {
       // This is a compiler diagnostic without a warning option. Assign check
@@ -318,17 +779,29 @@ void ClangTidyDiagnosticConsumer::HandleDiagnostic(
       switch (DiagLevel) {
       case DiagnosticsEngine::Error:
       case DiagnosticsEngine::Fatal:
-        CheckName = "clang-diagnostic-error";
+        CheckName = InternedString::get("clang-diagnostic-error");
         break;
       case DiagnosticsEngine::Warning:
-        CheckName = "clang-diagnostic-warning";
+        CheckName = InternedString::get("clang-diagnostic-warning");
         break;
       default:
-        CheckName = "clang-diagnostic-unknown";
+        CheckName = InternedString::get("clang-diagnostic-unknown");
         break;
       }
     }
 
+    // Reject suppressed diagnostics before any formatting is done.
+    LastErrorIsSuppressed =
+        Info.getLocation().isValid() && DiagLevel != DiagnosticsEngine::Error &&
+        DiagLevel != DiagnosticsEngine::Fatal &&
+        Context.isSuppressedByNOLINT(Info.getLocation(), CheckName);
+    if (LastErrorIsSuppressed) {
+      ++Context.Stats.ErrorsIgnoredNOLINT;
+      return;
+    }
+    // Count warnings/errors.
+    DiagnosticConsumer::HandleDiagnostic(DiagLevel, Info);
+
     ClangTidyError::Level Level = ClangTidyError::Warning;
     if (DiagLevel == DiagnosticsEngine::Error ||
         DiagLevel == DiagnosticsEngine::Fatal) {
@@ -359,24 +832,6 @@ void ClangTidyDiagnosticConsumer::HandleDiagnostic(
   checkFilters(Info.getLocation());
 }
 
-bool ClangTidyDiagnosticConsumer::passesLineFilter(StringRef FileName,
-                                                   unsigned LineNumber) const {
-  if (Context.getGlobalOptions().LineFilter.empty())
-    return true;
-  for (const FileFilter &Filter : Context.getGlobalOptions().LineFilter) {
-    if (FileName.endswith(Filter.Name)) {
-      if (Filter.LineRanges.empty())
-        return true;
-      for (const FileFilter::LineRange &Range : Filter.LineRanges) {
-        if (Range.first <= LineNumber && LineNumber <= Range.second)
-          return true;
-      }
-      return false;
-    }
-  }
-  return false;
-}
-
 void ClangTidyDiagnosticConsumer::checkFilters(SourceLocation Location) {
   // Invalid location may mean a diagnostic in a command line, don't skip these.
   if (!Location.isValid()) {
@@ -407,18 +862,11 @@ void ClangTidyDiagnosticConsumer::checkFilters(SourceLocation Location) {
   StringRef FileName(File->getName());
   LastErrorRelatesToUserCode = LastErrorRelatesToUserCode ||
                                Sources.isInMainFile(Location) ||
-                               getHeaderFilter()->match(FileName);
+                               Context.getHeaderFilter().match(FileName);
 
   unsigned LineNumber = Sources.getExpansionLineNumber(Location);
-  LastErrorPassesLineFilter =
-      LastErrorPassesLineFilter || passesLineFilter(FileName, LineNumber);
-}
-
-llvm::Regex *ClangTidyDiagnosticConsumer::getHeaderFilter() {
-  if (!HeaderFilter)
-    HeaderFilter.reset(
-        new llvm::Regex(*Context.getOptions().HeaderFilterRegex));
-  return HeaderFilter.get();
+  LastErrorPassesLineFilter = LastErrorPassesLineFilter ||
+                              Context.passesLineFilter(FileName, LineNumber);
 }
 
 void ClangTidyDiagnosticConsumer::removeIncompatibleErrors(
@@ -541,6 +989,7 @@ void ClangTidyDiagnosticConsumer::removeIncompatibleErrors(
 }
 
 namespace {
+// Interned file paths make both comparisons cheap for errors in the same file.
 struct LessClangTidyError {
   bool operator()(const ClangTidyError &LHS, const ClangTidyError &RHS) const {
     const ClangTidyMessage &M1 = LHS.Message;
@@ -552,8 +1001,10 @@ struct LessClangTidyError {
 };
 struct EqualClangTidyError {
   bool operator()(const ClangTidyError &LHS, const ClangTidyError &RHS) const {
-    LessClangTidyError Less;
-    return !Less(LHS, RHS) && !Less(RHS, LHS);
+    const ClangTidyMessage &M1 = LHS.Message;
+    const ClangTidyMessage &M2 = RHS.Message;
+    return M1.FilePath == M2.FilePath && M1.FileOffset == M2.FileOffset &&
+           M1.Message == M2.Message;
   }
 };
 } // end anonymous namespace
@@ -567,7 +1018,7 @@ void ClangTidyDiagnosticConsumer::finish() {
                Errors.end());
   removeIncompatibleErrors(Errors);
 
-  for (const ClangTidyError &Error : Errors)
-    Context.storeError(Error);
+  for (ClangTidyError &Error : Errors)
+    Context.storeError(std::move(Error));
   Errors.clear();
 }
@@ -10,14 +10,24 @@
 #ifndef LLVM_CLANG_TOOLS_EXTRA_CLANG_TIDY_CLANGTIDYDIAGNOSTICCONSUMER_H
 #define LLVM_CLANG_TOOLS_EXTRA_CLANG_TIDY_CLANGTIDYDIAGNOSTICCONSUMER_H
 
+#include "ClangTidyASTIndex.h"
 #include "ClangTidyOptions.h"
+#include "ClangTidyProfiling.h"
+#include "ClangTidyTokenBuffer.h"
 #include "clang/Basic/Diagnostic.h"
 #include "clang/Basic/SourceManager.h"
 #include "clang/Tooling/Refactoring.h"
 #include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringSet.h"
+#include "llvm/Support/FileSystem.h"
 #include "llvm/Support/Regex.h"
 #include "llvm/Support/Timer.h"
+#include <chrono>
+#include <mutex>
+#include <set>
+#include <tuple>
+#include <utility>
 
 namespace clang {
 
@@ -32,6 +42,43 @@ class CompilationDatabase;
 
 namespace tidy {
 
+/// \brief A string stored once per process.
+///
+/// File paths, check names and build directories repeat in most of the
+/// diagnostics of a run. \c ClangTidyError keeps them as handles to a single
+/// copy, which makes errors smaller and cheaper to copy, and lets equal
+/// strings be compared by pointer. Interned strings are never freed, so they
+/// are only used for strings from a bounded set.
+class InternedString {
+public:
+  /// \brief Creates an empty string.
+  InternedString() : Entry(nullptr) {}
+
+  /// \brief Returns the handle of the single copy of \p S. Thread-safe.
+  static InternedString get(StringRef S);
+
+  StringRef str() const { return Entry ? Entry->getKey() : StringRef(); }
+  operator StringRef() const { return str(); }
+  bool empty() const { return !Entry; }
+
+  friend bool operator==(InternedString LHS, InternedString RHS) {
+    return LHS.Entry == RHS.Entry;
+  }
+  friend bool operator!=(InternedString LHS, InternedString RHS) {
+    return LHS.Entry != RHS.Entry;
+  }
+  /// \brief Orders the strings lexicographically.
+  friend bool operator<(InternedString LHS, InternedString RHS) {
+    return LHS.Entry != RHS.Entry && LHS.str() < RHS.str();
+  }
+
+private:
+  explicit InternedString(const llvm::StringMapEntry<char> *Entry)
+      : Entry(Entry) {}
+
+  const llvm::StringMapEntry<char> *Entry;
+};
+
 /// \brief A message from a clang-tidy check.
 ///
 /// Note that this is independent of a \c SourceManager.
@@ -40,7 +87,7 @@ struct ClangTidyMessage {
   ClangTidyMessage(StringRef Message, const SourceManager &Sources,
                    SourceLocation Loc);
   std::string Message;
-  std::string FilePath;
+  InternedString FilePath;
   unsigned FileOffset;
 };
 
@@ -57,12 +104,13 @@ struct ClangTidyError {
     Error = DiagnosticsEngine::Error
   };
 
-  ClangTidyError(StringRef CheckName, Level DiagLevel, bool IsWarningAsError,
-                 StringRef BuildDirectory);
+  ClangTidyError(InternedString CheckName, Level DiagLevel,
+                 bool IsWarningAsError, InternedString BuildDirectory);
 
-  std::string CheckName;
+  InternedString CheckName;
   ClangTidyMessage Message;
-  tooling::Replacements Fix;
+  /// \brief The replacements of the fix, sorted and without duplicates.
+  std::vector<tooling::Replacement> Fix;
   SmallVector<ClangTidyMessage, 1> Notes;
 
   // A build directory of the diagnostic source file.
@@ -72,7 +120,7 @@ struct ClangTidyError {
   // directory, it is the current directory where clang-tidy runs.
   //
   // Note: it is empty in unittest.
-  std::string BuildDirectory;
+  InternedString BuildDirectory;
 
   Level DiagLevel;
   bool IsWarningAsError;
@@ -81,6 +129,12 @@ struct ClangTidyError {
 /// \brief Read-only set of strings represented as a list of positive and
 /// negative globs. Positive globs add all matched strings to the set, negative
 /// globs remove them in the order of appearance in the list.
+///
+/// The list is compiled once into plain wildcard patterns which are matched
+/// without regular expressions, and the result for each queried string is
+/// memoized. As the set of queried strings (check names) is small, lookups are
+/// a single hash table probe after the first query. The memoization makes
+/// \c contains non-const and the class unsafe to share between threads.
 class GlobList {
 public:
   /// \brief \p GlobList is a comma-separated list of globs (only '*'
@@ -89,14 +143,104 @@ public:
 
   /// \brief Returns \c true if the pattern matches \p S. The result is the last
   /// matching glob's Positive flag.
-  bool contains(StringRef S) { return contains(S, false); }
+  bool contains(StringRef S);
+
+  /// \brief Returns \c false if the list contains no string starting with
+  /// \p Prefix. May return \c true even if it doesn't, as only the positive
+  /// globs are considered.
+  bool mayContainPrefix(StringRef Prefix) const;
+
+private:
+  struct Glob {
+    bool Positive;
+    std::string Pattern;
+  };
+
+  bool computeContains(StringRef S) const;
+
+  std::vector<Glob> Globs;
+  llvm::StringMap<bool> Cache;
+};
+
+/// \brief The \c NOLINT comments of a source file.
+///
+/// The following markers are recognized anywhere in a line, each optionally
+/// followed by a parenthesized comma-separated list of check names (with '*'
+/// wildcards) to which the suppression is restricted:
+///   - \c NOLINT suppresses diagnostics on its own line,
+///   - \c NOLINTNEXTLINE suppresses diagnostics on the following line,
+///   - \c NOLINTBEGIN and \c NOLINTEND suppress diagnostics on all lines
+///     between them, inclusive. An \c NOLINTEND closes the last open
+///     \c NOLINTBEGIN with the same check list, a \c NOLINTBEGIN without one
+///     extends to the end of the file.
+///
+/// The file is scanned once, and the suppressions are stored as sorted line
+/// ranges, so each lookup is a binary search.
+class NoLintIndex {
+public:
+  /// \brief Collects the suppressions in the file contents \p Buffer.
+  NoLintIndex(StringRef Buffer);
+
+  /// \brief Returns \c true if diagnostics of \p CheckName on the 1-based
+  /// \p Line are suppressed.
+  bool isSuppressed(unsigned Line, StringRef CheckName) const;
 
 private:
-  bool contains(StringRef S, bool Contains);
+  /// \brief The checks suppressed by a marker, empty if all are.
+  typedef std::vector<std::string> CheckList;
 
-  bool Positive;
-  llvm::Regex Regex;
-  std::unique_ptr<GlobList> NextGlob;
+  /// \brief The suppressions active from \c Line up to the next segment.
+  struct Segment {
+    unsigned Line;
+    std::vector<unsigned> Suppressions;
+  };
+
+  std::vector<CheckList> CheckLists;
+  /// \brief Sorted by line, with at most one entry per line.
+  std::vector<std::pair<unsigned, std::vector<unsigned>>> Lines;
+  /// \brief Sorted by line, covering the file from line 1.
+  std::vector<Segment> Blocks;
+};
+
+/// \brief Base class of state that several checks share in a translation
+/// unit, such as the include directives recorded by
+/// \c utils::IncludeInserter.
+///
+/// Each kind of state is identified by the address of the static member \c ID
+/// of its class, see \c ClangTidyContext::getSharedState.
+class ClangTidySharedState {
+public:
+  virtual ~ClangTidySharedState() {}
+};
+
+/// \brief A registry of headers that have already been analyzed in a clang-tidy
+/// run.
+///
+/// A header is identified by its file system ID and a hash of its contents.
+/// It is only analyzed once per configuration: translation units with other
+/// checks or options analyze it again. This class is thread-safe, so it can
+/// be shared by the workers of a parallel run.
+class AnalyzedHeaderRegistry {
+public:
+  /// \brief A header with given contents under a configuration.
+  typedef std::tuple<llvm::sys::fs::UniqueID, size_t, size_t> Header;
+
+  /// \brief Returns the header \p File with \p Contents under the
+  /// configuration hashed to \p OptionsHash.
+  static Header getHeader(const FileEntry *File, StringRef Contents,
+                          size_t OptionsHash);
+
+  /// \brief Records that the calling translation unit analyzes \p H. Returns
+  /// \c false if another translation unit did so already.
+  bool claim(const Header &H);
+
+  /// \brief Forgets the claims of \p Headers, e.g. of a translation unit that
+  /// failed, so that the next translation unit including them analyzes them.
+  void release(ArrayRef<Header> Headers);
+
+private:
+  std::mutex Mutex;
+  std::set<Header> Claimed;
 };
 
 /// \brief Contains displayed and ignored diagnostic counters for a ClangTidy
@@ -104,7 +248,8 @@ private:
 struct ClangTidyStats {
   ClangTidyStats()
       : ErrorsDisplayed(0), ErrorsIgnoredCheckFilter(0), ErrorsIgnoredNOLINT(0),
-        ErrorsIgnoredNonUserCode(0), ErrorsIgnoredLineFilter(0) {}
+        ErrorsIgnoredNonUserCode(0), ErrorsIgnoredLineFilter(0), CacheHits(0),
+        CacheMisses(0), TimeBudgetsExceeded(0) {}
 
   unsigned ErrorsDisplayed;
   unsigned ErrorsIgnoredCheckFilter;
@@ -112,15 +257,33 @@ struct ClangTidyStats {
   unsigned ErrorsIgnoredNonUserCode;
   unsigned ErrorsIgnoredLineFilter;
 
+  /// \brief Number of compile commands whose results were or weren't found
+  /// in the result cache.
+  unsigned CacheHits;
+  unsigned CacheMisses;
+
+  /// \brief Number of checks and translation units that ran out of their time
+  /// budget, see \c ClangTidyGlobalOptions::CheckTimeBudget.
+  unsigned TimeBudgetsExceeded;
+
   unsigned errorsIgnored() const {
     return ErrorsIgnoredNOLINT + ErrorsIgnoredCheckFilter +
            ErrorsIgnoredNonUserCode + ErrorsIgnoredLineFilter;
   }
-};
 
-/// \brief Container for clang-tidy profiling data.
-struct ProfileData {
-  llvm::StringMap<llvm::TimeRecord> Records;
+  /// \brief Adds the counters of \p Other, e.g. those collected by another
+  /// worker of a parallel run.
+  ClangTidyStats &operator+=(const ClangTidyStats &Other) {
+    ErrorsDisplayed += Other.ErrorsDisplayed;
+    ErrorsIgnoredCheckFilter += Other.ErrorsIgnoredCheckFilter;
+    ErrorsIgnoredNOLINT += Other.ErrorsIgnoredNOLINT;
+    ErrorsIgnoredNonUserCode += Other.ErrorsIgnoredNonUserCode;
+    ErrorsIgnoredLineFilter += Other.ErrorsIgnoredLineFilter;
+    CacheHits += Other.CacheHits;
+    CacheMisses += Other.CacheMisses;
+    TimeBudgetsExceeded += Other.TimeBudgetsExceeded;
+    return *this;
+  }
 };
 
 /// \brief Every \c ClangTidyCheck reports errors through a \c DiagnosticsEngine
@@ -163,9 +326,30 @@ public:
   /// \brief Gets the language options from the AST context.
   const LangOptions &getLangOpts() const { return LangOpts; }
 
+  /// \brief Returns the index of the current translation unit, building it on
+  /// first use.
+  const ASTIndex &getASTIndex();
+
+  /// \brief Returns the raw tokens of the file containing \p Loc, lexing it
+  /// on first use. The buffer is empty if \p Loc is not a file location.
+  const TokenBuffer &getTokenBuffer(SourceLocation Loc);
+
+  /// \brief Returns the state of type \c T shared by all checks in the
+  /// current translation unit, creating it from \p Args on first use.
+  ///
+  /// \c T derives from \c ClangTidySharedState. The state is destroyed when
+  /// the next translation unit starts.
+  template <typename T, typename... ArgTs>
+  T &getSharedState(ArgTs &&... Args) {
+    std::unique_ptr<ClangTidySharedState> &State = SharedStates[&T::ID];
+    if (!State)
+      State.reset(new T(std::forward<ArgTs>(Args)...));
+    return static_cast<T &>(*State);
+  }
+
   /// \brief Returns the name of the clang-tidy check which produced this
-  /// diagnostic ID.
-  StringRef getCheckName(unsigned DiagnosticID) const;
+  /// diagnostic ID, or an empty string for other diagnostics.
+  InternedString getCheckName(unsigned DiagnosticID) const;
 
   /// \brief Returns check filter for the \c CurrentFile.
   ///
@@ -176,6 +360,9 @@ public:
   /// selects checks for upgrade to error.
   GlobList &getWarningAsErrorFilter();
 
+  /// \brief Returns the compiled \c HeaderFilterRegex for the \c CurrentFile.
+  llvm::Regex &getHeaderFilter();
+
   /// \brief Returns global options.
   const ClangTidyGlobalOptions &getGlobalOptions() const;
 
@@ -184,9 +371,19 @@ public:
   /// The \c CurrentFile can be changed using \c setCurrentFile.
   const ClangTidyOptions &getOptions() const;
 
+  /// \brief Returns options for \c CurrentFile. The options stay valid as
+  /// long as the returned pointer is kept.
+  std::shared_ptr<const ClangTidyOptions> getSharedOptions() const {
+    return CurrentOptions;
+  }
+
   /// \brief Returns options for \c File. Does not change or depend on
   /// \c CurrentFile.
-  ClangTidyOptions getOptionsForFile(StringRef File) const;
+  ///
+  /// The options are shared by all files with the same configuration and
+  /// are cached by the \c ClangTidyOptionsProvider.
+  std::shared_ptr<const ClangTidyOptions>
+  getOptionsForFile(StringRef File) const;
 
   /// \brief Returns \c ClangTidyStats containing issued and ignored diagnostic
   /// counters.
@@ -195,9 +392,19 @@ public:
   /// \brief Returns all collected errors.
   const std::vector<ClangTidyError> &getErrors() const { return Errors; }
 
+  /// \brief Returns all collected errors and clears them.
+  std::vector<ClangTidyError> takeErrors() {
+    std::vector<ClangTidyError> Result;
+    Result.swap(Errors);
+    return Result;
+  }
+
   /// \brief Clears collected errors.
   void clearErrors() { Errors.clear(); }
 
+  /// \brief Resets the issued and ignored diagnostic counters.
+  void clearStats() { Stats = ClangTidyStats(); }
+
   /// \brief Set the output struct for profile data.
   ///
   /// Setting a non-null pointer here will enable profile collection in
@@ -207,14 +414,91 @@ public:
 
   /// \brief Should be called when starting to process new translation unit.
   void setCurrentBuildDirectory(StringRef BuildDirectory) {
-    CurrentBuildDirectory = BuildDirectory;
+    CurrentBuildDirectory = InternedString::get(BuildDirectory);
   }
 
   /// \brief Returns build directory of the current translation unit.
-  const std::string &getCurrentBuildDirectory() {
+  InternedString getCurrentBuildDirectory() const {
     return CurrentBuildDirectory;
   }
 
+  /// \brief Sets the registry of headers shared by all translation units of
+  /// the run. If set, matches in headers that were analyzed by another
+  /// translation unit are skipped.
+  void setAnalyzedHeaderRegistry(AnalyzedHeaderRegistry *Registry) {
+    AnalyzedHeaders = Registry;
+  }
+
+  /// \brief Ends the claims of the headers analyzed by the current translation
+  /// unit. If \p Analyzed is \c false, e.g. because the translation unit
+  /// failed to compile, the claims are released so that the next translation
+  /// unit including the headers analyzes them.
+  void endHeaderClaims(bool Analyzed);
+
+  /// \brief Returns \c true if \p Loc is in a header that has already been
+  /// analyzed by another translation unit of the run.
+  ///
+  /// The first translation unit that asks about a header becomes responsible
+  /// for analyzing it.
+  bool isAnalyzedElsewhere(SourceLocation Loc);
+
+  /// \brief Returns \c true if any header was skipped in the current
+  /// translation unit because it was analyzed elsewhere.
+  bool hasSkippedHeaders() const { return HasSkippedHeaders; }
+
+  /// \brief Returns \c false if code in \p Range doesn't need to be analyzed
+  /// in the current translation unit.
+  ///
+  /// This is the case if it was analyzed by another translation unit (see
+  /// \c isAnalyzedElsewhere) or if diagnostics in \p Range would be filtered
+  /// out and \c ClangTidyGlobalOptions::PruneFilteredCode is set.
+  bool isInAnalysisScope(SourceRange Range);
+
+  /// \brief Returns \c true if diagnostics in some line of \p Range would pass
+  /// the header filter, the system headers setting and the line filter.
+  bool passesFilters(SourceRange Range);
+
+  /// \brief Returns \c true if \p LineNumber of \p FileName passes the line
+  /// filter.
+  bool passesLineFilter(StringRef FileName, unsigned LineNumber) const;
+
+  /// \brief Returns \c true if diagnostics of \p CheckName at \p Loc are
+  /// suppressed by a \c NOLINT comment, see \c NoLintIndex.
+  bool isSuppressedByNOLINT(SourceLocation Loc, StringRef CheckName);
+
+  /// \brief Returns \c true if a check or translation unit time budget is set.
+  bool hasTimeBudgets() const {
+    return TranslationUnitTimeBudget > 0 || CheckTimeBudget > 0;
+  }
+
+  /// \brief Returns the seconds elapsed since the current translation unit
+  /// was started.
+  double getTranslationUnitTime() const;
+
+  /// \brief Returns \c true if the current translation unit has exceeded its
+  /// time budget. Reports this the first time.
+  bool isTranslationUnitOverTimeBudget();
+
+  /// \brief Returns \c true if \p CheckName must not run anymore in the
+  /// current translation unit, because it or the translation unit has
+  /// exceeded its time budget.
+  bool isOverTimeBudget(StringRef CheckName);
+
+  /// \brief Adds \p Seconds to the time spent by \p CheckName in the current
+  /// translation unit, disabling the check if it exceeds its budget.
+  void addCheckTime(StringRef CheckName, double Seconds);
+
+  /// \brief Sets the memory used for the AST and sources of the current
+  /// translation unit.
+  void setTranslationUnitMemory(uint64_t Bytes) {
+    TranslationUnitMemory = Bytes;
+  }
+  uint64_t getTranslationUnitMemory() const { return TranslationUnitMemory; }
+
+  /// \brief Reports a "clang-tidy-budget" warning with \p Message at the
+  /// start of the main file, and counts it in \c ClangTidyStats.
+  void reportTimeBudget(StringRef Message);
+
 private:
   // Calls setDiagnosticsEngine() and storeError().
   friend class ClangTidyDiagnosticConsumer;
@@ -225,26 +509,83 @@ private:
   void setDiagnosticsEngine(DiagnosticsEngine *Engine);
 
   /// \brief Store an \p Error.
-  void storeError(const ClangTidyError &Error);
+  void storeError(ClangTidyError Error);
+
+  /// \brief Returns the compiled \c GlobList for \p Globs, creating it on
+  /// first use.
+  GlobList &getGlobList(StringRef Globs);
 
   std::vector<ClangTidyError> Errors;
   DiagnosticsEngine *DiagEngine;
   std::unique_ptr<ClangTidyOptionsProvider> OptionsProvider;
 
   std::string CurrentFile;
-  ClangTidyOptions CurrentOptions;
-  std::unique_ptr<GlobList> CheckFilter;
-  std::unique_ptr<GlobList> WarningAsErrorFilter;
+  std::shared_ptr<const ClangTidyOptions> CurrentOptions;
+  /// \brief Hash of the checks and options of \c CurrentFile that affect the
+  /// diagnostics in headers, see \c AnalyzedHeaderRegistry.
+  size_t CurrentOptionsHash;
+  /// \brief The options \c CurrentOptionsHash was computed from. Files with
+  /// the same configuration share the options object of the provider.
+  std::shared_ptr<const ClangTidyOptions> HashedOptions;
+  /// \brief Compiled glob lists by their text, shared by all files with the
+  /// same \c Checks or \c WarningsAsErrors options.
+  llvm::StringMap<std::unique_ptr<GlobList>> GlobLists;
+  GlobList *CheckFilter;
+  GlobList *WarningAsErrorFilter;
+  /// \brief Compiled header filters by their regular expression.
+  llvm::StringMap<std::unique_ptr<llvm::Regex>> HeaderFilters;
+  llvm::Regex *HeaderFilter;
 
   LangOptions LangOpts;
+  ASTContext *CurrentASTContext;
+  std::unique_ptr<ASTIndex> Index;
+  /// \brief The token buffers of the files of the current translation unit
+  /// that have been requested so far.
+  llvm::DenseMap<FileID, std::unique_ptr<TokenBuffer>> TokenBuffers;
+  TokenBuffer EmptyTokenBuffer;
+  /// \brief The state shared by checks in the current translation unit, by
+  /// the address of the \c ID of its class.
+  llvm::DenseMap<const void *, std::unique_ptr<ClangTidySharedState>>
+      SharedStates;
 
   ClangTidyStats Stats;
 
-  std::string CurrentBuildDirectory;
+  InternedString CurrentBuildDirectory;
 
-  llvm::DenseMap<unsigned, std::string> CheckNamesByDiagnosticID;
+  llvm::DenseMap<unsigned, InternedString> CheckNamesByDiagnosticID;
 
   ProfileData *Profile;
+
+  AnalyzedHeaderRegistry *AnalyzedHeaders;
+  /// \brief The headers claimed by the current translation unit.
+  std::vector<AnalyzedHeaderRegistry::Header> ClaimedHeaders;
+  llvm::DenseMap<const FileEntry *, bool> FileIsAnalyzedElsewhere;
+  bool HasSkippedHeaders;
+
+  /// \brief Whether diagnostics in a file can be displayed at all, and the
+  /// line filter for it, if any.
+  struct FileScope {
+    bool Visible;
+    const FileFilter *LineFilter;
+  };
+  FileScope getFileScope(FileID FID);
+  llvm::DenseMap<FileID, FileScope> FileScopes;
+
+  /// \brief The \c NOLINT comments of each file of the current translation
+  /// unit that has had diagnostics.
+  llvm::DenseMap<FileID, std::unique_ptr<NoLintIndex>> NoLintIndexes;
+
+  /// \brief Copies of the global options, which are read for every match.
+  double TranslationUnitTimeBudget;
+  double CheckTimeBudget;
+  std::chrono::steady_clock::time_point TranslationUnitStart;
+  bool TranslationUnitOverBudget;
+  /// \brief Seconds spent by each check in the current translation unit.
+  llvm::StringMap<double> CheckTimes;
+  /// \brief Checks disabled for the rest of the current translation unit.
+  llvm::StringSet<> ChecksOverBudget;
+
+  uint64_t TranslationUnitMemory;
 };
 
 /// \brief A diagnostic consumer that turns each \c Diagnostic into a
@@ -270,21 +611,18 @@ private:
 
   void removeIncompatibleErrors(SmallVectorImpl<ClangTidyError> &Errors) const;
 
-  /// \brief Returns the \c HeaderFilter constructed for the options set in the
-  /// context.
-  llvm::Regex *getHeaderFilter();
-
   /// \brief Updates \c LastErrorRelatesToUserCode and LastErrorPassesLineFilter
   /// according to the diagnostic \p Location.
   void checkFilters(SourceLocation Location);
-  bool passesLineFilter(StringRef FileName, unsigned LineNumber) const;
 
   ClangTidyContext &Context;
   std::unique_ptr<DiagnosticsEngine> Diags;
   SmallVector<ClangTidyError, 8> Errors;
-  std::unique_ptr<llvm::Regex> HeaderFilter;
   bool LastErrorRelatesToUserCode;
   bool LastErrorPassesLineFilter;
+  /// \brief Whether the last diagnostic was suppressed by \c NOLINT, so its
+  /// notes are dropped as well.
+  bool LastErrorIsSuppressed;
 };
 
 } // end namespace tidy
@@ -0,0 +1,189 @@
+//===--- tools/extra/clang-tidy/ClangTidyHistory.cpp - clang-tidy ---------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+///
+///  \file This file implements the record of the cost of previous clang-tidy
+///  runs used for scheduling and sharding.
+///
+//===----------------------------------------------------------------------===//
+
+#include "ClangTidyHistory.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/YAMLTraits.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <numeric>
+
+using namespace clang::tidy;
+
+namespace {
+struct SerializedCost {
+  std::string File;
+  double Seconds;
+  uint64_t Memory;
+};
+} // end anonymous namespace
+
+LLVM_YAML_IS_SEQUENCE_VECTOR(SerializedCost)
+
+namespace llvm {
+namespace yaml {
+
+template <> struct MappingTraits<SerializedCost> {
+  static void mapping(IO &IO, SerializedCost &Cost) {
+    IO.mapRequired("File", Cost.File);
+    IO.mapRequired("Seconds", Cost.Seconds);
+    IO.mapRequired("Memory", Cost.Memory);
+  }
+};
+
+} // namespace yaml
+} // namespace llvm
+
+namespace clang {
+namespace tidy {
+
+ClangTidyHistory::ClangTidyHistory(StringRef Path) {
+  llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> Text =
+      llvm::MemoryBuffer::getFile(Path);
+  if (!Text)
+    return;
+  std::vector<SerializedCost> Serialized;
+  llvm::yaml::Input YAML((*Text)->getBuffer());
+  YAML >> Serialized;
+  if (YAML.error()) {
+    llvm::errs() << "Ignoring invalid history file " << Path << ": "
+                 << YAML.error().message() << "\n";
+    return;
+  }
+  for (const SerializedCost &Entry : Serialized)
+    setCost(Entry.File, Cost(Entry.Seconds, Entry.Memory));
+}
+
+void ClangTidyHistory::setCost(StringRef File, Cost Value) {
+  auto Inserted = Costs.insert(std::make_pair(File, Value));
+  if (!Inserted.second) {
+    Cost &Old = Inserted.first->second;
+    Total.Seconds -= Old.Seconds;
+    Total.Memory -= Old.Memory;
+    Old = Value;
+  }
+  Total.Seconds += Value.Seconds;
+  Total.Memory += Value.Memory;
+}
+
+llvm::Optional<ClangTidyHistory::Cost>
+ClangTidyHistory::lookup(StringRef File) const {
+  std::lock_guard<std::mutex> Lock(Mutex);
+  auto I = Costs.find(File);
+  if (I == Costs.end())
+    return llvm::None;
+  return I->second;
+}
+
+ClangTidyHistory::Cost ClangTidyHistory::estimate(StringRef File) const {
+  std::lock_guard<std::mutex> Lock(Mutex);
+  auto I = Costs.find(File);
+  if (I != Costs.end())
+    return I->second;
+  // Without any history, all files cost the same.
+  if (Costs.empty())
+    return Cost(1, 0);
+  return Cost(Total.Seconds / Costs.size(), Total.Memory / Costs.size());
+}
+
+void ClangTidyHistory::record(StringRef File, Cost Value) {
+  std::lock_guard<std::mutex> Lock(Mutex);
+  setCost(File, Value);
+}
+
+bool ClangTidyHistory::save(StringRef Path) const {
+  std::vector<SerializedCost> Serialized;
+  {
+    std::lock_guard<std::mutex> Lock(Mutex);
+    for (const auto &Entry : Costs)
+      Serialized.push_back(
+          {Entry.getKey().str(), Entry.second.Seconds, Entry.second.Memory});
+  }
+  // Keep the file stable for diffs and caching.
+  std::sort(Serialized.begin(), Serialized.end(),
+            [](const SerializedCost &A, const SerializedCost &B) {
+              return A.File < B.File;
+            });
+
+  // Write to a unique temporary file and rename it, so that a concurrent run
+  // never reads a partially written history.
+  int FD;
+  SmallString<256> TempPath;
+  if (std::error_code EC = llvm::sys::fs::createUniqueFile(
+          Path + ".%%%%%%%%.tmp", FD, TempPath)) {
+    llvm::errs() << "Can't write history file " << Path << ": "
+                 << EC.message() << "\n";
+    return false;
+  }
+  {
+    llvm::raw_fd_ostream OS(FD, /*shouldClose=*/true);
+    llvm::yaml::Output YAML(OS);
+    YAML << Serialized;
+  }
+  if (std::error_code EC = llvm::sys::fs::rename(TempPath, Path)) {
+    llvm::errs() << "Can't write history file " << Path << ": "
+                 << EC.message() << "\n";
+    llvm::sys::fs::remove(TempPath);
+    return false;
+  }
+  return true;
+}
+
+std::vector<std::string> selectShard(llvm::ArrayRef<std::string> Files,
+                                     const ClangTidyHistory &History,
+                                     unsigned Index, unsigned Count) {
+  assert(Index < Count && "Shard index out of range");
+  std::vector<double> Costs;
+  for (const std::string &File : Files)
+    Costs.push_back(History.estimate(getHistoryPath(File)).Seconds);
+
+  std::vector<unsigned> Order(Files.size());
+  std::iota(Order.begin(), Order.end(), 0);
+  // Break ties by name, so that the order doesn't depend on the order of the
+  // compilation database.
+  std::sort(Order.begin(), Order.end(), [&](unsigned A, unsigned B) {
+    if (Costs[A] != Costs[B])
+      return Costs[A] > Costs[B];
+    if (Files[A] != Files[B])
+      return Files[A] < Files[B];
+    return A < B;
+  });
+
+  std::vector<double> ShardCosts(Count);
+  std::vector<char> Selected(Files.size());
+  for (unsigned I : Order) {
+    unsigned Shard =
+        std::min_element(ShardCosts.begin(), ShardCosts.end()) -
+        ShardCosts.begin();
+    ShardCosts[Shard] += Costs[I];
+    Selected[I] = Shard == Index;
+  }
+
+  std::vector<std::string> Result;
+  for (unsigned I = 0, E = Files.size(); I < E; ++I)
+    if (Selected[I])
+      Result.push_back(Files[I]);
+  return Result;
+}
+
+std::string getHistoryPath(StringRef File) {
+  SmallString<256> Path(File);
+  llvm::sys::fs::make_absolute(Path);
+  return Path.str();
+}
+
+} // end namespace tidy
+} // end namespace clang
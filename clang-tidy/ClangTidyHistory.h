@@ -0,0 +1,95 @@
+//===--- ClangTidyHistory.h - clang-tidy ------------------------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_CLANG_TOOLS_EXTRA_CLANG_TIDY_CLANGTIDYHISTORY_H
+#define LLVM_CLANG_TOOLS_EXTRA_CLANG_TIDY_CLANGTIDYHISTORY_H
+
+#include "clang/Basic/LLVM.h"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/Optional.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace clang {
+namespace tidy {
+
+/// \brief The cost of running clang-tidy on a source file, as measured in
+/// previous runs.
+///
+/// The history is kept in a YAML file, keyed by absolute file path. Parallel
+/// runs use it to start the most expensive files first and to limit the memory
+/// used by concurrently processed files, and \c selectShard uses it to split
+/// a run into parts of equal cost.
+class ClangTidyHistory {
+public:
+  struct Cost {
+    Cost() : Seconds(0), Memory(0) {}
+    Cost(double Seconds, uint64_t Memory) : Seconds(Seconds), Memory(Memory) {}
+
+    /// \brief Wall-clock time spent on all compile commands of the file.
+    double Seconds;
+    /// \brief Largest memory used for the AST and sources of one of its
+    /// translation units.
+    uint64_t Memory;
+  };
+
+  ClangTidyHistory() {}
+
+  /// \brief Reads the history from \p Path. A missing or unreadable file gives
+  /// an empty history.
+  explicit ClangTidyHistory(StringRef Path);
+
+  /// \brief Returns the cost recorded for the absolute path \p File.
+  llvm::Optional<Cost> lookup(StringRef File) const;
+
+  /// \brief Returns the recorded cost of \p File, or the average cost of all
+  /// recorded files if there is none.
+  Cost estimate(StringRef File) const;
+
+  /// \brief Records the cost of a run on \p File, replacing any earlier one.
+  /// Thread-safe.
+  void record(StringRef File, Cost Value);
+
+  /// \brief Writes the history to \p Path, replacing it atomically. Returns
+  /// \c false on errors, which are reported to stderr.
+  bool save(StringRef Path) const;
+
+private:
+  /// \brief Sets the cost of \p File and keeps \c Total up to date. The
+  /// caller holds \c Mutex, if needed.
+  void setCost(StringRef File, Cost Value);
+
+  mutable std::mutex Mutex;
+  llvm::StringMap<Cost> Costs;
+  /// \brief Sum of \c Costs, for \c estimate.
+  Cost Total;
+};
+
+/// \brief Returns the part \p Index (counted from zero) of \p Files split
+/// into \p Count parts with about the same total estimated cost.
+///
+/// Files are assigned, most expensive first, to the part with the smallest
+/// total cost so far. The result only depends on the arguments, so separate
+/// processes using the same file list and history select disjoint parts that
+/// together cover all files. Files keep their relative order.
+std::vector<std::string> selectShard(llvm::ArrayRef<std::string> Files,
+                                     const ClangTidyHistory &History,
+                                     unsigned Index, unsigned Count);
+
+/// \brief Returns the absolute path \p File is recorded under in the history.
+std::string getHistoryPath(StringRef File);
+
+} // end namespace tidy
+} // end namespace clang
+
+#endif // LLVM_CLANG_TOOLS_EXTRA_CLANG_TIDY_CLANGTIDYHISTORY_H
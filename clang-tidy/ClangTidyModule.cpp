@@ -31,6 +31,16 @@ void ClangTidyCheckFactories::createChecks(
   }
 }
 
+std::unique_ptr<ClangTidyCheck>
+ClangTidyCheckFactories::createCheck(StringRef Name,
+                                     ClangTidyContext *Context) {
+  auto Factory = Factories.find(Name);
+  if (Factory == Factories.end())
+    return nullptr;
+  return std::unique_ptr<ClangTidyCheck>(
+      Factory->second(Factory->first, Context));
+}
+
 ClangTidyOptions ClangTidyModule::getModuleOptions() {
   return ClangTidyOptions();
 }
@@ -69,6 +69,11 @@ public:
   void createChecks(ClangTidyContext *Context,
                     std::vector<std::unique_ptr<ClangTidyCheck>> &Checks);
 
+  /// \brief Creates an instance of the check registered as \p Name, or
+  /// returns \c nullptr if there is none.
+  std::unique_ptr<ClangTidyCheck> createCheck(StringRef Name,
+                                              ClangTidyContext *Context);
+
   typedef std::map<std::string, CheckFactory> FactoryMap;
   FactoryMap::const_iterator begin() const { return Factories.begin(); }
   FactoryMap::const_iterator end() const { return Factories.end(); }
@@ -80,6 +85,11 @@ private:
 
 /// \brief A clang-tidy module groups a number of \c ClangTidyChecks and gives
 /// them a prefixed name.
+///
+/// A module registered in \c ClangTidyModuleRegistry as "<prefix>-module" is
+/// only instantiated when a check named "<prefix>-..." can be enabled, so all
+/// of its checks must have that prefix. Modules with other names are always
+/// instantiated.
 class ClangTidyModule {
 public:
   virtual ~ClangTidyModule() {}
@@ -10,13 +10,17 @@
 #include "ClangTidyOptions.h"
 #include "ClangTidyModuleRegistry.h"
 #include "clang/Basic/LLVM.h"
+#include "llvm/ADT/Optional.h"
 #include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringMap.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/Errc.h"
 #include "llvm/Support/FileSystem.h"
 #include "llvm/Support/Path.h"
 #include "llvm/Support/YAMLTraits.h"
 #include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <tuple>
 #include <utility>
 
 #define DEBUG_TYPE "clang-tidy-options"
@@ -110,11 +114,16 @@ ClangTidyOptions ClangTidyOptions::getDefaults() {
   Options.SystemHeaders = false;
   Options.AnalyzeTemporaryDtors = false;
   Options.User = llvm::None;
-  for (ClangTidyModuleRegistry::iterator I = ClangTidyModuleRegistry::begin(),
-                                         E = ClangTidyModuleRegistry::end();
-       I != E; ++I)
-    Options = Options.mergeWith(I->instantiate()->getModuleOptions());
-  return Options;
+  // The modules can't change after startup, so only instantiate them once.
+  static const ClangTidyOptions ModuleOptions = [] {
+    ClangTidyOptions Options;
+    for (ClangTidyModuleRegistry::iterator I = ClangTidyModuleRegistry::begin(),
+                                           E = ClangTidyModuleRegistry::end();
+         I != E; ++I)
+      Options = Options.mergeWith(I->instantiate()->getModuleOptions());
+    return Options;
+  }();
+  return Options.mergeWith(ModuleOptions);
 }
 
 ClangTidyOptions
@@ -168,6 +177,24 @@ ClangTidyOptionsProvider::getOptions(llvm::StringRef FileName) {
   return Result;
 }
 
+std::shared_ptr<const ClangTidyOptions>
+ClangTidyOptionsProvider::getMergedOptions(llvm::StringRef FileName) {
+  return mergeRawOptions(getRawOptions(FileName));
+}
+
+std::shared_ptr<const ClangTidyOptions>
+ClangTidyOptionsProvider::mergeRawOptions(
+    const std::vector<OptionsSource> &RawOptions) {
+  // Merge options on top of getDefaults() as a safeguard against options with
+  // unset values.
+  if (!Defaults)
+    Defaults.reset(new ClangTidyOptions(ClangTidyOptions::getDefaults()));
+  auto Result = std::make_shared<ClangTidyOptions>(*Defaults);
+  for (const auto &Source : RawOptions)
+    *Result = Result->mergeWith(Source.first);
+  return Result;
+}
+
 std::vector<OptionsSource>
 DefaultOptionsProvider::getRawOptions(llvm::StringRef FileName) {
   std::vector<OptionsSource> Result;
@@ -175,6 +202,13 @@ DefaultOptionsProvider::getRawOptions(llvm::StringRef FileName) {
   return Result;
 }
 
+std::shared_ptr<const ClangTidyOptions>
+DefaultOptionsProvider::getMergedOptions(llvm::StringRef FileName) {
+  if (!MergedOptions)
+    MergedOptions = mergeRawOptions(getRawOptions(FileName));
+  return MergedOptions;
+}
+
 ConfigOptionsProvider::ConfigOptionsProvider(
     const ClangTidyGlobalOptions &GlobalOptions,
     const ClangTidyOptions &DefaultOptions,
@@ -212,6 +246,24 @@ FileOptionsProvider::FileOptionsProvider(
       OverrideOptions(OverrideOptions), ConfigHandlers(ConfigHandlers) {
 }
 
+void FileOptionsProvider::refresh() {
+  for (const auto &ConfigFile : ConfigFiles) {
+    const llvm::sys::fs::file_status &Old = ConfigFile.getValue();
+    llvm::sys::fs::file_status New;
+    llvm::sys::fs::status(ConfigFile.getKey(), New);
+    if (New.type() != Old.type() || New.getSize() != Old.getSize() ||
+        New.getLastModificationTime() != Old.getLastModificationTime()) {
+      DEBUG(llvm::dbgs() << ConfigFile.getKey()
+                         << " changed, dropping cached options.\n");
+      CachedOptions.clear();
+      ConfigFiles.clear();
+      DirectoryOptions.clear();
+      SourceOptions.clear();
+      return;
+    }
+  }
+}
+
 // FIXME: This method has some common logic with clang::format::getStyle().
 // Consider pulling out common bits to a findParentFileWithName function or
 // similar.
@@ -264,6 +316,30 @@ FileOptionsProvider::getRawOptions(StringRef FileName) {
   return RawOptions;
 }
 
+std::shared_ptr<const ClangTidyOptions>
+FileOptionsProvider::getMergedOptions(StringRef FileName) {
+  SmallString<256> FilePath(FileName);
+  // Relative paths depend on the working directory, which changes between
+  // compile commands. Let getRawOptions report the error.
+  if (llvm::sys::fs::make_absolute(FilePath))
+    return mergeRawOptions(getRawOptions(FileName));
+
+  std::shared_ptr<const ClangTidyOptions> &Result =
+      DirectoryOptions[llvm::sys::path::parent_path(FilePath)];
+  if (Result)
+    return Result;
+
+  std::vector<OptionsSource> RawOptions = getRawOptions(FilePath);
+  std::string Sources;
+  for (const OptionsSource &Source : RawOptions)
+    Sources += Source.second + '\0';
+  std::shared_ptr<const ClangTidyOptions> &Merged = SourceOptions[Sources];
+  if (!Merged)
+    Merged = mergeRawOptions(RawOptions);
+  Result = Merged;
+  return Result;
+}
+
 llvm::Optional<OptionsSource>
 FileOptionsProvider::tryReadConfigFile(StringRef Directory) {
   assert(!Directory.empty());
@@ -279,11 +355,12 @@ FileOptionsProvider::tryReadConfigFile(StringRef Directory) {
     llvm::sys::path::append(ConfigFile, ConfigHandler.first);
     DEBUG(llvm::dbgs() << "Trying " << ConfigFile << "...\n");
 
-    bool IsFile = false;
-    // Ignore errors from is_regular_file: we only need to know if we can read
-    // the file or not.
-    llvm::sys::fs::is_regular_file(Twine(ConfigFile), IsFile);
-    if (!IsFile)
+    // Ignore errors from status: we only need to know if we can read the file
+    // or not.
+    llvm::sys::fs::file_status Status;
+    llvm::sys::fs::status(Twine(ConfigFile), Status);
+    ConfigFiles[ConfigFile] = Status;
+    if (!llvm::sys::fs::is_regular_file(Status))
       continue;
 
     llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> Text =
@@ -319,6 +396,103 @@ std::error_code parseLineFilter(StringRef LineFilter,
   return Input.error();
 }
 
+std::error_code parseUnifiedDiff(StringRef Diff, unsigned StripComponents,
+                                 clang::tidy::ClangTidyGlobalOptions &Options) {
+  std::vector<FileFilter> Filters;
+  llvm::StringMap<size_t> FilterIndex;
+  // Index of the filter for the file of the current hunk, if any. Deleted files
+  // don't have one.
+  Optional<size_t> Current;
+  bool SeenFile = false;
+  // Lines left in the current hunk. Lines inside a hunk are never headers, even
+  // if they look like one.
+  unsigned OldLinesLeft = 0, NewLinesLeft = 0;
+
+  SmallVector<StringRef, 128> Lines;
+  Diff.split(Lines, '\n');
+  for (StringRef Line : Lines) {
+    Line = Line.rtrim('\r');
+    if (OldLinesLeft > 0 || NewLinesLeft > 0) {
+      if (Line.startswith("+")) {
+        if (NewLinesLeft == 0)
+          return std::make_error_code(std::errc::invalid_argument);
+        --NewLinesLeft;
+      } else if (Line.startswith("-")) {
+        if (OldLinesLeft == 0)
+          return std::make_error_code(std::errc::invalid_argument);
+        --OldLinesLeft;
+      } else if (Line.startswith(" ") || Line.empty()) {
+        if (OldLinesLeft == 0 || NewLinesLeft == 0)
+          return std::make_error_code(std::errc::invalid_argument);
+        --OldLinesLeft;
+        --NewLinesLeft;
+      }
+      // Other lines, e.g. "\ No newline at end of file", aren't counted.
+      continue;
+    }
+
+    if (Line.startswith("+++ ")) {
+      SeenFile = true;
+      Current.reset();
+      // The file name may be followed by a tab and a timestamp.
+      StringRef Name = Line.drop_front(4).split('\t').first.trim('"');
+      if (Name == "/dev/null")
+        continue;
+      for (unsigned I = 0; I < StripComponents; ++I) {
+        size_t Slash = Name.find('/');
+        if (Slash == StringRef::npos)
+          return std::make_error_code(std::errc::invalid_argument);
+        Name = Name.drop_front(Slash + 1);
+      }
+      if (Name.empty())
+        return std::make_error_code(std::errc::invalid_argument);
+      auto Inserted = FilterIndex.insert(std::make_pair(Name, Filters.size()));
+      if (Inserted.second) {
+        Filters.emplace_back();
+        Filters.back().Name = Name;
+      }
+      Current = Inserted.first->second;
+      continue;
+    }
+
+    // Hunk headers look like "@@ -Start[,Count] +Start[,Count] @@".
+    if (!Line.startswith("@@ "))
+      continue;
+    if (!SeenFile)
+      return std::make_error_code(std::errc::invalid_argument);
+    SmallVector<StringRef, 4> Fields;
+    Line.split(Fields, ' ', /*MaxSplit=*/-1, /*KeepEmpty=*/false);
+    if (Fields.size() < 4 || !Fields[1].startswith("-") ||
+        !Fields[2].startswith("+"))
+      return std::make_error_code(std::errc::invalid_argument);
+    unsigned Start[2], Count[2];
+    for (unsigned I = 0; I < 2; ++I) {
+      StringRef StartText, CountText;
+      std::tie(StartText, CountText) = Fields[I + 1].drop_front().split(',');
+      Count[I] = 1;
+      if (StartText.getAsInteger(10, Start[I]) ||
+          (!CountText.empty() && CountText.getAsInteger(10, Count[I])))
+        return std::make_error_code(std::errc::invalid_argument);
+    }
+    OldLinesLeft = Count[0];
+    NewLinesLeft = Count[1];
+    if (Current && Count[1] > 0)
+      Filters[*Current].LineRanges.emplace_back(Start[1],
+                                                Start[1] + Count[1] - 1);
+  }
+  if (OldLinesLeft > 0 || NewLinesLeft > 0)
+    return std::make_error_code(std::errc::invalid_argument);
+
+  // An empty list of line ranges would select the whole file.
+  Filters.erase(std::remove_if(Filters.begin(), Filters.end(),
+                               [](const FileFilter &Filter) {
+                                 return Filter.LineRanges.empty();
+                               }),
+                Filters.end());
+  Options.LineFilter = std::move(Filters);
+  return std::error_code();
+}
+
 llvm::ErrorOr<ClangTidyOptions> parseConfiguration(StringRef Config) {
   llvm::yaml::Input Input(Config);
   ClangTidyOptions Options;
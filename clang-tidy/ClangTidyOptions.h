@@ -14,8 +14,11 @@
 #include "llvm/ADT/StringMap.h"
 #include "llvm/ADT/StringRef.h"
 #include "llvm/Support/ErrorOr.h"
+#include "llvm/Support/FileSystem.h"
+#include <cstdint>
 #include <functional>
 #include <map>
+#include <memory>
 #include <string>
 #include <system_error>
 #include <utility>
@@ -39,9 +42,53 @@ struct FileFilter {
 /// \brief Global options. These options are neither stored nor read from
 /// configuration files.
 struct ClangTidyGlobalOptions {
+  ClangTidyGlobalOptions()
+      : Jobs(1), MatchThreads(1), AnalyzeHeadersOnce(false),
+        PruneFilteredCode(false), TranslationUnitTimeBudget(0),
+        CheckTimeBudget(0), MemoryLimit(0) {}
+
   /// \brief Output warnings from certain line ranges of certain files only.
   /// If empty, no warnings will be filtered.
   std::vector<FileFilter> LineFilter;
+
+  /// \brief Number of translation units to process concurrently. Zero means
+  /// one per available hardware thread.
+  unsigned Jobs;
+
+  /// \brief Number of threads running the matchers of a translation unit.
+  /// If greater than one, the checks that can match concurrently are split
+  /// into as many groups, whose matchers run concurrently on the AST, and
+  /// their matches are then checked on the main thread. Zero means one per
+  /// available hardware thread.
+  unsigned MatchThreads;
+
+  /// \brief Directory to store the results of each translation unit in. If
+  /// not empty, unchanged translation units are not analyzed again.
+  std::string CacheDirectory;
+
+  /// \brief Only analyze the first inclusion of each header (with the same
+  /// contents) in a run instead of once per including translation unit.
+  bool AnalyzeHeadersOnce;
+
+  /// \brief Don't analyze code whose diagnostics would be filtered out by the
+  /// header filter, the system headers setting or the line filter.
+  bool PruneFilteredCode;
+
+  /// \brief Wall-clock seconds after which no more checks are run on a
+  /// translation unit. Zero means no limit.
+  double TranslationUnitTimeBudget;
+
+  /// \brief Wall-clock seconds each check may spend on a translation unit
+  /// before it is disabled for the rest of it. Zero means no limit.
+  double CheckTimeBudget;
+
+  /// \brief File to read the cost of each source file in previous runs from,
+  /// and to record the costs of this run in, see \c ClangTidyHistory.
+  std::string HistoryFile;
+
+  /// \brief Bytes of memory that the files processed concurrently may use
+  /// together, according to the history. Zero means no limit.
+  uint64_t MemoryLimit;
 };
 
 /// \brief Contains options for clang-tidy. These options may be read from
@@ -126,6 +173,31 @@ public:
   /// \brief Returns options applying to a specific translation unit with the
   /// specified \p FileName.
   ClangTidyOptions getOptions(llvm::StringRef FileName);
+
+  /// \brief Returns the options applying to \p FileName merged on top of
+  /// \c ClangTidyOptions::getDefaults().
+  ///
+  /// The result may be shared with other files that have the same
+  /// configuration and is only recomputed when the configuration changes (see
+  /// \c refresh), so looking up the options of a file is cheap.
+  virtual std::shared_ptr<const ClangTidyOptions>
+  getMergedOptions(llvm::StringRef FileName);
+
+  /// \brief Drops any cached options that are out of date, e.g. because a
+  /// configuration file has changed since it was read.
+  ///
+  /// Long-running processes call this before reusing the provider for new
+  /// files.
+  virtual void refresh() {}
+
+protected:
+  /// \brief Merges \p RawOptions on top of \c ClangTidyOptions::getDefaults().
+  std::shared_ptr<const ClangTidyOptions>
+  mergeRawOptions(const std::vector<OptionsSource> &RawOptions);
+
+private:
+  /// \brief \c ClangTidyOptions::getDefaults(), computed on first use.
+  std::unique_ptr<ClangTidyOptions> Defaults;
 };
 
 /// \brief Implementation of the \c ClangTidyOptionsProvider interface, which
@@ -140,9 +212,14 @@ public:
   }
   std::vector<OptionsSource> getRawOptions(llvm::StringRef FileName) override;
 
+  /// \brief Returns the same merged options for all files.
+  std::shared_ptr<const ClangTidyOptions>
+  getMergedOptions(llvm::StringRef FileName) override;
+
 private:
   ClangTidyGlobalOptions GlobalOptions;
   ClangTidyOptions DefaultOptions;
+  std::shared_ptr<const ClangTidyOptions> MergedOptions;
 };
 
 /// \brief Implementation of ClangTidyOptions interface, which is used for
@@ -232,12 +309,31 @@ public:
 
   std::vector<OptionsSource> getRawOptions(llvm::StringRef FileName) override;
 
+  /// \brief Returns the merged options of the directory of \p FileName.
+  ///
+  /// The result is memoized per directory and shared by all directories that
+  /// use the same configuration file.
+  std::shared_ptr<const ClangTidyOptions>
+  getMergedOptions(llvm::StringRef FileName) override;
+
+  /// \brief Drops all cached options if any configuration file looked up so
+  /// far has been created, changed or removed since.
+  void refresh() override;
+
 protected:
   /// \brief Try to read configuration files from \p Directory using registered
   /// \c ConfigHandlers.
   llvm::Optional<OptionsSource> tryReadConfigFile(llvm::StringRef Directory);
 
   llvm::StringMap<OptionsSource> CachedOptions;
+  /// \brief The status of all configuration files looked up (whether they
+  /// exist or not) when they were looked up.
+  llvm::StringMap<llvm::sys::fs::file_status> ConfigFiles;
+  /// \brief Merged options by the absolute path of the directory they apply
+  /// to.
+  llvm::StringMap<std::shared_ptr<const ClangTidyOptions>> DirectoryOptions;
+  /// \brief Merged options by the names of the sources they were merged from.
+  llvm::StringMap<std::shared_ptr<const ClangTidyOptions>> SourceOptions;
   ClangTidyOptions OverrideOptions;
   ConfigFileHandlers ConfigHandlers;
 };
@@ -246,6 +342,15 @@ protected:
 std::error_code parseLineFilter(llvm::StringRef LineFilter,
                                 ClangTidyGlobalOptions &Options);
 
+/// \brief Parses a unified diff and stores the line ranges added or changed by
+/// it to \p Options.LineFilter.
+///
+/// \p StripComponents leading path components are removed from the file names
+/// in the diff, e.g. 1 for the "a/" and "b/" prefixes used by git. Files that
+/// were deleted or only had lines removed are not included.
+std::error_code parseUnifiedDiff(llvm::StringRef Diff, unsigned StripComponents,
+                                 ClangTidyGlobalOptions &Options);
+
 /// \brief Parses configuration from JSON and returns \c ClangTidyOptions or an
 /// error.
 llvm::ErrorOr<ClangTidyOptions> parseConfiguration(llvm::StringRef Config);
@@ -0,0 +1,290 @@
+//===--- ClangTidyProfiling.cpp - clang-tidy --------------------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "ClangTidyProfiling.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/YAMLTraits.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <iterator>
+#include <limits>
+
+using namespace llvm;
+
+namespace {
+struct TimeSummary {
+  std::string Name;
+  double Wall;
+  double User;
+  double System;
+};
+
+struct FileSummary {
+  std::string File;
+  double Wall;
+  uint64_t Memory;
+  std::vector<TimeSummary> Phases;
+  std::vector<TimeSummary> Checks;
+};
+
+struct ProfileSummary {
+  double Rendering;
+  std::vector<TimeSummary> Checks;
+  std::vector<TimeSummary> Phases;
+  std::vector<FileSummary> Files;
+};
+} // namespace
+
+LLVM_YAML_IS_SEQUENCE_VECTOR(TimeSummary)
+LLVM_YAML_IS_SEQUENCE_VECTOR(FileSummary)
+
+namespace llvm {
+namespace yaml {
+
+template <> struct MappingTraits<TimeSummary> {
+  static void mapping(IO &IO, TimeSummary &Time) {
+    IO.mapRequired("Name", Time.Name);
+    IO.mapRequired("Wall", Time.Wall);
+    IO.mapRequired("User", Time.User);
+    IO.mapRequired("System", Time.System);
+  }
+};
+
+template <> struct MappingTraits<FileSummary> {
+  static void mapping(IO &IO, FileSummary &File) {
+    IO.mapRequired("File", File.File);
+    IO.mapRequired("Wall", File.Wall);
+    IO.mapRequired("Memory", File.Memory);
+    IO.mapRequired("Phases", File.Phases);
+    IO.mapRequired("Checks", File.Checks);
+  }
+};
+
+template <> struct MappingTraits<ProfileSummary> {
+  static void mapping(IO &IO, ProfileSummary &Summary) {
+    IO.mapRequired("Checks", Summary.Checks);
+    IO.mapRequired("Phases", Summary.Phases);
+    IO.mapRequired("Rendering", Summary.Rendering);
+    IO.mapRequired("Files", Summary.Files);
+  }
+};
+
+} // namespace yaml
+} // namespace llvm
+
+namespace clang {
+namespace tidy {
+
+void ProfileData::startFile(StringRef File) {
+  assert(!InFile && "Previous file not finished");
+  FileStart = TimeRecord::getCurrentTime(true);
+  PhaseStart = FileStart;
+  FileProfile Profile;
+  Profile.File = File.str();
+  Profile.Thread = Thread;
+  Profile.Start = FileStart.getWallTime();
+  Profile.Memory = 0;
+  Profile.Phases.push_back({"Parsing", FileStart.getWallTime(), TimeRecord()});
+  Files.push_back(std::move(Profile));
+  InFile = true;
+}
+
+void ProfileData::finishPhase(const TimeRecord &Now) {
+  TimeRecord &Time = Files.back().Phases.back().Time;
+  Time = Now;
+  Time -= PhaseStart;
+}
+
+void ProfileData::startPhase(StringRef Name) {
+  if (!InFile)
+    return;
+  TimeRecord Now = TimeRecord::getCurrentTime(true);
+  finishPhase(Now);
+  Files.back().Phases.push_back({Name, Now.getWallTime(), TimeRecord()});
+  PhaseStart = Now;
+}
+
+void ProfileData::finishFile() {
+  assert(InFile && "No file started");
+  TimeRecord Now = TimeRecord::getCurrentTime(false);
+  finishPhase(Now);
+  FileProfile &Profile = Files.back();
+  Profile.Time = Now;
+  Profile.Time -= FileStart;
+  for (const auto &Check : Profile.Checks)
+    Records[Check.getKey()] += Check.getValue();
+  InFile = false;
+}
+
+void ProfileData::merge(ProfileData &Other) {
+  assert(!Other.InFile && "Merging unfinished profile");
+  for (const auto &Record : Other.Records)
+    Records[Record.getKey()] += Record.getValue();
+  std::move(Other.Files.begin(), Other.Files.end(), std::back_inserter(Files));
+  Other.Files.clear();
+  Rendering += Other.Rendering;
+}
+
+static TimeSummary getTimeSummary(StringRef Name, const TimeRecord &Time) {
+  return {Name, Time.getWallTime(), Time.getUserTime(), Time.getSystemTime()};
+}
+
+// Returns the summaries of Records sorted by decreasing wall time.
+static std::vector<TimeSummary>
+getTimeSummaries(const StringMap<TimeRecord> &Records) {
+  std::vector<TimeSummary> Summaries;
+  for (const auto &Record : Records)
+    Summaries.push_back(getTimeSummary(Record.getKey(), Record.getValue()));
+  std::sort(Summaries.begin(), Summaries.end(),
+            [](const TimeSummary &A, const TimeSummary &B) {
+              return A.Wall > B.Wall || (A.Wall == B.Wall && A.Name < B.Name);
+            });
+  return Summaries;
+}
+
+void writeProfileSummary(const ProfileData &Profile, raw_ostream &OS) {
+  ProfileSummary Summary;
+  Summary.Rendering = Profile.Rendering.getWallTime();
+  Summary.Checks = getTimeSummaries(Profile.Records);
+  StringMap<TimeRecord> Phases;
+  for (const FileProfile &File : Profile.Files) {
+    FileSummary FS;
+    FS.File = File.File;
+    FS.Wall = File.Time.getWallTime();
+    FS.Memory = File.Memory;
+    for (const ProfilePhase &Phase : File.Phases) {
+      FS.Phases.push_back(getTimeSummary(Phase.Name, Phase.Time));
+      Phases[Phase.Name] += Phase.Time;
+    }
+    FS.Checks = getTimeSummaries(File.Checks);
+    Summary.Files.push_back(std::move(FS));
+  }
+  Summary.Phases = getTimeSummaries(Phases);
+
+  yaml::Output YAML(OS);
+  YAML << Summary;
+}
+
+void writeJSONString(StringRef S, raw_ostream &OS) {
+  OS << '"';
+  for (unsigned char C : S) {
+    if (C == '"' || C == '\\')
+      OS << '\\' << C;
+    else if (C < 0x20)
+      OS << format("\\u%04x", C);
+    else
+      OS << C;
+  }
+  OS << '"';
+}
+
+// Writes a complete ("X") trace event. Times are given in seconds, and
+// written in microseconds relative to Origin.
+static void writeTraceEvent(StringRef Name, StringRef Category, unsigned Thread,
+                            double Start, double Duration, double Origin,
+                            raw_ostream &OS) {
+  OS << "{\"name\":";
+  writeJSONString(Name, OS);
+  OS << ",\"cat\":";
+  writeJSONString(Category, OS);
+  OS << ",\"ph\":\"X\",\"pid\":0,\"tid\":" << Thread
+     << ",\"ts\":" << format("%.0f", (Start - Origin) * 1e6)
+     << ",\"dur\":" << format("%.0f", Duration * 1e6) << ",\"args\":{";
+}
+
+void writeProfileTrace(const ProfileData &Profile, raw_ostream &OS) {
+  double Origin = std::numeric_limits<double>::max();
+  for (const FileProfile &File : Profile.Files)
+    Origin = std::min(Origin, File.Start);
+
+  OS << "{\"traceEvents\":[";
+  bool First = true;
+  auto Separate = [&] {
+    OS << (First ? "\n" : ",\n");
+    First = false;
+  };
+  for (const FileProfile &File : Profile.Files) {
+    Separate();
+    writeTraceEvent(File.File, "File", File.Thread, File.Start,
+                    File.Time.getWallTime(), Origin, OS);
+    OS << "\"memory\":" << File.Memory << "}}";
+    for (const ProfilePhase &Phase : File.Phases) {
+      Separate();
+      writeTraceEvent(Phase.Name, "Phase", File.Thread, Phase.Start,
+                      Phase.Time.getWallTime(), Origin, OS);
+      // Checks are run interleaved, so only their total time per file is
+      // known. List it with the phase that runs them.
+      if (Phase.Name == "Matching") {
+        bool FirstCheck = true;
+        for (const TimeSummary &Check : getTimeSummaries(File.Checks)) {
+          OS << (FirstCheck ? "" : ",");
+          FirstCheck = false;
+          writeJSONString(Check.Name, OS);
+          OS << ":" << format("%.0f", Check.Wall * 1e6);
+        }
+      }
+      OS << "}}";
+    }
+  }
+  OS << "\n],\"displayTimeUnit\":\"ms\"}\n";
+}
+
+bool writeProfile(StringRef FileName, const ProfileData &Profile,
+                  void (*Write)(const ProfileData &, raw_ostream &)) {
+  std::error_code EC;
+  raw_fd_ostream OS(FileName, EC, sys::fs::F_Text);
+  if (EC) {
+    errs() << "Error opening output file: " << EC.message() << '\n';
+    return false;
+  }
+  Write(Profile, OS);
+  return true;
+}
+
+void printProfileData(const ProfileData &Profile, raw_ostream &OS) {
+  // Time is first to allow for sorting by it.
+  std::vector<std::pair<TimeRecord, StringRef>> Timers;
+  TimeRecord Total;
+
+  for (const auto &P : Profile.Records) {
+    Timers.emplace_back(P.getValue(), P.getKey());
+    Total += P.getValue();
+  }
+
+  std::sort(Timers.begin(), Timers.end());
+
+  std::string Line = "===" + std::string(73, '-') + "===\n";
+  OS << Line;
+
+  if (Total.getUserTime())
+    OS << "   ---User Time---";
+  if (Total.getSystemTime())
+    OS << "   --System Time--";
+  if (Total.getProcessTime())
+    OS << "   --User+System--";
+  OS << "   ---Wall Time---";
+  if (Total.getMemUsed())
+    OS << "  ---Mem---";
+  OS << "  --- Name ---\n";
+
+  // Loop through all of the timing data, printing it out.
+  for (auto I = Timers.rbegin(), E = Timers.rend(); I != E; ++I) {
+    I->first.print(Total, OS);
+    OS << I->second << '\n';
+  }
+
+  Total.print(Total, OS);
+  OS << "Total\n";
+  OS << Line << "\n";
+  OS.flush();
+}
+
+} // end namespace tidy
+} // end namespace clang
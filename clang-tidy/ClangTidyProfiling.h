@@ -0,0 +1,124 @@
+//===--- ClangTidyProfiling.h - clang-tidy ----------------------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_CLANG_TOOLS_EXTRA_CLANG_TIDY_CLANGTIDYPROFILING_H
+#define LLVM_CLANG_TOOLS_EXTRA_CLANG_TIDY_CLANGTIDYPROFILING_H
+
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Timer.h"
+#include <string>
+#include <vector>
+
+namespace llvm {
+class raw_ostream;
+} // namespace llvm
+
+namespace clang {
+namespace tidy {
+
+/// \brief The time spent in one phase of processing a translation unit.
+struct ProfilePhase {
+  std::string Name;
+  /// \brief Wall clock time at the start of the phase, in seconds.
+  double Start;
+  llvm::TimeRecord Time;
+};
+
+/// \brief Profiling data of a single compile command.
+struct FileProfile {
+  std::string File;
+  /// \brief The thread the file was processed on, see \c ProfileData::Thread.
+  unsigned Thread;
+  /// \brief Wall clock time at the start of processing, in seconds.
+  double Start;
+  llvm::TimeRecord Time;
+  /// \brief The consecutive phases of processing the file.
+  std::vector<ProfilePhase> Phases;
+  /// \brief Time spent in the matchers and callbacks of each check.
+  llvm::StringMap<llvm::TimeRecord> Checks;
+  /// \brief Bytes allocated for the AST and the source buffers.
+  uint64_t Memory;
+};
+
+/// \brief Container for clang-tidy profiling data.
+///
+/// A \c ProfileData is only used by one thread at a time. Parallel runs
+/// collect a separate one per thread and \c merge them at the end.
+struct ProfileData {
+  ProfileData() : Thread(0), InFile(false) {}
+
+  /// \brief Time spent in the matchers and callbacks of each check, over all
+  /// files.
+  llvm::StringMap<llvm::TimeRecord> Records;
+
+  /// \brief Profiles of all processed files, in the order they were started.
+  std::vector<FileProfile> Files;
+
+  /// \brief Time spent passing diagnostics to the output sinks (display,
+  /// export), over all files.
+  llvm::TimeRecord Rendering;
+
+  /// \brief Identifies the thread this data is collected on.
+  unsigned Thread;
+
+  /// \brief Starts the profile of \p File with the "Parsing" phase.
+  void startFile(llvm::StringRef File);
+
+  /// \brief Ends the current phase of the file being processed and starts
+  /// phase \p Name. Does nothing if no file is being processed.
+  void startPhase(llvm::StringRef Name);
+
+  /// \brief Ends the profile of the file being processed and adds its check
+  /// times to \c Records.
+  void finishFile();
+
+  /// \brief Returns the profile of the file being processed, or \c nullptr.
+  FileProfile *getCurrentFile() { return InFile ? &Files.back() : nullptr; }
+
+  /// \brief Adds all data of \p Other to this one.
+  void merge(ProfileData &Other);
+
+private:
+  void finishPhase(const llvm::TimeRecord &Now);
+
+  bool InFile;
+  llvm::TimeRecord FileStart;
+  llvm::TimeRecord PhaseStart;
+};
+
+/// \brief Writes \p Profile in the Chrome trace event format, which can be
+/// loaded in chrome://tracing.
+///
+/// Each file is an event on the timeline of the thread processing it, and
+/// contains nested events for its phases.
+void writeProfileTrace(const ProfileData &Profile, llvm::raw_ostream &OS);
+
+/// \brief Writes a YAML summary of \p Profile, with the time spent in each
+/// check and each phase, over all files and for each file.
+void writeProfileSummary(const ProfileData &Profile, llvm::raw_ostream &OS);
+
+/// \brief Writes \p Profile with \p Write (e.g. \c writeProfileTrace) to the
+/// file \p FileName. Returns \c false if the file can't be opened, which is
+/// reported to stderr.
+bool writeProfile(llvm::StringRef FileName, const ProfileData &Profile,
+                  void (*Write)(const ProfileData &, llvm::raw_ostream &));
+
+/// \brief Writes \p S as a JSON string literal, escaping quotes, backslashes
+/// and control characters.
+void writeJSONString(llvm::StringRef S, llvm::raw_ostream &OS);
+
+/// \brief Prints a table of the time spent in each check over all files, as
+/// shown by \c -enable-check-profile.
+void printProfileData(const ProfileData &Profile, llvm::raw_ostream &OS);
+
+} // end namespace tidy
+} // end namespace clang
+
+#endif // LLVM_CLANG_TOOLS_EXTRA_CLANG_TIDY_CLANGTIDYPROFILING_H
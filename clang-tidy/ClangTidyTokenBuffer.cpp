@@ -0,0 +1,61 @@
+//===--- ClangTidyTokenBuffer.cpp - clang-tidy ------------------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "ClangTidyTokenBuffer.h"
+#include "clang/Basic/SourceManager.h"
+#include "clang/Lex/Lexer.h"
+#include <algorithm>
+
+namespace clang {
+namespace tidy {
+
+TokenBuffer::TokenBuffer(const SourceManager &SM, FileID FID,
+                         const LangOptions &LangOpts) {
+  bool Invalid = false;
+  StringRef Buffer = SM.getBufferData(FID, &Invalid);
+  if (Invalid)
+    return;
+  Start = SM.getLocForStartOfFile(FID);
+  End = Start.getLocWithOffset(Buffer.size());
+
+  Lexer RawLexer(Start, LangOpts, Buffer.begin(), Buffer.begin(),
+                 Buffer.end());
+  RawLexer.SetCommentRetentionState(true);
+  Token Tok;
+  do {
+    RawLexer.LexFromRawLexer(Tok);
+    Tokens.push_back(Tok);
+  } while (Tok.isNot(tok::eof));
+}
+
+bool TokenBuffer::contains(SourceLocation Loc) const {
+  return Start.isValid() && Loc.isFileID() && !(Loc < Start) && !(End < Loc);
+}
+
+size_t TokenBuffer::findToken(SourceLocation Loc) const {
+  if (!contains(Loc))
+    return Tokens.size();
+  // The eof token is empty, so it is only found past all other tokens.
+  auto I = std::upper_bound(
+      Tokens.begin(), Tokens.end() - 1, Loc,
+      [](SourceLocation Value, const Token &Tok) {
+        return Value < Tok.getLocation().getLocWithOffset(Tok.getLength());
+      });
+  return I - Tokens.begin();
+}
+
+const Token *TokenBuffer::getTokenAt(SourceLocation Loc) const {
+  size_t I = findToken(Loc);
+  if (I == Tokens.size() || Loc < Tokens[I].getLocation())
+    return nullptr;
+  return &Tokens[I];
+}
+
+} // end namespace tidy
+} // end namespace clang
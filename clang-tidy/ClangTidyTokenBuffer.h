@@ -0,0 +1,67 @@
+//===--- ClangTidyTokenBuffer.h - clang-tidy --------------------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_CLANG_TOOLS_EXTRA_CLANG_TIDY_CLANGTIDYTOKENBUFFER_H
+#define LLVM_CLANG_TOOLS_EXTRA_CLANG_TIDY_CLANGTIDYTOKENBUFFER_H
+
+#include "clang/Basic/SourceLocation.h"
+#include "clang/Lex/Token.h"
+#include "llvm/ADT/ArrayRef.h"
+#include <vector>
+
+namespace clang {
+
+class LangOptions;
+class SourceManager;
+
+namespace tidy {
+
+/// \brief The raw tokens of a source file, including comments.
+///
+/// Checks that need the exact tokens of some source range would otherwise
+/// re-lex it with a raw \c Lexer for each match. A file is lexed once, when it
+/// is first requested through \c ClangTidyContext::getTokenBuffer, and tokens
+/// are looked up by binary search.
+///
+/// As with a raw \c Lexer, identifiers and keywords are
+/// \c tok::raw_identifier tokens. The last token of a file is \c tok::eof.
+class TokenBuffer {
+public:
+  /// \brief Creates a buffer without any tokens.
+  TokenBuffer() {}
+
+  /// \brief Lexes the file \p FID in raw mode.
+  TokenBuffer(const SourceManager &SM, FileID FID, const LangOptions &LangOpts);
+
+  /// \brief Returns all tokens of the file in order.
+  ArrayRef<Token> tokens() const { return Tokens; }
+
+  /// \brief Returns the index of the token containing \p Loc, or of the first
+  /// token after it if \p Loc is in whitespace.
+  ///
+  /// Returns \c tokens().size() if \p Loc is not a file location in this
+  /// file.
+  size_t findToken(SourceLocation Loc) const;
+
+  /// \brief Returns the token containing \p Loc, or \c nullptr if there is
+  /// none.
+  const Token *getTokenAt(SourceLocation Loc) const;
+
+private:
+  bool contains(SourceLocation Loc) const;
+
+  SourceLocation Start;
+  SourceLocation End;
+  std::vector<Token> Tokens;
+};
+
+} // end namespace tidy
+} // end namespace clang
+
+#endif // LLVM_CLANG_TOOLS_EXTRA_CLANG_TIDY_CLANGTIDYTOKENBUFFER_H
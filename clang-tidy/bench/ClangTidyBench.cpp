@@ -0,0 +1,390 @@
+//===--- tools/extra/clang-tidy/bench/ClangTidyBench.cpp - clang-tidy -----===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+///
+///  \file This file implements a benchmark for clang-tidy checks.
+///
+///  The benchmark runs each check alone and the whole set of checks in
+///  parallel on generated translation units, and compares the time and memory
+///  of each run to a baseline file.
+///
+//===----------------------------------------------------------------------===//
+
+#include "../ClangTidy.h"
+#include "SyntheticSources.h"
+#include "clang/Tooling/CompilationDatabase.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/Signals.h"
+#include "llvm/Support/Timer.h"
+#include "llvm/Support/YAMLTraits.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+
+using namespace clang;
+using namespace clang::tidy;
+using namespace llvm;
+
+static cl::OptionCategory BenchCategory("clang-tidy-bench options");
+
+static cl::opt<std::string>
+    Checks("checks", cl::desc("Checks to benchmark, in the format of the\n"
+                              "clang-tidy -checks option. Each enabled check\n"
+                              "is run alone, and all of them together."),
+           cl::init("*,-clang-analyzer-*"), cl::cat(BenchCategory));
+
+static cl::opt<unsigned>
+    Scale("scale", cl::desc("Multiplies the size of the generated sources."),
+          cl::init(1), cl::cat(BenchCategory));
+
+static cl::opt<unsigned>
+    Jobs("j", cl::desc("Number of files processed concurrently when running\n"
+                       "all checks together. 0 means one per available\n"
+                       "hardware thread."),
+         cl::init(0), cl::cat(BenchCategory));
+
+static cl::opt<unsigned>
+    Repeat("repeat", cl::desc("Number of timed runs of each benchmark. The\n"
+                              "fastest one is reported."),
+           cl::init(3), cl::cat(BenchCategory));
+
+static cl::opt<std::string>
+    Baseline("baseline", cl::desc("YAML file with the results of a previous\n"
+                                  "run to compare to. Exits with an error if\n"
+                                  "any benchmark got slower or uses more\n"
+                                  "memory than allowed by -tolerance.\n"
+                                  "Benchmarks missing from the baseline are\n"
+                                  "reported with a warning."),
+             cl::value_desc("filename"), cl::cat(BenchCategory));
+
+static cl::opt<std::string>
+    WriteBaseline("write-baseline",
+                  cl::desc("Write the results to this file, in the format\n"
+                           "read by -baseline."),
+                  cl::value_desc("filename"), cl::cat(BenchCategory));
+
+static cl::opt<double>
+    Tolerance("tolerance", cl::desc("Percentage by which time and memory may\n"
+                                    "exceed the baseline."),
+              cl::init(20), cl::cat(BenchCategory));
+
+static cl::opt<double>
+    MinDelta("min-delta", cl::desc("Seconds by which a benchmark may exceed\n"
+                                   "the baseline regardless of -tolerance,\n"
+                                   "to ignore noise in fast checks."),
+             cl::init(0.005), cl::cat(BenchCategory));
+
+static cl::opt<std::string>
+    KeepSources("keep-sources",
+                cl::desc("Write the generated sources to this directory\n"
+                         "and keep them, instead of using a temporary one."),
+                cl::value_desc("directory"), cl::cat(BenchCategory));
+
+namespace {
+
+/// \brief The result of one benchmark.
+struct BenchResult {
+  std::string Name;
+  /// \brief Wall-clock seconds of the fastest run over all generated files.
+  double Seconds;
+  /// \brief Largest memory used for the AST and sources of one of the files.
+  uint64_t Memory;
+};
+
+/// \brief Collects compiler errors, which mean the generated sources aren't
+/// benchmarking what they should, and drops all other diagnostics.
+class CompilerErrorSink : public ClangTidyErrorSink {
+public:
+  void handleErrors(ArrayRef<ClangTidyError> Errors) override {
+    for (const ClangTidyError &Error : Errors)
+      if (Error.CheckName == "clang-diagnostic-error")
+        CompilerErrors.push_back(Error.Message.Message);
+  }
+
+  std::vector<std::string> CompilerErrors;
+};
+
+} // end anonymous namespace
+
+LLVM_YAML_IS_SEQUENCE_VECTOR(BenchResult)
+
+namespace llvm {
+namespace yaml {
+
+template <> struct MappingTraits<BenchResult> {
+  static void mapping(IO &IO, BenchResult &Result) {
+    IO.mapRequired("Name", Result.Name);
+    IO.mapRequired("Seconds", Result.Seconds);
+    IO.mapRequired("Memory", Result.Memory);
+  }
+};
+
+} // namespace yaml
+} // namespace llvm
+
+/// \brief Writes the generated sources to \p Directory and adds their paths
+/// to \p Files.
+static bool writeSources(StringRef Directory,
+                         std::vector<std::string> &Files) {
+  for (const bench::SyntheticSource &Source : bench::generateSources(Scale)) {
+    SmallString<128> Path(Directory);
+    sys::path::append(Path, Source.Name);
+    std::error_code EC;
+    raw_fd_ostream OS(Path, EC, sys::fs::F_None);
+    if (EC) {
+      errs() << "Can't write " << Path << ": " << EC.message() << "\n";
+      return false;
+    }
+    OS << Source.Code;
+    Files.push_back(Path.str());
+  }
+  return true;
+}
+
+/// \brief Runs the checks enabled by \p CheckFilter on \p Files with \p
+/// JobCount parallel jobs and returns the time of the fastest of \c Repeat
+/// runs and the memory used. Returns \c false if any file has compiler
+/// errors.
+static bool runBenchmark(StringRef Name, StringRef CheckFilter,
+                         unsigned JobCount,
+                         const tooling::CompilationDatabase &Compilations,
+                         ArrayRef<std::string> Files, BenchResult &Result) {
+  ClangTidyGlobalOptions GlobalOptions;
+  GlobalOptions.Jobs = JobCount;
+  ClangTidyOptions Options = ClangTidyOptions::getDefaults();
+  Options.Checks = CheckFilter;
+  // Ignore .clang-tidy files, so that they don't change the benchmark.
+  auto MakeProvider = [&] {
+    return llvm::make_unique<DefaultOptionsProvider>(GlobalOptions, Options);
+  };
+
+  Result.Name = Name;
+  Result.Memory = 0;
+  Result.Seconds = 0;
+
+  // The first run warms up the file system caches and measures memory. It is
+  // profiled, so it isn't timed.
+  CompilerErrorSink Sink;
+  ProfileData Profile;
+  runClangTidy(MakeProvider(), Compilations, Files, Sink, &Profile);
+  if (!Sink.CompilerErrors.empty()) {
+    errs() << Name << ": the generated sources don't compile:\n";
+    for (const std::string &Message : Sink.CompilerErrors)
+      errs() << "  " << Message << "\n";
+    return false;
+  }
+  for (const FileProfile &File : Profile.Files)
+    Result.Memory = std::max(Result.Memory, File.Memory);
+
+  for (unsigned I = 0; I < std::max(1u, unsigned(Repeat)); ++I) {
+    CompilerErrorSink TimedSink;
+    TimeRecord Start = TimeRecord::getCurrentTime(/*Start=*/true);
+    runClangTidy(MakeProvider(), Compilations, Files, TimedSink);
+    TimeRecord Time = TimeRecord::getCurrentTime(/*Start=*/false);
+    Time -= Start;
+    if (I == 0 || Time.getWallTime() < Result.Seconds)
+      Result.Seconds = Time.getWallTime();
+  }
+  return true;
+}
+
+static bool readBaseline(StringRef Path, std::vector<BenchResult> &Results) {
+  ErrorOr<std::unique_ptr<MemoryBuffer>> Text = MemoryBuffer::getFile(Path);
+  if (!Text) {
+    errs() << "Can't read baseline " << Path << ": "
+           << Text.getError().message() << "\n";
+    return false;
+  }
+  yaml::Input YAML((*Text)->getBuffer());
+  YAML >> Results;
+  if (YAML.error()) {
+    errs() << "Invalid baseline " << Path << ": " << YAML.error().message()
+           << "\n";
+    return false;
+  }
+  return true;
+}
+
+static bool writeBaseline(StringRef Path, std::vector<BenchResult> Results) {
+  std::error_code EC;
+  raw_fd_ostream OS(Path, EC, sys::fs::F_None);
+  if (EC) {
+    errs() << "Can't write baseline " << Path << ": " << EC.message() << "\n";
+    return false;
+  }
+  yaml::Output YAML(OS);
+  YAML << Results;
+  return true;
+}
+
+/// \brief Prints \p Results next to the baseline values and returns the number
+/// of regressions. Benchmarks missing from the baseline are counted in
+/// \p Missing.
+static unsigned compareToBaseline(ArrayRef<BenchResult> Results,
+                                  ArrayRef<BenchResult> BaselineResults,
+                                  unsigned &Missing) {
+  StringMap<const BenchResult *> Expected;
+  for (const BenchResult &Result : BaselineResults)
+    Expected[Result.Name] = &Result;
+
+  const double Factor = 1 + Tolerance / 100;
+  unsigned Regressions = 0;
+  Missing = 0;
+  outs() << format("%-50s %10s %10s %10s %10s  %s\n", "Benchmark",
+                   "Seconds", "Baseline", "Memory(kB)", "Baseline", "Status");
+  for (const BenchResult &Result : Results) {
+    const BenchResult *Old = Expected.lookup(Result.Name);
+    outs() << format("%-50s %10.4f ", Result.Name.c_str(), Result.Seconds);
+    if (!Old) {
+      ++Missing;
+      outs() << format("%10s %10llu %10s  new\n", "-",
+                       (unsigned long long)(Result.Memory >> 10), "-");
+      continue;
+    }
+    bool Slower = Result.Seconds > Old->Seconds * Factor &&
+                  Result.Seconds > Old->Seconds + MinDelta;
+    bool Larger = Result.Memory > Old->Memory * Factor;
+    StringRef Status = Slower ? (Larger ? "SLOWER, LARGER" : "SLOWER")
+                              : (Larger ? "LARGER" : "ok");
+    if (Slower || Larger)
+      ++Regressions;
+    outs() << format("%10.4f %10llu %10llu  %s\n", Old->Seconds,
+                     (unsigned long long)(Result.Memory >> 10),
+                     (unsigned long long)(Old->Memory >> 10),
+                     Status.str().c_str());
+  }
+  return Regressions;
+}
+
+int main(int argc, const char **argv) {
+  sys::PrintStackTraceOnErrorSignal(argv[0]);
+  cl::HideUnrelatedOptions(BenchCategory);
+  cl::ParseCommandLineOptions(argc, argv, "clang-tidy benchmark\n");
+
+  SmallString<128> Directory;
+  if (!KeepSources.empty()) {
+    Directory = KeepSources;
+    if (std::error_code EC = sys::fs::create_directories(Directory)) {
+      errs() << "Can't create " << Directory << ": " << EC.message() << "\n";
+      return 1;
+    }
+  } else if (std::error_code EC = sys::fs::createUniqueDirectory(
+                 "clang-tidy-bench", Directory)) {
+    errs() << "Can't create a temporary directory: " << EC.message() << "\n";
+    return 1;
+  }
+  sys::fs::make_absolute(Directory);
+
+  std::vector<std::string> Files;
+  bool Ok = writeSources(Directory, Files);
+  tooling::FixedCompilationDatabase Compilations(Directory, {"-std=c++11"});
+
+  ClangTidyOptions Options = ClangTidyOptions::getDefaults();
+  Options.Checks = Checks;
+  std::vector<std::string> CheckNames = getCheckNames(Options);
+
+  std::vector<BenchResult> Results;
+  for (const std::string &Check : CheckNames) {
+    if (!Ok)
+      break;
+    BenchResult Result;
+    Ok = runBenchmark(Check, "-*," + Check, 1, Compilations, Files, Result);
+    Results.push_back(Result);
+  }
+  if (Ok) {
+    BenchResult Result;
+    Ok = runBenchmark("<all>", Checks, Jobs, Compilations, Files, Result);
+    Results.push_back(Result);
+  }
+
+  if (KeepSources.empty()) {
+    for (const std::string &File : Files)
+      sys::fs::remove(File);
+    sys::fs::remove(Directory);
+  }
+  if (!Ok)
+    return 1;
+
+  std::vector<BenchResult> BaselineResults;
+  if (!Baseline.empty() && !readBaseline(Baseline, BaselineResults))
+    return 1;
+  unsigned Missing;
+  unsigned Regressions = compareToBaseline(Results, BaselineResults, Missing);
+
+  if (!WriteBaseline.empty() && !writeBaseline(WriteBaseline, Results))
+    return 1;
+  // Nothing is missing from a baseline that is being regenerated.
+  if (Baseline.empty() || !WriteBaseline.empty())
+    Missing = 0;
+
+  if (Regressions)
+    errs() << Regressions << " benchmark" << (Regressions == 1 ? "" : "s")
+           << " regressed by more than " << Tolerance << "%.\n";
+  // Results depend on the machine, so a baseline without them is stale rather
+  // than a regression.
+  if (Missing)
+    errs() << "warning: " << Missing << " benchmark"
+           << (Missing == 1 ? " is" : "s are")
+           << " missing from the baseline, regenerate it with "
+              "-write-baseline.\n";
+  return Regressions ? 1 : 0;
+}
+
+namespace clang {
+namespace tidy {
+
+// This anchor is used to force the linker to link the CERTModule.
+extern volatile int CERTModuleAnchorSource;
+static int LLVM_ATTRIBUTE_UNUSED CERTModuleAnchorDestination =
+    CERTModuleAnchorSource;
+
+// This anchor is used to force the linker to link the BoostModule.
+extern volatile int BoostModuleAnchorSource;
+static int LLVM_ATTRIBUTE_UNUSED BoostModuleAnchorDestination =
+    BoostModuleAnchorSource;
+
+// This anchor is used to force the linker to link the LLVMModule.
+extern volatile int LLVMModuleAnchorSource;
+static int LLVM_ATTRIBUTE_UNUSED LLVMModuleAnchorDestination =
+    LLVMModuleAnchorSource;
+
+// This anchor is used to force the linker to link the CppCoreGuidelinesModule.
+extern volatile int CppCoreGuidelinesModuleAnchorSource;
+static int LLVM_ATTRIBUTE_UNUSED CppCoreGuidelinesModuleAnchorDestination =
+    CppCoreGuidelinesModuleAnchorSource;
+
+// This anchor is used to force the linker to link the GoogleModule.
+extern volatile int GoogleModuleAnchorSource;
+static int LLVM_ATTRIBUTE_UNUSED GoogleModuleAnchorDestination =
+    GoogleModuleAnchorSource;
+
+// This anchor is used to force the linker to link the MiscModule.
+extern volatile int MiscModuleAnchorSource;
+static int LLVM_ATTRIBUTE_UNUSED MiscModuleAnchorDestination =
+    MiscModuleAnchorSource;
+
+// This anchor is used to force the linker to link the ModernizeModule.
+extern volatile int ModernizeModuleAnchorSource;
+static int LLVM_ATTRIBUTE_UNUSED ModernizeModuleAnchorDestination =
+    ModernizeModuleAnchorSource;
+
+// This anchor is used to force the linker to link the PerformanceModule.
+extern volatile int PerformanceModuleAnchorSource;
+static int LLVM_ATTRIBUTE_UNUSED PerformanceModuleAnchorDestination =
+    PerformanceModuleAnchorSource;
+
+// This anchor is used to force the linker to link the ReadabilityModule.
+extern volatile int ReadabilityModuleAnchorSource;
+static int LLVM_ATTRIBUTE_UNUSED ReadabilityModuleAnchorDestination =
+    ReadabilityModuleAnchorSource;
+
+} // namespace tidy
+} // namespace clang
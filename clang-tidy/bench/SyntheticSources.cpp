@@ -0,0 +1,185 @@
+//===--- SyntheticSources.cpp - clang-tidy --------------------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "SyntheticSources.h"
+#include "llvm/Support/raw_ostream.h"
+
+namespace clang {
+namespace tidy {
+namespace bench {
+
+// Namespaces nested Depth levels deep, each innermost one with a few
+// functions and a class. Every other block has closing namespace comments.
+static void writeDeepNamespaces(unsigned Scale, llvm::raw_ostream &OS) {
+  const unsigned Depth = 12;
+  for (unsigned Block = 0, E = 40 * Scale; Block < E; ++Block) {
+    for (unsigned Level = 0; Level < Depth; ++Level)
+      OS << "namespace ns" << Block << "_" << Level << " {\n";
+    for (unsigned I = 0; I < 5; ++I)
+      OS << "int f" << I << "(int a, int b) { return a * " << I
+         << " + b; }\n";
+    OS << "class C" << Block << " {\npublic:\n  C" << Block
+       << "(int V) : V(V) {}\n  int get() const { return f1(V, V); }\n"
+          "private:\n  int V;\n};\n";
+    for (unsigned Level = Depth; Level-- > 0;) {
+      OS << "}";
+      if (Block % 2 == 0)
+        OS << " // namespace ns" << Block << "_" << Level;
+      OS << "\n";
+    }
+  }
+}
+
+// Recursive and variadic templates with many distinct instantiations.
+static void writeHeavyTemplates(unsigned Scale, llvm::raw_ostream &OS) {
+  OS << "template <unsigned N> struct Fib {\n"
+        "  static const unsigned value = Fib<N - 1>::value + "
+        "Fib<N - 2>::value;\n"
+        "};\n"
+        "template <> struct Fib<0> { static const unsigned value = 0; };\n"
+        "template <> struct Fib<1> { static const unsigned value = 1; };\n"
+        "template <typename T, unsigned N> class Array {\n"
+        "public:\n"
+        "  T *begin() { return Data; }\n"
+        "  T *end() { return Data + N; }\n"
+        "  T &operator[](unsigned I) { return Data[I]; }\n"
+        "  unsigned size() const { return N; }\n"
+        "private:\n"
+        "  T Data[N];\n"
+        "};\n"
+        "template <typename T> T maxOf(T A) { return A; }\n"
+        "template <typename T, typename... Ts> T maxOf(T A, Ts... Rest) {\n"
+        "  T B = maxOf(Rest...);\n"
+        "  return A > B ? A : B;\n"
+        "}\n";
+  for (unsigned I = 0, E = 60 * Scale; I < E; ++I) {
+    OS << "unsigned useFib" << I << "() { return Fib<" << I % 24
+       << ">::value; }\n";
+    OS << "double total" << I << "(Array<double, " << I % 32 + 1
+       << "> &A) {\n  double S = 0;\n"
+          "  for (unsigned J = 0; J < A.size(); ++J)\n    S += A[J];\n"
+          "  return S;\n}\n";
+    OS << "long largest" << I << "() { return maxOf(";
+    for (unsigned J = 0, Args = I % 10 + 2; J < Args; ++J)
+      OS << (J ? ", " : "") << J * 7 % 13 << "L";
+    OS << "); }\n";
+  }
+}
+
+// Many small functions with the patterns common checks look for: loops over
+// arrays, null checks against 0, C-style casts and unused parameters.
+static void writeManyFunctions(unsigned Scale, llvm::raw_ostream &OS) {
+  OS << "struct Point { int X, Y; };\n";
+  for (unsigned I = 0, E = 400 * Scale; I < E; ++I) {
+    OS << "static int helper" << I << "(int *Values, int Count) {\n"
+       << "  int Result = 0;\n"
+       << "  for (int J = 0; J < Count; ++J)\n"
+       << "    Result += Values[J] * " << I % 7 + 1 << ";\n"
+       << "  if (Values == 0)\n"
+       << "    return -1;\n"
+       << "  return (int)(Result / 2.0);\n"
+       << "}\n";
+    OS << "int distance" << I << "(const Point &A, const Point &B) {\n"
+       << "  int Values[2] = {A.X - B.X, A.Y - B.Y};\n"
+       << "  return helper" << I << "(Values, 2);\n"
+       << "}\n";
+    if (I % 5 == 0)
+      OS << "void unused" << I << "(int Unused) {}\n";
+  }
+}
+
+// A large enum and functions switching over all of its values.
+static void writeHugeSwitch(unsigned Scale, llvm::raw_ostream &OS) {
+  const unsigned Cases = 500 * Scale;
+  OS << "enum Opcode {\n";
+  for (unsigned I = 0; I < Cases; ++I)
+    OS << "  Op" << I << ",\n";
+  OS << "};\n";
+  static const char *const Operators[] = {"+", "-", "*", "^", "|", "&"};
+  OS << "int dispatch(Opcode Op, int A, int B) {\n  switch (Op) {\n";
+  for (unsigned I = 0; I < Cases; ++I)
+    OS << "  case Op" << I << ":\n    return (A " << Operators[I % 6]
+       << " B) + " << I << ";\n";
+  OS << "  }\n  return 0;\n}\n";
+  OS << "int accumulate(int Code, int A) {\n  int Result = 0;\n"
+        "  switch (Code) {\n";
+  for (unsigned I = 0; I < Cases; ++I) {
+    OS << "  case " << I << ": {\n    int T = A * " << I % 11 << ";\n"
+       << "    Result += T;\n";
+    if (I % 3 != 0)
+      OS << "    break;\n";
+    OS << "  }\n";
+  }
+  OS << "  default:\n    break;\n  }\n  return Result;\n}\n";
+}
+
+// Structs and functions built from nested function-like and X-macros.
+static void writeMacroHeavy(unsigned Scale, llvm::raw_ostream &OS) {
+  OS << "#define CONCAT_(A, B) A##B\n"
+        "#define CONCAT(A, B) CONCAT_(A, B)\n"
+        "#define FIELD_LIST(X)                                              "
+        "   \\\n"
+        "  X(int, Width) X(int, Height) X(double, Scale) X(bool, Visible)   "
+        "   \\\n"
+        "      X(long, Id)\n"
+        "#define DECLARE_FIELD(Type, Name) Type Name;\n"
+        "#define DECLARE_GETTER(Type, Name)                                 "
+        "   \\\n"
+        "  Type get##Name() const { return Name; }\n"
+        "#define CHECK_POSITIVE(V)                                          "
+        "   \\\n"
+        "  do {                                                             "
+        "   \\\n"
+        "    if ((V) < 0)                                                   "
+        "   \\\n"
+        "      return false;                                                "
+        "   \\\n"
+        "  } while (0)\n"
+        "#define SQUARE(X) ((X) * (X))\n";
+  for (unsigned I = 0, E = 150 * Scale; I < E; ++I) {
+    OS << "struct Widget" << I << " {\n"
+       << "  FIELD_LIST(DECLARE_FIELD)\n"
+       << "  FIELD_LIST(DECLARE_GETTER)\n"
+       << "  bool valid() const {\n"
+       << "    CHECK_POSITIVE(Width);\n"
+       << "    CHECK_POSITIVE(Height);\n"
+       << "    return SQUARE(Width) + SQUARE(Height) > " << I << ";\n"
+       << "  }\n"
+       << "};\n";
+    OS << "int CONCAT(compute, " << I << ")(int V) { return SQUARE(V) + "
+       << "SQUARE(V + " << I << "); }\n";
+  }
+}
+
+std::vector<SyntheticSource> generateSources(unsigned Scale) {
+  static const struct {
+    const char *Name;
+    void (*Write)(unsigned, llvm::raw_ostream &);
+  } Generators[] = {
+      {"deep-namespaces.cpp", writeDeepNamespaces},
+      {"heavy-templates.cpp", writeHeavyTemplates},
+      {"many-functions.cpp", writeManyFunctions},
+      {"huge-switch.cpp", writeHugeSwitch},
+      {"macro-heavy.cpp", writeMacroHeavy},
+  };
+  std::vector<SyntheticSource> Sources;
+  for (const auto &Generator : Generators) {
+    SyntheticSource Source;
+    Source.Name = Generator.Name;
+    llvm::raw_string_ostream OS(Source.Code);
+    Generator.Write(Scale, OS);
+    OS.flush();
+    Sources.push_back(std::move(Source));
+  }
+  return Sources;
+}
+
+} // end namespace bench
+} // end namespace tidy
+} // end namespace clang
@@ -0,0 +1,39 @@
+//===--- SyntheticSources.h - clang-tidy ------------------------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_CLANG_TOOLS_EXTRA_CLANG_TIDY_BENCH_SYNTHETICSOURCES_H
+#define LLVM_CLANG_TOOLS_EXTRA_CLANG_TIDY_BENCH_SYNTHETICSOURCES_H
+
+#include <string>
+#include <vector>
+
+namespace clang {
+namespace tidy {
+namespace bench {
+
+/// \brief A generated translation unit.
+struct SyntheticSource {
+  std::string Name;
+  std::string Code;
+};
+
+/// \brief Generates the translation units the benchmark runs on: deeply
+/// nested namespaces, heavy template instantiation, many small functions, huge
+/// switch statements and macro-heavy code.
+///
+/// The sources only depend on \p Scale, which multiplies the number of
+/// declarations in each of them, and compile without errors and without any
+/// headers as C++11.
+std::vector<SyntheticSource> generateSources(unsigned Scale);
+
+} // end namespace bench
+} // end namespace tidy
+} // end namespace clang
+
+#endif // LLVM_CLANG_TOOLS_EXTRA_CLANG_TIDY_BENCH_SYNTHETICSOURCES_H
@@ -23,7 +23,8 @@ ProBoundsConstantArrayIndexCheck::ProBoundsConstantArrayIndexCheck(
     StringRef Name, ClangTidyContext *Context)
     : ClangTidyCheck(Name, Context), GslHeader(Options.get("GslHeader", "")),
       IncludeStyle(utils::IncludeSorter::parseIncludeStyle(
-          Options.get("IncludeStyle", "llvm"))) {}
+          Options.get("IncludeStyle", "llvm"))),
+      Inserter(nullptr) {}
 
 void ProBoundsConstantArrayIndexCheck::storeOptions(
     ClangTidyOptions::OptionMap &Opts) {
@@ -36,9 +37,7 @@ void ProBoundsConstantArrayIndexCheck::registerPPCallbacks(
   if (!getLangOpts().CPlusPlus)
     return;
 
-  Inserter.reset(new utils::IncludeInserter(
-      Compiler.getSourceManager(), Compiler.getLangOpts(), IncludeStyle));
-  Compiler.getPreprocessor().addPPCallbacks(Inserter->CreatePPCallbacks());
+  Inserter = &getSharedState<utils::IncludeInserter>(Compiler, IncludeStyle);
 }
 
 void ProBoundsConstantArrayIndexCheck::registerMatchers(MatchFinder *Finder) {
@@ -90,7 +89,7 @@ void ProBoundsConstantArrayIndexCheck::check(
 
       Optional<FixItHint> Insertion = Inserter->CreateIncludeInsertion(
           Result.SourceManager->getMainFileID(), GslHeader,
-          /*IsAngled=*/false);
+          /*IsAngled=*/false, IncludeStyle);
       if (Insertion)
         Diag << Insertion.getValue();
     }
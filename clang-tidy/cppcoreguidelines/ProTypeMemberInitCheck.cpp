@@ -114,7 +114,8 @@ struct IntializerInsertion {
       : Placement(Placement), Where(Where) {}
 
   SourceLocation getLocation(const ASTContext &Context,
-                             const CXXConstructorDecl &Constructor) const {
+                             const CXXConstructorDecl &Constructor,
+                             const TokenBuffer &Tokens) const {
     assert((Where != nullptr || Placement == InitializerPlacement::New) &&
            "Location should be relative to an existing initializer or this "
            "insertion represents a new initializer list.");
@@ -122,12 +123,12 @@ struct IntializerInsertion {
     switch (Placement) {
     case InitializerPlacement::New:
       Location = utils::lexer::getPreviousNonCommentToken(
-                     Context, Constructor.getBody()->getLocStart())
+                     Tokens, Constructor.getBody()->getLocStart())
                      .getLocation();
       break;
     case InitializerPlacement::Before:
       Location = utils::lexer::getPreviousNonCommentToken(
-                     Context, Where->getSourceRange().getBegin())
+                     Tokens, Where->getSourceRange().getBegin())
                      .getLocation();
       break;
     case InitializerPlacement::After:
@@ -228,8 +229,8 @@ void getInitializationsInOrder(const CXXRecordDecl *ClassDecl,
 }
 
 template <typename T>
-void fixInitializerList(const ASTContext &Context, DiagnosticBuilder &Diag,
-                        const CXXConstructorDecl *Ctor,
+void fixInitializerList(const ASTContext &Context, const TokenBuffer &Tokens,
+                        DiagnosticBuilder &Diag, const CXXConstructorDecl *Ctor,
                         const SmallPtrSetImpl<const T *> &DeclsToInit) {
   // Do not propose fixes in macros since we cannot place them correctly.
   if (Ctor->getLocStart().isMacroID())
@@ -241,8 +242,9 @@ void fixInitializerList(const ASTContext &Context, DiagnosticBuilder &Diag,
   for (const auto &Insertion :
        computeInsertions(Ctor->inits(), OrderedDecls, DeclsToInit)) {
     if (!Insertion.Initializers.empty())
-      Diag << FixItHint::CreateInsertion(Insertion.getLocation(Context, *Ctor),
-                                         Insertion.codeToInsert());
+      Diag << FixItHint::CreateInsertion(
+          Insertion.getLocation(Context, *Ctor, Tokens),
+          Insertion.codeToInsert());
   }
 }
 
@@ -372,7 +374,8 @@ void ProTypeMemberInitCheck::checkMissingMemberInitializer(
     }
   } else {
     // Otherwise, rewrite the constructor's initializer list.
-    fixInitializerList(Context, Diag, Ctor, FieldsToFix);
+    fixInitializerList(Context, getTokenBuffer(Ctor->getBody()->getLocStart()),
+                       Diag, Ctor, FieldsToFix);
   }
 }
 
@@ -410,7 +413,8 @@ void ProTypeMemberInitCheck::checkMissingBaseClassInitializer(
            "constructor does not initialize these bases: %0")
       << toCommaSeparatedString(AllBases, BasesToInit);
 
-  fixInitializerList(Context, Diag, Ctor, BasesToInit);
+  fixInitializerList(Context, getTokenBuffer(Ctor->getBody()->getLocStart()),
+                     Diag, Ctor, BasesToInit);
 }
 
 void ProTypeMemberInitCheck::checkUninitializedTrivialType(
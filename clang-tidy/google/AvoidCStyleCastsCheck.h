@@ -32,6 +32,7 @@ public:
       : ClangTidyCheck(Name, Context) {}
   void registerMatchers(ast_matchers::MatchFinder *Finder) override;
   void check(const ast_matchers::MatchFinder::MatchResult &Result) override;
+  bool canMatchConcurrently() const override { return true; }
 };
 
 } // namespace readability
@@ -8,6 +8,7 @@
 //===----------------------------------------------------------------------===//
 
 #include "ArgumentCommentCheck.h"
+#include "../utils/LexerUtils.h"
 #include "clang/AST/ASTContext.h"
 #include "clang/ASTMatchers/ASTMatchFinder.h"
 #include "clang/Lex/Lexer.h"
@@ -47,32 +48,17 @@ ArgumentCommentCheck::getCommentsInRange(ASTContext *Ctx, SourceRange Range) {
   if (BeginLoc.first != EndLoc.first)
     return Comments;
 
-  bool Invalid = false;
-  StringRef Buffer = SM.getBufferData(BeginLoc.first, &Invalid);
-  if (Invalid)
-    return Comments;
-
-  const char *StrData = Buffer.data() + BeginLoc.second;
-
-  Lexer TheLexer(SM.getLocForStartOfFile(BeginLoc.first), Ctx->getLangOpts(),
-                 Buffer.begin(), StrData, Buffer.end());
-  TheLexer.SetCommentRetentionState(true);
-
-  while (true) {
-    Token Tok;
-    if (TheLexer.LexFromRawLexer(Tok))
-      break;
+  const TokenBuffer &Tokens = getTokenBuffer(Range.getBegin());
+  ArrayRef<Token> AllTokens = Tokens.tokens();
+  for (size_t I = Tokens.findToken(Range.getBegin()), E = AllTokens.size();
+       I != E; ++I) {
+    const Token &Tok = AllTokens[I];
     if (Tok.getLocation() == Range.getEnd() || Tok.getKind() == tok::eof)
       break;
 
-    if (Tok.getKind() == tok::comment) {
-      std::pair<FileID, unsigned> CommentLoc =
-          SM.getDecomposedLoc(Tok.getLocation());
-      assert(CommentLoc.first == BeginLoc.first);
-      Comments.emplace_back(
-          Tok.getLocation(),
-          StringRef(Buffer.begin() + CommentLoc.second, Tok.getLength()));
-    }
+    if (Tok.getKind() == tok::comment)
+      Comments.emplace_back(Tok.getLocation(),
+                            utils::lexer::getTokenText(Tok, SM));
   }
 
   return Comments;
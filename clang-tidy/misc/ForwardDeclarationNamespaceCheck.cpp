@@ -46,6 +46,12 @@ void ForwardDeclarationNamespaceCheck::registerMatchers(MatchFinder *Finder) {
   Finder->addMatcher(friendDecl().bind("friend_decl"), this);
 }
 
+void ForwardDeclarationNamespaceCheck::onStartOfTranslationUnit() {
+  DeclNameToDefinitions.clear();
+  DeclNameToDeclarations.clear();
+  FriendTypes.clear();
+}
+
 void ForwardDeclarationNamespaceCheck::check(
     const MatchFinder::MatchResult &Result) {
   if (const auto *RecordDecl =
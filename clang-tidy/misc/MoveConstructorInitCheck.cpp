@@ -26,13 +26,19 @@ namespace {
 unsigned int
 parmVarDeclRefExprOccurences(const ParmVarDecl &MovableParam,
                              const CXXConstructorDecl &ConstructorDecl,
-                             ASTContext &Context) {
+                             const ASTIndex &Index) {
   unsigned int Occurrences = 0;
-  auto AllDeclRefs =
-      findAll(declRefExpr(to(parmVarDecl(equalsNode(&MovableParam)))));
-  Occurrences += match(AllDeclRefs, *ConstructorDecl.getBody(), Context).size();
-  for (const auto *Initializer : ConstructorDecl.inits()) {
-    Occurrences += match(AllDeclRefs, *Initializer->getInit(), Context).size();
+  for (const DeclRefExpr *Ref : Index.getDeclRefs(&MovableParam)) {
+    if (Index.isDescendant(Ref, ConstructorDecl.getBody())) {
+      ++Occurrences;
+      continue;
+    }
+    for (const auto *Initializer : ConstructorDecl.inits()) {
+      if (Index.isDescendant(Ref, Initializer->getInit())) {
+        ++Occurrences;
+        break;
+      }
+    }
   }
   return Occurrences;
 }
@@ -41,7 +47,7 @@ parmVarDeclRefExprOccurences(const ParmVarDecl &MovableParam,
 
 MoveConstructorInitCheck::MoveConstructorInitCheck(StringRef Name,
                                                    ClangTidyContext *Context)
-    : ClangTidyCheck(Name, Context),
+    : ClangTidyCheck(Name, Context), Inserter(nullptr),
       IncludeStyle(utils::IncludeSorter::parseIncludeStyle(
           Options.get("IncludeStyle", "llvm"))),
       UseCERTSemantics(Options.get("UseCERTSemantics", 0) != 0) {}
@@ -108,7 +114,7 @@ void MoveConstructorInitCheck::handleParamNotMoved(
   const auto *InitArg = Result.Nodes.getNodeAs<DeclRefExpr>("init-arg");
   // If the parameter is referenced more than once it is not safe to move it.
   if (parmVarDeclRefExprOccurences(*MovableParam, *ConstructorDecl,
-                                   *Result.Context) > 1)
+                                   getASTIndex()) > 1)
     return;
   auto DiagOut = diag(InitArg->getLocStart(),
                       "value argument %0 can be moved to avoid copy")
@@ -118,7 +124,7 @@ void MoveConstructorInitCheck::handleParamNotMoved(
       (Twine("std::move(") + MovableParam->getName() + ")").str());
   if (auto IncludeFixit = Inserter->CreateIncludeInsertion(
           Result.SourceManager->getFileID(InitArg->getLocStart()), "utility",
-          /*IsAngled=*/true)) {
+          /*IsAngled=*/true, IncludeStyle)) {
     DiagOut << *IncludeFixit;
   }
 }
@@ -169,9 +175,7 @@ void MoveConstructorInitCheck::handleMoveConstructor(
 }
 
 void MoveConstructorInitCheck::registerPPCallbacks(CompilerInstance &Compiler) {
-  Inserter.reset(new utils::IncludeInserter(
-      Compiler.getSourceManager(), Compiler.getLangOpts(), IncludeStyle));
-  Compiler.getPreprocessor().addPPCallbacks(Inserter->CreatePPCallbacks());
+  Inserter = &getSharedState<utils::IncludeInserter>(Compiler, IncludeStyle);
 }
 
 void MoveConstructorInitCheck::storeOptions(ClangTidyOptions::OptionMap &Opts) {
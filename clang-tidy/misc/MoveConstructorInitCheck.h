@@ -30,6 +30,7 @@ public:
   void registerMatchers(ast_matchers::MatchFinder *Finder) override;
   void check(const ast_matchers::MatchFinder::MatchResult &Result) override;
   void registerPPCallbacks(clang::CompilerInstance &Compiler) override;
+  bool needsWholePreprocessorStream() const override { return false; }
   void storeOptions(ClangTidyOptions::OptionMap &Opts) override;
 
 private:
@@ -38,7 +39,7 @@ private:
   void
   handleParamNotMoved(const ast_matchers::MatchFinder::MatchResult &Result);
 
-  std::unique_ptr<utils::IncludeInserter> Inserter;
+  utils::IncludeInserter *Inserter;
   const utils::IncludeSorter::IncludeStyle IncludeStyle;
   const bool UseCERTSemantics;
 };
@@ -151,6 +151,10 @@ void NewDeleteOverloadsCheck::registerMatchers(MatchFinder *Finder) {
       this);
 }
 
+void NewDeleteOverloadsCheck::onStartOfTranslationUnit() {
+  Overloads.clear();
+}
+
 void NewDeleteOverloadsCheck::check(const MatchFinder::MatchResult &Result) {
   // Add any matches we locate to the list of things to be checked at the
   // end of the translation unit.
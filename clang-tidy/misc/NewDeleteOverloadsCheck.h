@@ -27,7 +27,9 @@ public:
     : ClangTidyCheck(Name, Context) {}
   void registerMatchers(ast_matchers::MatchFinder *Finder) override;
   void check(const ast_matchers::MatchFinder::MatchResult &Result) override;
+  void onStartOfTranslationUnit() override;
   void onEndOfTranslationUnit() override;
+  bool requiresWholeTranslationUnit() const override { return true; }
 };
 
 } // namespace misc
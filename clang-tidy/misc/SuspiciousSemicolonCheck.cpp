@@ -39,8 +39,8 @@ void SuspiciousSemicolonCheck::check(const MatchFinder::MatchResult &Result) {
   if (LocStart.isMacroID())
     return;
 
-  ASTContext &Ctxt = *Result.Context;
-  auto Token = utils::lexer::getPreviousNonCommentToken(Ctxt, LocStart);
+  const TokenBuffer &Tokens = getTokenBuffer(LocStart);
+  auto Token = utils::lexer::getPreviousNonCommentToken(Tokens, LocStart);
   auto &SM = *Result.SourceManager;
   unsigned SemicolonLine = SM.getSpellingLineNumber(LocStart);
 
@@ -52,13 +52,13 @@ void SuspiciousSemicolonCheck::check(const MatchFinder::MatchResult &Result) {
     return;
 
   SourceLocation LocEnd = Semicolon->getLocEnd();
-  FileID FID = SM.getFileID(LocEnd);
-  llvm::MemoryBuffer *Buffer = SM.getBuffer(FID, LocEnd);
-  Lexer Lexer(SM.getLocForStartOfFile(FID), Ctxt.getLangOpts(),
-              Buffer->getBufferStart(), SM.getCharacterData(LocEnd) + 1,
-              Buffer->getBufferEnd());
-  if (Lexer.LexFromRawLexer(Token))
+  ArrayRef<clang::Token> AllTokens = Tokens.tokens();
+  size_t I = Tokens.findToken(LocEnd.getLocWithOffset(1));
+  while (I < AllTokens.size() && AllTokens[I].is(tok::comment))
+    ++I;
+  if (I == AllTokens.size() || AllTokens[I].is(tok::eof))
     return;
+  Token = AllTokens[I];
 
   unsigned BaseIndent = SM.getSpellingColumnNumber(Statement->getLocStart());
   unsigned NewTokenIndent = SM.getSpellingColumnNumber(Token.getLocation());
@@ -31,6 +31,10 @@ void UnusedAliasDeclsCheck::registerMatchers(MatchFinder *Finder) {
   Finder->addMatcher(nestedNameSpecifier().bind("nns"), this);
 }
 
+void UnusedAliasDeclsCheck::onStartOfTranslationUnit() {
+  FoundDecls.clear();
+}
+
 void UnusedAliasDeclsCheck::check(const MatchFinder::MatchResult &Result) {
   if (const auto *AliasDecl = Result.Nodes.getNodeAs<NamedDecl>("alias")) {
     FoundDecls[AliasDecl] = CharSourceRange::getCharRange(
@@ -24,6 +24,21 @@ bool isOverrideMethod(const FunctionDecl *Function) {
     return MD->size_overridden_methods() > 0 || MD->hasAttr<OverrideAttr>();
   return false;
 }
+
+// Returns true if Function is referenced other than by calling it.
+bool hasNonCallReferences(const ASTIndex &Index, const FunctionDecl *Function) {
+  for (const DeclRefExpr *Ref : Index.getDeclRefs(Function)) {
+    bool InCall = false;
+    for (const Stmt *S = Index.getParent(Ref); S && !InCall;
+         S = Index.getParent(S)) {
+      const auto *Call = dyn_cast<CallExpr>(S);
+      InCall = Call && Call->getCalleeDecl() == Function;
+    }
+    if (!InCall)
+      return true;
+  }
+  return false;
+}
 } // namespace
 
 void UnusedParametersCheck::registerMatchers(MatchFinder *Finder) {
@@ -71,15 +86,11 @@ void UnusedParametersCheck::warnOnUnusedParameter(
   const auto *Param = Function->getParamDecl(ParamIndex);
   auto MyDiag = diag(Param->getLocation(), "parameter %0 is unused") << Param;
 
-  auto DeclRefExpr =
-      declRefExpr(to(equalsNode(Function)),
-                  unless(hasAncestor(callExpr(callee(equalsNode(Function))))));
-
+  const ASTIndex &Index = getASTIndex();
   // Comment out parameter name for non-local functions.
   if (Function->isExternallyVisible() ||
       !Result.SourceManager->isInMainFile(Function->getLocation()) ||
-      !ast_matchers::match(DeclRefExpr, *Result.Context).empty() ||
-      isOverrideMethod(Function)) {
+      hasNonCallReferences(Index, Function) || isOverrideMethod(Function)) {
     SourceRange RemovalRange(Param->getLocation(), Param->getLocEnd());
     // Note: We always add a space before the '/*' to not accidentally create a
     // '*/*' for pointer types, which doesn't start a comment. clang-format will
@@ -95,13 +106,8 @@ void UnusedParametersCheck::warnOnUnusedParameter(
       MyDiag << removeParameter(Result, FD, ParamIndex);
 
   // Fix all call sites.
-  auto CallMatches = ast_matchers::match(
-      decl(forEachDescendant(
-          callExpr(callee(functionDecl(equalsNode(Function)))).bind("x"))),
-      *Result.Context->getTranslationUnitDecl(), *Result.Context);
-  for (const auto &Match : CallMatches)
-    MyDiag << removeArgument(Result, Match.getNodeAs<CallExpr>("x"),
-                             ParamIndex);
+  for (const CallExpr *Call : Index.getCalls(Function))
+    MyDiag << removeArgument(Result, Call, ParamIndex);
 }
 
 void UnusedParametersCheck::check(const MatchFinder::MatchResult &Result) {
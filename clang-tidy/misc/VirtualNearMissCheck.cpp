@@ -226,6 +226,11 @@ void VirtualNearMissCheck::registerMatchers(MatchFinder *Finder) {
       this);
 }
 
+void VirtualNearMissCheck::onStartOfTranslationUnit() {
+  PossibleMap.clear();
+  OverriddenMap.clear();
+}
+
 void VirtualNearMissCheck::check(const MatchFinder::MatchResult &Result) {
   const auto *DerivedMD = Result.Nodes.getNodeAs<CXXMethodDecl>("method");
   assert(DerivedMD);
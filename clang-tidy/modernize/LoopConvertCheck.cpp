@@ -540,7 +540,7 @@ void LoopConvertCheck::doConversion(
     // was used exactly once - in the initialization of AliasVar.
   } else {
     VariableNamer Namer(&TUInfo->getGeneratedDecls(),
-                        &TUInfo->getParentFinder().getStmtToParentStmtMap(),
+                        &getASTIndex().getStmtParents(),
                         Loop, IndexVar, MaybeContainer, Context, NamingStyle);
     VarName = Namer.createIndexName();
     // First, replace all usages of the array subscript expression with our new
@@ -784,6 +784,10 @@ bool LoopConvertCheck::isConvertible(ASTContext *Context,
   return true;
 }
 
+void LoopConvertCheck::onStartOfTranslationUnit() {
+  TUInfo.reset(new TUTrackingInfo);
+}
+
 void LoopConvertCheck::check(const MatchFinder::MatchResult &Result) {
   const BoundNodes &Nodes = Result.Nodes;
   Confidence ConfidenceLevel(Confidence::CL_Safe);
@@ -876,10 +880,8 @@ void LoopConvertCheck::check(const MatchFinder::MatchResult &Result) {
   // variable declared inside the loop outside of it.
   // FIXME: Determine when the external dependency isn't an expression converted
   // by another loop.
-  TUInfo->getParentFinder().gatherAncestors(Context->getTranslationUnitDecl());
   DependencyFinderASTVisitor DependencyFinder(
-      &TUInfo->getParentFinder().getStmtToParentStmtMap(),
-      &TUInfo->getParentFinder().getDeclToParentStmtMap(),
+      &getASTIndex().getStmtParents(), &getASTIndex().getDeclParents(),
       &TUInfo->getReplacedVars(), Loop);
 
   if (DependencyFinder.dependsOnInsideVariable(ContainerExpr) ||
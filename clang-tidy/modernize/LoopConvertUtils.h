@@ -10,6 +10,7 @@
 #ifndef LLVM_CLANG_TOOLS_EXTRA_CLANG_TIDY_MODERNIZE_LOOP_CONVERT_UTILS_H
 #define LLVM_CLANG_TOOLS_EXTRA_CLANG_TIDY_MODERNIZE_LOOP_CONVERT_UTILS_H
 
+#include "../ClangTidyASTIndex.h"
 #include "clang/AST/ASTContext.h"
 #include "clang/AST/RecursiveASTVisitor.h"
 #include "clang/ASTMatchers/ASTMatchFinder.h"
@@ -23,12 +24,11 @@ namespace modernize {
 enum LoopFixerKind { LFK_Array, LFK_Iterator, LFK_PseudoArray };
 
 /// A map used to walk the AST in reverse: maps child Stmt to parent Stmt.
-typedef llvm::DenseMap<const clang::Stmt *, const clang::Stmt *> StmtParentMap;
+typedef ASTIndex::StmtParentMap StmtParentMap;
 
 /// A map used to walk the AST in reverse:
 ///  maps VarDecl to the to parent DeclStmt.
-typedef llvm::DenseMap<const clang::VarDecl *, const clang::DeclStmt *>
-    DeclParentMap;
+typedef ASTIndex::DeclParentMap DeclParentMap;
 
 /// A map used to track which variables have been removed by a refactoring pass.
 /// It maps the parent ForStmt to the removed index variable's VarDecl.
@@ -42,38 +42,6 @@ typedef llvm::DenseMap<const clang::Stmt *, std::string>
 /// A vector used to store the AST subtrees of an Expr.
 typedef llvm::SmallVector<const clang::Expr *, 16> ComponentVector;
 
-/// \brief Class used build the reverse AST properties needed to detect
-/// name conflicts and free variables.
-class StmtAncestorASTVisitor
-    : public clang::RecursiveASTVisitor<StmtAncestorASTVisitor> {
-public:
-  StmtAncestorASTVisitor() { StmtStack.push_back(nullptr); }
-
-  /// \brief Run the analysis on the TranslationUnitDecl.
-  ///
-  /// In case we're running this analysis multiple times, don't repeat the work.
-  void gatherAncestors(const clang::TranslationUnitDecl *T) {
-    if (StmtAncestors.empty())
-      TraverseDecl(const_cast<clang::TranslationUnitDecl *>(T));
-  }
-
-  /// Accessor for StmtAncestors.
-  const StmtParentMap &getStmtToParentStmtMap() { return StmtAncestors; }
-
-  /// Accessor for DeclParents.
-  const DeclParentMap &getDeclToParentStmtMap() { return DeclParents; }
-
-  friend class clang::RecursiveASTVisitor<StmtAncestorASTVisitor>;
-
-private:
-  StmtParentMap StmtAncestors;
-  DeclParentMap DeclParents;
-  llvm::SmallVector<const clang::Stmt *, 16> StmtStack;
-
-  bool TraverseStmt(clang::Stmt *Statement);
-  bool VisitDeclStmt(clang::DeclStmt *Statement);
-};
-
 /// Class used to find the variables and member expressions on which an
 /// arbitrary expression depends.
 class ComponentFinderASTVisitor
@@ -394,14 +362,12 @@ struct TUTrackingInfo {
   /// \brief Reset and initialize per-TU tracking information.
   ///
   /// Must be called before using container accessors.
-  TUTrackingInfo() : ParentFinder(new StmtAncestorASTVisitor) {}
+  TUTrackingInfo() {}
 
-  StmtAncestorASTVisitor &getParentFinder() { return *ParentFinder; }
   StmtGeneratedVarNameMap &getGeneratedDecls() { return GeneratedDecls; }
   ReplacedVarsMap &getReplacedVars() { return ReplacedVars; }
 
 private:
-  std::unique_ptr<StmtAncestorASTVisitor> ParentFinder;
   StmtGeneratedVarNameMap GeneratedDecls;
   ReplacedVarsMap ReplacedVars;
 };
@@ -117,7 +117,7 @@ collectParamDecls(const CXXConstructorDecl *Ctor,
 }
 
 PassByValueCheck::PassByValueCheck(StringRef Name, ClangTidyContext *Context)
-    : ClangTidyCheck(Name, Context),
+    : ClangTidyCheck(Name, Context), Inserter(nullptr),
       IncludeStyle(utils::IncludeSorter::parseIncludeStyle(
           Options.get("IncludeStyle", "llvm"))) {}
 
@@ -163,9 +163,8 @@ void PassByValueCheck::registerPPCallbacks(CompilerInstance &Compiler) {
   // currently does not provide any benefit to other languages, despite being
   // benign.
   if (getLangOpts().CPlusPlus) {
-    Inserter.reset(new utils::IncludeInserter(
-        Compiler.getSourceManager(), Compiler.getLangOpts(), IncludeStyle));
-    Compiler.getPreprocessor().addPPCallbacks(Inserter->CreatePPCallbacks());
+    Inserter =
+        &getSharedState<utils::IncludeInserter>(Compiler, IncludeStyle);
   }
 }
 
@@ -217,7 +216,7 @@ void PassByValueCheck::check(const MatchFinder::MatchResult &Result) {
   if (auto IncludeFixit = Inserter->CreateIncludeInsertion(
           Result.SourceManager->getFileID(Initializer->getSourceLocation()),
           "utility",
-          /*IsAngled=*/true)) {
+          /*IsAngled=*/true, IncludeStyle)) {
     Diag << *IncludeFixit;
   }
 }
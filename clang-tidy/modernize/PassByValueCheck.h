@@ -24,11 +24,12 @@ public:
   PassByValueCheck(StringRef Name, ClangTidyContext *Context);
   void storeOptions(ClangTidyOptions::OptionMap &Opts) override;
   void registerPPCallbacks(clang::CompilerInstance &Compiler) override;
+  bool needsWholePreprocessorStream() const override { return false; }
   void registerMatchers(ast_matchers::MatchFinder *Finder) override;
   void check(const ast_matchers::MatchFinder::MatchResult &Result) override;
 
 private:
-  std::unique_ptr<utils::IncludeInserter> Inserter;
+  utils::IncludeInserter *Inserter;
   const utils::IncludeSorter::IncludeStyle IncludeStyle;
 };
 
@@ -122,12 +122,11 @@ void RedundantVoidArgCheck::removeVoidArgumentTokens(
       CharSourceRange::getTokenRange(Range), *Result.SourceManager,
       Result.Context->getLangOpts());
 
-  std::string DeclText = Lexer::getSourceText(CharRange, *Result.SourceManager,
-                                              Result.Context->getLangOpts())
-                             .str();
-  Lexer PrototypeLexer(CharRange.getBegin(), Result.Context->getLangOpts(),
-                       DeclText.data(), DeclText.data(),
-                       DeclText.data() + DeclText.size());
+  if (CharRange.isInvalid())
+    return;
+
+  const TokenBuffer &Tokens = getTokenBuffer(CharRange.getBegin());
+  ArrayRef<Token> AllTokens = Tokens.tokens();
   enum TokenState {
     NothingYet,
     SawLeftParen,
@@ -135,11 +134,17 @@ void RedundantVoidArgCheck::removeVoidArgumentTokens(
   };
   TokenState State = NothingYet;
   Token VoidToken;
-  Token ProtoToken;
   std::string Diagnostic =
       ("redundant void argument list in " + GrammarLocation).str();
 
-  while (!PrototypeLexer.LexFromRawLexer(ProtoToken)) {
+  for (size_t I = Tokens.findToken(CharRange.getBegin()), E = AllTokens.size();
+       I != E; ++I) {
+    const Token &ProtoToken = AllTokens[I];
+    if (ProtoToken.is(tok::eof) ||
+        !(ProtoToken.getLocation() < CharRange.getEnd()))
+      break;
+    if (ProtoToken.is(tok::comment))
+      continue;
     switch (State) {
     case NothingYet:
       if (ProtoToken.is(tok::TokenKind::l_paren)) {
@@ -165,10 +170,6 @@ void RedundantVoidArgCheck::removeVoidArgumentTokens(
       break;
     }
   }
-
-  if (State == SawVoid && ProtoToken.is(tok::TokenKind::r_paren)) {
-    removeVoidToken(VoidToken, Diagnostic);
-  }
 }
 
 void RedundantVoidArgCheck::removeVoidToken(Token VoidToken,
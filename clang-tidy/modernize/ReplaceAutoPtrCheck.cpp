@@ -188,7 +188,7 @@ static bool checkTokenIsAutoPtr(SourceLocation TokenStart,
 
 ReplaceAutoPtrCheck::ReplaceAutoPtrCheck(StringRef Name,
                                          ClangTidyContext *Context)
-    : ClangTidyCheck(Name, Context),
+    : ClangTidyCheck(Name, Context), Inserter(nullptr),
       IncludeStyle(utils::IncludeSorter::parseIncludeStyle(
           Options.get("IncludeStyle", "llvm"))) {}
 
@@ -212,9 +212,8 @@ void ReplaceAutoPtrCheck::registerPPCallbacks(CompilerInstance &Compiler) {
   // currently does not provide any benefit to other languages, despite being
   // benign.
   if (getLangOpts().CPlusPlus) {
-    Inserter.reset(new utils::IncludeInserter(
-        Compiler.getSourceManager(), Compiler.getLangOpts(), IncludeStyle));
-    Compiler.getPreprocessor().addPPCallbacks(Inserter->CreatePPCallbacks());
+    Inserter =
+        &getSharedState<utils::IncludeInserter>(Compiler, IncludeStyle);
   }
 }
 
@@ -234,7 +233,7 @@ void ReplaceAutoPtrCheck::check(const MatchFinder::MatchResult &Result) {
 
     auto Insertion =
         Inserter->CreateIncludeInsertion(SM.getMainFileID(), "utility",
-                                         /*IsAngled=*/true);
+                                         /*IsAngled=*/true, IncludeStyle);
     if (Insertion.hasValue())
       Diag << Insertion.getValue();
 
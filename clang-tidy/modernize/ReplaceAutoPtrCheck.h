@@ -47,10 +47,11 @@ public:
   void storeOptions(ClangTidyOptions::OptionMap &Opts) override;
   void registerMatchers(ast_matchers::MatchFinder *Finder) override;
   void registerPPCallbacks(CompilerInstance &Compiler) override;
+  bool needsWholePreprocessorStream() const override { return false; }
   void check(const ast_matchers::MatchFinder::MatchResult &Result) override;
 
 private:
-  std::unique_ptr<utils::IncludeInserter> Inserter;
+  utils::IncludeInserter *Inserter;
   const utils::IncludeSorter::IncludeStyle IncludeStyle;
 };
 
@@ -22,6 +22,7 @@ public:
   void storeOptions(ClangTidyOptions::OptionMap &Opts) override;
   void registerMatchers(ast_matchers::MatchFinder *Finder) override;
   void check(const ast_matchers::MatchFinder::MatchResult &Result) override;
+  bool canMatchConcurrently() const override { return true; }
 
 private:
   const std::string NullMacrosStr;
@@ -24,22 +24,20 @@ void UseOverrideCheck::registerMatchers(MatchFinder *Finder) {
     Finder->addMatcher(cxxMethodDecl(isOverride()).bind("method"), this);
 }
 
-// Re-lex the tokens to get precise locations to insert 'override' and remove
+// Collect the tokens to get precise locations to insert 'override' and remove
 // 'virtual'.
 static SmallVector<Token, 16>
-ParseTokens(CharSourceRange Range, const MatchFinder::MatchResult &Result) {
+ParseTokens(CharSourceRange Range, const TokenBuffer &FileTokens,
+            const MatchFinder::MatchResult &Result) {
   const SourceManager &Sources = *Result.SourceManager;
-  std::pair<FileID, unsigned> LocInfo =
-      Sources.getDecomposedLoc(Range.getBegin());
-  StringRef File = Sources.getBufferData(LocInfo.first);
-  const char *TokenBegin = File.data() + LocInfo.second;
-  Lexer RawLexer(Sources.getLocForStartOfFile(LocInfo.first),
-                 Result.Context->getLangOpts(), File.begin(), TokenBegin,
-                 File.end());
+  ArrayRef<Token> AllTokens = FileTokens.tokens();
   SmallVector<Token, 16> Tokens;
-  Token Tok;
-  while (!RawLexer.LexFromRawLexer(Tok)) {
-    if (Tok.is(tok::semi) || Tok.is(tok::l_brace))
+  for (size_t I = FileTokens.findToken(Range.getBegin()), E = AllTokens.size();
+       I != E; ++I) {
+    Token Tok = AllTokens[I];
+    if (Tok.is(tok::comment))
+      continue;
+    if (Tok.is(tok::eof) || Tok.is(tok::semi) || Tok.is(tok::l_brace))
       break;
     if (Sources.isBeforeInTranslationUnit(Range.getEnd(), Tok.getLocation()))
       break;
@@ -112,7 +110,8 @@ void UseOverrideCheck::check(const MatchFinder::MatchResult &Result) {
   // FIXME: Instead of re-lexing and looking for specific macros such as
   // 'ABSTRACT', properly store the location of 'virtual' and '= 0' in each
   // FunctionDecl.
-  SmallVector<Token, 16> Tokens = ParseTokens(FileRange, Result);
+  SmallVector<Token, 16> Tokens =
+      ParseTokens(FileRange, getTokenBuffer(FileRange.getBegin()), Result);
 
   // Add 'override' on inline declarations that don't already have it.
   if (!HasFinal && !HasOverride) {
@@ -66,7 +66,8 @@ bool ForRangeCopyCheck::handleConstValueCopy(const VarDecl &LoopVar,
       diag(LoopVar.getLocation(),
            "the loop variable's type is not a reference type; this creates a "
            "copy in each iteration; consider making this a reference")
-      << utils::fixit::changeVarDeclToReference(LoopVar, Context);
+      << utils::fixit::changeVarDeclToReference(
+             LoopVar, getTokenBuffer(LoopVar.getLocation()));
   if (!LoopVar.getType().isConstQualified())
     Diagnostic << utils::fixit::changeVarDeclToConst(LoopVar);
   return true;
@@ -80,13 +81,14 @@ bool ForRangeCopyCheck::handleCopyIsOnlyConstReferenced(
   if (LoopVar.getType().isConstQualified() || !Expensive || !*Expensive)
     return false;
   if (!utils::decl_ref_expr::isOnlyUsedAsConst(LoopVar, *ForRange.getBody(),
-                                               Context))
+                                               getASTIndex()))
     return false;
   diag(LoopVar.getLocation(),
        "loop variable is copied but only used as const reference; consider "
        "making it a const reference")
       << utils::fixit::changeVarDeclToConst(LoopVar)
-      << utils::fixit::changeVarDeclToReference(LoopVar, Context);
+      << utils::fixit::changeVarDeclToReference(
+             LoopVar, getTokenBuffer(LoopVar.getLocation()));
   return true;
 }
 
@@ -18,9 +18,9 @@ namespace tidy {
 namespace performance {
 namespace {
 
-void recordFixes(const VarDecl &Var, ASTContext &Context,
+void recordFixes(const VarDecl &Var, const TokenBuffer &Tokens,
                  DiagnosticBuilder &Diagnostic) {
-  Diagnostic << utils::fixit::changeVarDeclToReference(Var, Context);
+  Diagnostic << utils::fixit::changeVarDeclToReference(Var, Tokens);
   if (!Var.getType().isLocalConstQualified())
     Diagnostic << utils::fixit::changeVarDeclToConst(Var);
 }
@@ -110,10 +110,10 @@ void UnnecessaryCopyInitialization::handleCopyFromMethodReturn(
     const VarDecl &Var, const Stmt &BlockStmt, bool IssueFix,
     const VarDecl *ObjectArg, ASTContext &Context) {
   bool IsConstQualified = Var.getType().isConstQualified();
-  if (!IsConstQualified && !isOnlyUsedAsConst(Var, BlockStmt, Context))
+  if (!IsConstQualified && !isOnlyUsedAsConst(Var, BlockStmt, getASTIndex()))
     return;
   if (ObjectArg != nullptr &&
-      !isOnlyUsedAsConst(*ObjectArg, BlockStmt, Context))
+      !isOnlyUsedAsConst(*ObjectArg, BlockStmt, getASTIndex()))
     return;
 
   auto Diagnostic =
@@ -126,14 +126,14 @@ void UnnecessaryCopyInitialization::handleCopyFromMethodReturn(
                               "reference; consider making it a const reference")
       << &Var;
   if (IssueFix)
-    recordFixes(Var, Context, Diagnostic);
+    recordFixes(Var, getTokenBuffer(Var.getLocation()), Diagnostic);
 }
 
 void UnnecessaryCopyInitialization::handleCopyFromLocalVar(
     const VarDecl &NewVar, const VarDecl &OldVar, const Stmt &BlockStmt,
     bool IssueFix, ASTContext &Context) {
-  if (!isOnlyUsedAsConst(NewVar, BlockStmt, Context) ||
-      !isOnlyUsedAsConst(OldVar, BlockStmt, Context))
+  if (!isOnlyUsedAsConst(NewVar, BlockStmt, getASTIndex()) ||
+      !isOnlyUsedAsConst(OldVar, BlockStmt, getASTIndex()))
     return;
 
   auto Diagnostic = diag(NewVar.getLocation(),
@@ -141,7 +141,7 @@ void UnnecessaryCopyInitialization::handleCopyFromLocalVar(
                          "consider avoiding the copy")
                     << &NewVar << &OldVar;
   if (IssueFix)
-    recordFixes(NewVar, Context, Diagnostic);
+    recordFixes(NewVar, getTokenBuffer(NewVar.getLocation()), Diagnostic);
 }
 
 } // namespace performance
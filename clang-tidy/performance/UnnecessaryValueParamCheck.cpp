@@ -62,7 +62,7 @@ void UnnecessaryValueParamCheck::check(const MatchFinder::MatchResult &Result) {
   if (!IsConstQualified && (llvm::isa<CXXConstructorDecl>(Function) ||
                             !Function->doesThisDeclarationHaveABody() ||
                             !utils::decl_ref_expr::isOnlyUsedAsConst(
-                                *Param, *Function->getBody(), *Result.Context)))
+                                *Param, *Function->getBody(), getASTIndex())))
     return;
   auto Diag =
       diag(Param->getLocation(),
@@ -79,8 +79,8 @@ void UnnecessaryValueParamCheck::check(const MatchFinder::MatchResult &Result) {
   for (const auto *FunctionDecl = Function; FunctionDecl != nullptr;
        FunctionDecl = FunctionDecl->getPreviousDecl()) {
     const auto &CurrentParam = *FunctionDecl->getParamDecl(Index);
-    Diag << utils::fixit::changeVarDeclToReference(CurrentParam,
-                                                           *Result.Context);
+    Diag << utils::fixit::changeVarDeclToReference(
+        CurrentParam, getTokenBuffer(CurrentParam.getLocation()));
     if (!IsConstQualified)
       Diag << utils::fixit::changeVarDeclToConst(CurrentParam);
   }
@@ -9,61 +9,264 @@
 
 #include "../ClangTidy.h"
 #include "../ClangTidyModule.h"
+#include "../ClangTidyProfiling.h"
 #include "clang/Frontend/CompilerInstance.h"
 #include "clang/Frontend/FrontendPluginRegistry.h"
 #include "clang/Frontend/MultiplexConsumer.h"
+#include "llvm/Support/FileSystem.h"
+#include <tuple>
 
 namespace clang {
 namespace tidy {
 
-/// The core clang tidy plugin action. This just provides the AST consumer and
+namespace {
+/// Options of the plugin that are not part of the \c ClangTidyOptions.
+struct PluginOutputOptions {
+  PluginOutputOptions() : EnableProfile(false), PrintProfile(false) {}
+
+  std::string ExportFixes;
+  bool EnableProfile;
+  bool PrintProfile;
+  std::string ProfileSummary;
+  std::string ProfileTrace;
+};
+
+// Returns the location of Offset in FilePath in the compiler's sources.
+SourceLocation getLocation(SourceManager &Sources, StringRef FilePath,
+                           unsigned Offset) {
+  if (FilePath.empty())
+    return SourceLocation();
+  const FileEntry *File = Sources.getFileManager().getFile(FilePath);
+  if (!File)
+    return SourceLocation();
+  FileID ID = Sources.translateFile(File);
+  if (ID.isInvalid())
+    ID = Sources.createFileID(File, SourceLocation(), SrcMgr::C_User);
+  return Sources.getLocForStartOfFile(ID).getLocWithOffset(Offset);
+}
+
+// Reports Errors like clang-tidy displays them, with their fixes as fix-it
+// hints.
+void reportErrors(CompilerInstance &Compiler, ArrayRef<ClangTidyError> Errors) {
+  DiagnosticsEngine &Diags = Compiler.getDiagnostics();
+  SourceManager &Sources = Compiler.getSourceManager();
+  for (const ClangTidyError &Error : Errors) {
+    auto Level = static_cast<DiagnosticsEngine::Level>(Error.DiagLevel);
+    std::string Name = Error.CheckName.str();
+    if (Error.IsWarningAsError) {
+      Name += ",-warnings-as-errors";
+      Level = DiagnosticsEngine::Error;
+    }
+    {
+      DiagnosticBuilder Diag =
+          Diags.Report(getLocation(Sources, Error.Message.FilePath,
+                                   Error.Message.FileOffset),
+                       Diags.getCustomDiagID(Level, "%0 [%1]"))
+          << Error.Message.Message << Name;
+      for (const tooling::Replacement &Fix : Error.Fix) {
+        if (!Fix.isApplicable())
+          continue;
+        SourceLocation Begin =
+            getLocation(Sources, Fix.getFilePath(), Fix.getOffset());
+        if (Begin.isInvalid())
+          continue;
+        Diag << FixItHint::CreateReplacement(
+            CharSourceRange::getCharRange(
+                Begin, Begin.getLocWithOffset(Fix.getLength())),
+            Fix.getReplacementText());
+      }
+    }
+    for (const ClangTidyMessage &Note : Error.Notes)
+      Diags.Report(getLocation(Sources, Note.FilePath, Note.FileOffset),
+                   Diags.getCustomDiagID(DiagnosticsEngine::Note, "%0"))
+          << Note.Message;
+  }
+}
+} // namespace
+
+/// The core clang tidy plugin action. This provides the AST consumer and
 /// command line flag parsing for using clang-tidy as a clang plugin.
+///
+/// The arguments are passed with -plugin-arg-clang-tidy and have the meaning
+/// of the clang-tidy options of the same name: -checks=, -config=,
+/// -header-filter=, -line-filter=, -system-headers, -warnings-as-errors=,
+/// -export-fixes[=], -enable-check-profile, -profile-summary= and
+/// -profile-trace=. Without a file name, -export-fixes writes the fixes next
+/// to the output file of the compilation.
 class ClangTidyPluginAction : public PluginASTAction {
-  /// Wrapper to grant the context the same lifetime as the action. We use
+  /// Wrapper to grant the context the same lifetime as the AST consumer, as
+  /// the action is destroyed once the consumer is created. We use
   /// MultiplexConsumer to avoid writing out all the forwarding methods.
+  ///
+  /// Diagnostics of the checks are collected and filtered like in clang-tidy,
+  /// and reported to the compiler's diagnostics engine once the translation
+  /// unit is processed.
   class WrapConsumer : public MultiplexConsumer {
+    CompilerInstance &Compiler;
     std::unique_ptr<ClangTidyContext> Context;
+    std::unique_ptr<ClangTidyDiagnosticConsumer> DiagConsumer;
+    /// Owns the checks reused across translation units.
+    std::unique_ptr<ClangTidyASTConsumerFactory> Factory;
+    std::unique_ptr<ProfileData> Profile;
+    PluginOutputOptions Outputs;
 
   public:
-    WrapConsumer(std::unique_ptr<ClangTidyContext> Context,
+    WrapConsumer(CompilerInstance &Compiler,
+                 std::unique_ptr<ClangTidyContext> Context,
+                 std::unique_ptr<ClangTidyDiagnosticConsumer> DiagConsumer,
+                 std::unique_ptr<ClangTidyASTConsumerFactory> Factory,
+                 std::unique_ptr<ProfileData> Profile,
+                 const PluginOutputOptions &Outputs,
                  std::vector<std::unique_ptr<ASTConsumer>> Consumer)
-        : MultiplexConsumer(std::move(Consumer)), Context(std::move(Context)) {}
+        : MultiplexConsumer(std::move(Consumer)), Compiler(Compiler),
+          Context(std::move(Context)), DiagConsumer(std::move(DiagConsumer)),
+          Factory(std::move(Factory)), Profile(std::move(Profile)),
+          Outputs(Outputs) {}
+
+    void HandleTranslationUnit(ASTContext &Ctx) override {
+      MultiplexConsumer::HandleTranslationUnit(Ctx);
+      DiagConsumer->finish();
+      const std::vector<ClangTidyError> &Errors = Context->getErrors();
+      reportErrors(Compiler, Errors);
+
+      if (!Outputs.ExportFixes.empty()) {
+        // Don't leave the fixes of a previous compilation behind.
+        llvm::sys::fs::remove(Outputs.ExportFixes);
+        ReplacementsExportSink Export(Outputs.ExportFixes);
+        Export.handleErrors(Errors);
+        if (!Export.finish())
+          reportOutputError("fixes", Outputs.ExportFixes);
+      }
+
+      if (Profile) {
+        Profile->finishFile();
+        if (Outputs.PrintProfile)
+          printProfileData(*Profile, llvm::errs());
+        if (!Outputs.ProfileSummary.empty() &&
+            !writeProfile(Outputs.ProfileSummary, *Profile,
+                          writeProfileSummary))
+          reportOutputError("profile summary", Outputs.ProfileSummary);
+        if (!Outputs.ProfileTrace.empty() &&
+            !writeProfile(Outputs.ProfileTrace, *Profile, writeProfileTrace))
+          reportOutputError("profile trace", Outputs.ProfileTrace);
+      }
+    }
+
+  private:
+    /// Fails the compilation if an output requested with the plugin arguments
+    /// couldn't be written.
+    void reportOutputError(StringRef Output, StringRef FileName) {
+      DiagnosticsEngine &Diags = Compiler.getDiagnostics();
+      Diags.Report(Diags.getCustomDiagID(DiagnosticsEngine::Error,
+                                         "can't write clang-tidy %0 to '%1'"))
+          << Output << FileName;
+    }
   };
 
 public:
   std::unique_ptr<ASTConsumer> CreateASTConsumer(CompilerInstance &Compiler,
                                                  StringRef File) override {
-    // Insert the current diagnostics engine.
-    Context->setDiagnosticsEngine(&Compiler.getDiagnostics());
+    // The checks report to a separate diagnostics engine, so that their
+    // diagnostics are filtered before they reach the compiler's.
+    auto DiagConsumer =
+        llvm::make_unique<ClangTidyDiagnosticConsumer>(*Context);
+    std::unique_ptr<ProfileData> Profile;
+    if (Outputs.EnableProfile) {
+      Profile = llvm::make_unique<ProfileData>();
+      Context->setCheckProfileData(Profile.get());
+      Profile->startFile(File);
+    }
 
     // Create the AST consumer.
-    ClangTidyASTConsumerFactory Factory(*Context);
+    auto Factory = llvm::make_unique<ClangTidyASTConsumerFactory>(*Context);
     std::vector<std::unique_ptr<ASTConsumer>> Vec;
-    Vec.push_back(Factory.CreateASTConsumer(Compiler, File));
+    Vec.push_back(Factory->CreateASTConsumer(Compiler, File));
 
-    return llvm::make_unique<WrapConsumer>(std::move(Context), std::move(Vec));
+    return llvm::make_unique<WrapConsumer>(
+        Compiler, std::move(Context), std::move(DiagConsumer),
+        std::move(Factory), std::move(Profile), Outputs, std::move(Vec));
   }
 
-  bool ParseArgs(const CompilerInstance &,
+  bool ParseArgs(const CompilerInstance &Compiler,
                  const std::vector<std::string> &Args) override {
+    DiagnosticsEngine &Diags = Compiler.getDiagnostics();
     ClangTidyGlobalOptions GlobalOptions;
     ClangTidyOptions DefaultOptions;
     ClangTidyOptions OverrideOptions;
+    Optional<ClangTidyOptions> Config;
 
-    // Parse the extra command line args.
-    // FIXME: This is very limited at the moment.
-    for (StringRef Arg : Args)
-      if (Arg.startswith("-checks="))
-        OverrideOptions.Checks = Arg.substr(strlen("-checks="));
+    for (StringRef Arg : Args) {
+      StringRef Name, Value;
+      std::tie(Name, Value) = Arg.split('=');
+      bool HasValue = Arg.size() > Name.size();
+      std::error_code EC;
+      if (Name == "-checks" && HasValue) {
+        OverrideOptions.Checks = Value;
+      } else if (Name == "-header-filter" && HasValue) {
+        OverrideOptions.HeaderFilterRegex = Value;
+      } else if (Name == "-warnings-as-errors" && HasValue) {
+        OverrideOptions.WarningsAsErrors = Value;
+      } else if (Arg == "-system-headers") {
+        OverrideOptions.SystemHeaders = true;
+      } else if (Name == "-line-filter" && HasValue) {
+        EC = parseLineFilter(Value, GlobalOptions);
+      } else if (Name == "-config" && HasValue) {
+        llvm::ErrorOr<ClangTidyOptions> Parsed = parseConfiguration(Value);
+        if (Parsed)
+          Config = *Parsed;
+        else
+          EC = Parsed.getError();
+      } else if (Name == "-export-fixes") {
+        Outputs.ExportFixes = HasValue ? Value.str() : getSidecarPath(Compiler);
+      } else if (Arg == "-enable-check-profile") {
+        Outputs.EnableProfile = Outputs.PrintProfile = true;
+      } else if (Name == "-profile-summary" && HasValue) {
+        Outputs.EnableProfile = true;
+        Outputs.ProfileSummary = Value;
+      } else if (Name == "-profile-trace" && HasValue) {
+        Outputs.EnableProfile = true;
+        Outputs.ProfileTrace = Value;
+      } else {
+        Diags.Report(Diags.getCustomDiagID(DiagnosticsEngine::Error,
+                                           "unknown clang-tidy argument '%0'"))
+            << Arg;
+        return false;
+      }
+      if (EC) {
+        Diags.Report(Diags.getCustomDiagID(
+            DiagnosticsEngine::Error, "invalid clang-tidy argument '%0': %1"))
+            << Arg << EC.message();
+        return false;
+      }
+    }
 
-    auto Options = llvm::make_unique<FileOptionsProvider>(
-        GlobalOptions, DefaultOptions, OverrideOptions);
+    std::unique_ptr<ClangTidyOptionsProvider> Options;
+    if (Config)
+      Options = llvm::make_unique<ConfigOptionsProvider>(
+          GlobalOptions,
+          ClangTidyOptions::getDefaults().mergeWith(DefaultOptions), *Config,
+          OverrideOptions);
+    else
+      Options = llvm::make_unique<FileOptionsProvider>(
+          GlobalOptions, DefaultOptions, OverrideOptions);
     Context = llvm::make_unique<ClangTidyContext>(std::move(Options));
     return true;
   }
 
 private:
+  // Returns the file to export fixes to if no file name is given: the output
+  // file of the compilation, or the main file if there is none, with a
+  // ".clang-tidy.yaml" suffix.
+  static std::string getSidecarPath(const CompilerInstance &Compiler) {
+    const FrontendOptions &Opts = Compiler.getFrontendOpts();
+    std::string Path = Opts.OutputFile;
+    if ((Path.empty() || Path == "-") && !Opts.Inputs.empty())
+      Path = Opts.Inputs[0].getFile();
+    return Path + ".clang-tidy.yaml";
+  }
+
   std::unique_ptr<ClangTidyContext> Context;
+  PluginOutputOptions Outputs;
 };
 } // namespace tidy
 } // namespace clang
@@ -37,29 +37,16 @@ void AvoidConstParamsInDecls::registerMatchers(MatchFinder *Finder) {
                      this);
 }
 
-// Re-lex the tokens to get precise location of last 'const'
-static Token ConstTok(CharSourceRange Range,
-                      const MatchFinder::MatchResult &Result) {
-  const SourceManager &Sources = *Result.SourceManager;
-  std::pair<FileID, unsigned> LocInfo =
-      Sources.getDecomposedLoc(Range.getBegin());
-  StringRef File = Sources.getBufferData(LocInfo.first);
-  const char *TokenBegin = File.data() + LocInfo.second;
-  Lexer RawLexer(Sources.getLocForStartOfFile(LocInfo.first),
-                 Result.Context->getLangOpts(), File.begin(), TokenBegin,
-                 File.end());
-  Token Tok;
+// Look up the tokens to get precise location of last 'const'
+static Token ConstTok(CharSourceRange Range, const TokenBuffer &Tokens) {
+  ArrayRef<Token> AllTokens = Tokens.tokens();
   Token ConstTok;
-  while (!RawLexer.LexFromRawLexer(Tok)) {
-    if (Sources.isBeforeInTranslationUnit(Range.getEnd(), Tok.getLocation()))
+  for (size_t I = Tokens.findToken(Range.getBegin()), E = AllTokens.size();
+       I != E; ++I) {
+    const Token &Tok = AllTokens[I];
+    if (Tok.is(tok::eof) || Range.getEnd() < Tok.getLocation())
       break;
-    if (Tok.is(tok::raw_identifier)) {
-      IdentifierInfo &Info = Result.Context->Idents.get(StringRef(
-          Sources.getCharacterData(Tok.getLocation()), Tok.getLength()));
-      Tok.setIdentifierInfo(&Info);
-      Tok.setKind(Info.getTokenID());
-    }
-    if (Tok.is(tok::kw_const))
+    if (Tok.is(tok::raw_identifier) && Tok.getRawIdentifier() == "const")
       ConstTok = Tok;
   }
   return ConstTok;
@@ -94,7 +81,7 @@ void AvoidConstParamsInDecls::check(const MatchFinder::MatchResult &Result) {
   if (!FileRange.isValid())
     return;
 
-  Token Tok = ConstTok(FileRange, Result);
+  Token Tok = ConstTok(FileRange, getTokenBuffer(FileRange.getBegin()));
   Diag << FixItHint::CreateRemoval(
       CharSourceRange::getTokenRange(Tok.getLocation(), Tok.getLocation()));
 }
@@ -8,6 +8,7 @@
 //===----------------------------------------------------------------------===//
 
 #include "BracesAroundStatementsCheck.h"
+#include "../utils/LexerUtils.h"
 #include "clang/AST/ASTContext.h"
 #include "clang/ASTMatchers/ASTMatchers.h"
 #include "clang/Lex/Lexer.h"
@@ -19,62 +20,58 @@ namespace tidy {
 namespace readability {
 namespace {
 
-tok::TokenKind getTokenKind(SourceLocation Loc, const SourceManager &SM,
-                            const ASTContext *Context) {
-  Token Tok;
-  SourceLocation Beginning =
-      Lexer::GetBeginningOfToken(Loc, SM, Context->getLangOpts());
-  const bool Invalid =
-      Lexer::getRawToken(Beginning, Tok, SM, Context->getLangOpts());
-  assert(!Invalid && "Expected a valid token.");
+tok::TokenKind getTokenKind(SourceLocation Loc, const TokenBuffer &Tokens) {
+  const Token *Tok = Tokens.getTokenAt(Loc);
+  assert(Tok && "Expected a valid token.");
 
-  if (Invalid)
+  if (!Tok)
     return tok::NUM_TOKENS;
 
-  return Tok.getKind();
+  return Tok->getKind();
 }
 
 SourceLocation forwardSkipWhitespaceAndComments(SourceLocation Loc,
                                                 const SourceManager &SM,
-                                                const ASTContext *Context) {
+                                                const TokenBuffer &Tokens) {
   assert(Loc.isValid());
   for (;;) {
     while (isWhitespace(*FullSourceLoc(Loc, SM).getCharacterData()))
       Loc = Loc.getLocWithOffset(1);
 
-    tok::TokenKind TokKind = getTokenKind(Loc, SM, Context);
+    tok::TokenKind TokKind = getTokenKind(Loc, Tokens);
     if (TokKind == tok::NUM_TOKENS || TokKind != tok::comment)
       return Loc;
 
     // Fast-forward current token.
-    Loc = Lexer::getLocForEndOfToken(Loc, 0, SM, Context->getLangOpts());
+    Loc = utils::lexer::getLocForEndOfToken(Tokens, Loc);
   }
 }
 
 SourceLocation findEndLocation(SourceLocation LastTokenLoc,
                                const SourceManager &SM,
-                               const ASTContext *Context) {
+                               const TokenBuffer &Tokens) {
   SourceLocation Loc = LastTokenLoc;
   // Loc points to the beginning of the last (non-comment non-ws) token
   // before end or ';'.
   assert(Loc.isValid());
   bool SkipEndWhitespaceAndComments = true;
-  tok::TokenKind TokKind = getTokenKind(Loc, SM, Context);
-  if (TokKind == tok::NUM_TOKENS || TokKind == tok::semi ||
-      TokKind == tok::r_brace) {
+  tok::TokenKind TokKind = getTokenKind(Loc, Tokens);
+  if (TokKind == tok::NUM_TOKENS)
+    return SourceLocation();
+  if (TokKind == tok::semi || TokKind == tok::r_brace) {
     // If we are at ";" or "}", we found the last token. We could use as well
     // `if (isa<NullStmt>(S))`, but it wouldn't work for nested statements.
     SkipEndWhitespaceAndComments = false;
   }
 
-  Loc = Lexer::getLocForEndOfToken(Loc, 0, SM, Context->getLangOpts());
+  Loc = utils::lexer::getLocForEndOfToken(Tokens, Loc);
   // Loc points past the last token before end or after ';'.
 
   if (SkipEndWhitespaceAndComments) {
-    Loc = forwardSkipWhitespaceAndComments(Loc, SM, Context);
-    tok::TokenKind TokKind = getTokenKind(Loc, SM, Context);
+    Loc = forwardSkipWhitespaceAndComments(Loc, SM, Tokens);
+    tok::TokenKind TokKind = getTokenKind(Loc, Tokens);
     if (TokKind == tok::semi)
-      Loc = Lexer::getLocForEndOfToken(Loc, 0, SM, Context->getLangOpts());
+      Loc = utils::lexer::getLocForEndOfToken(Tokens, Loc);
   }
 
   for (;;) {
@@ -86,17 +83,13 @@ SourceLocation findEndLocation(SourceLocation LastTokenLoc,
       // EOL, insert brace before.
       break;
     }
-    tok::TokenKind TokKind = getTokenKind(Loc, SM, Context);
-    if (TokKind != tok::comment) {
+    const Token *Tok = Tokens.getTokenAt(Loc);
+    if (!Tok || Tok->isNot(tok::comment)) {
       // Non-comment token, insert brace before.
       break;
     }
 
-    SourceLocation TokEndLoc =
-        Lexer::getLocForEndOfToken(Loc, 0, SM, Context->getLangOpts());
-    SourceRange TokRange(Loc, TokEndLoc);
-    StringRef Comment = Lexer::getSourceText(
-        CharSourceRange::getTokenRange(TokRange), SM, Context->getLangOpts());
+    StringRef Comment = utils::lexer::getTokenText(*Tok, SM);
     if (Comment.startswith("/*") && Comment.find('\n') != StringRef::npos) {
       // Multi-line block comment, insert brace before.
       break;
@@ -104,7 +97,7 @@ SourceLocation findEndLocation(SourceLocation LastTokenLoc,
     // else: Trailing comment, insert brace after the newline.
 
     // Fast-forward current token.
-    Loc = TokEndLoc;
+    Loc = Tok->getLocation().getLocWithOffset(Tok->getLength());
   }
   return Loc;
 }
@@ -188,11 +181,12 @@ BracesAroundStatementsCheck::findRParenLoc(const IfOrWhileStmt *S,
       Lexer::getLocForEndOfToken(CondEndLoc, 0, SM, Context->getLangOpts());
   if (PastCondEndLoc.isInvalid())
     return SourceLocation();
+  const TokenBuffer &Tokens = getTokenBuffer(PastCondEndLoc);
   SourceLocation RParenLoc =
-      forwardSkipWhitespaceAndComments(PastCondEndLoc, SM, Context);
+      forwardSkipWhitespaceAndComments(PastCondEndLoc, SM, Tokens);
   if (RParenLoc.isInvalid())
     return SourceLocation();
-  tok::TokenKind TokKind = getTokenKind(RParenLoc, SM, Context);
+  tok::TokenKind TokKind = getTokenKind(RParenLoc, Tokens);
   if (TokKind != tok::r_paren)
     return SourceLocation();
   return RParenLoc;
@@ -228,16 +222,19 @@ bool BracesAroundStatementsCheck::checkStmt(
     return false;
 
   // Convert InitialLoc to file location, if it's on the same macro expansion
-  // level as the start of the statement. We also need file locations for
-  // Lexer::getLocForEndOfToken working properly.
+  // level as the start of the statement. We also need file locations to look
+  // up tokens in the token buffer.
   InitialLoc = Lexer::makeFileCharRange(
                    CharSourceRange::getCharRange(InitialLoc, S->getLocStart()),
                    SM, Context->getLangOpts())
                    .getBegin();
   if (InitialLoc.isInvalid())
     return false;
+  const TokenBuffer &Tokens = getTokenBuffer(InitialLoc);
   SourceLocation StartLoc =
-      Lexer::getLocForEndOfToken(InitialLoc, 0, SM, Context->getLangOpts());
+      utils::lexer::getLocForEndOfToken(Tokens, InitialLoc);
+  if (StartLoc.isInvalid())
+    return false;
 
   // StartLoc points at the location of the opening brace to be inserted.
   SourceLocation EndLoc;
@@ -247,12 +244,12 @@ bool BracesAroundStatementsCheck::checkStmt(
     ClosingInsertion = "} ";
   } else {
     const auto FREnd = FileRange.getEnd().getLocWithOffset(-1);
-    EndLoc = findEndLocation(FREnd, SM, Context);
+    EndLoc = findEndLocation(FREnd, SM, getTokenBuffer(FREnd));
     ClosingInsertion = "\n}";
   }
 
-  assert(StartLoc.isValid());
-  assert(EndLoc.isValid());
+  if (EndLoc.isInvalid())
+    return false;
   // Don't require braces for statements spanning less than certain number of
   // lines.
   if (ShortStatementLines && !ForceBracesStmts.erase(S)) {
@@ -518,6 +518,10 @@ static void addUsage(IdentifierNamingCheck::NamingCheckFailureMap &Failures,
                       !Range.getEnd().isMacroID();
 }
 
+void IdentifierNamingCheck::onStartOfTranslationUnit() {
+  NamingCheckFailures.clear();
+}
+
 void IdentifierNamingCheck::check(const MatchFinder::MatchResult &Result) {
   if (const auto *Decl =
           Result.Nodes.getNodeAs<CXXConstructorDecl>("classRef")) {
@@ -36,7 +36,9 @@ public:
   void storeOptions(ClangTidyOptions::OptionMap &Opts) override;
   void registerMatchers(ast_matchers::MatchFinder *Finder) override;
   void check(const ast_matchers::MatchFinder::MatchResult &Result) override;
+  void onStartOfTranslationUnit() override;
   void onEndOfTranslationUnit() override;
+  bool requiresWholeTranslationUnit() const override { return true; }
 
   enum CaseType {
     CT_AnyCase = 0,
@@ -285,6 +285,10 @@ void InconsistentDeclarationParameterNameCheck::registerMatchers(
                      this);
 }
 
+void InconsistentDeclarationParameterNameCheck::onStartOfTranslationUnit() {
+  VisitedDeclarations.clear();
+}
+
 void InconsistentDeclarationParameterNameCheck::check(
     const MatchFinder::MatchResult &Result) {
   const auto *OriginalDeclaration =
@@ -31,6 +31,7 @@ public:
 
   void registerMatchers(ast_matchers::MatchFinder *Finder) override;
   void check(const ast_matchers::MatchFinder::MatchResult &Result) override;
+  void onStartOfTranslationUnit() override;
 
 private:
   void markRedeclarationsAsVisited(const FunctionDecl *FunctionDeclaration);
@@ -16,8 +16,17 @@
 //===----------------------------------------------------------------------===//
 
 #include "../ClangTidy.h"
+#include "../ClangTidyHistory.h"
+#include "../ClangTidyProfiling.h"
 #include "clang/Tooling/CommonOptionsParser.h"
+#include "llvm/Support/FileUtilities.h"
 #include "llvm/Support/Process.h"
+#include "llvm/Support/Program.h"
+#include "llvm/Support/Regex.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/YAMLParser.h"
+#include <iostream>
+#include <tuple>
 
 using namespace clang::ast_matchers;
 using namespace clang::driver;
@@ -107,6 +116,36 @@ JSON array of objects:
 )"),
                cl::init(""), cl::cat(ClangTidyCategory));
 
+static cl::opt<std::string> Diff("diff", cl::desc(R"(
+Unified diff to take the changed lines from,
+or '-' to read it from stdin. Only translation
+units affected by the diff are analyzed, and
+only warnings in changed lines are displayed.
+Without source files, all files from the
+compilation database are considered. Can't be
+used together with -line-filter.
+)"),
+                                 cl::value_desc("filename"),
+                                 cl::cat(ClangTidyCategory));
+
+static cl::opt<std::string> DiffRevisions("diff-revisions", cl::desc(R"(
+Like -diff, but takes the changes from
+'git diff <revisions>' run in the current
+directory, e.g. -diff-revisions=HEAD~1 or
+-diff-revisions=origin/master...HEAD.
+)"),
+                                          cl::value_desc("revisions"),
+                                          cl::cat(ClangTidyCategory));
+
+static cl::opt<unsigned> DiffStrip("diff-strip", cl::desc(R"(
+Number of leading path components to strip
+from the file names in the -diff input, like
+'patch -p'. The default removes the a/ and b/
+prefixes used by git. Can't be used together
+with -diff-revisions.
+)"),
+                                   cl::init(1), cl::cat(ClangTidyCategory));
+
 static cl::opt<bool> Fix("fix", cl::desc(R"(
 Apply suggested fixes. Without -fix-errors
 clang-tidy will bail out if any compilation
@@ -164,6 +203,25 @@ report to stderr.
                                         cl::init(false),
                                         cl::cat(ClangTidyCategory));
 
+static cl::opt<std::string> ProfileTrace("profile-trace", cl::desc(R"(
+Profile the run and write the time spent in each
+file, in each phase of processing it (parsing,
+matching, static analyzer, diagnostics), and in
+each check to <filename>, in the Chrome trace
+event format (see chrome://tracing).
+)"),
+                                         cl::value_desc("filename"),
+                                         cl::cat(ClangTidyCategory));
+
+static cl::opt<std::string> ProfileSummary("profile-summary", cl::desc(R"(
+Profile the run and write a YAML summary of the
+time spent in each check and phase, over all
+files and for each file, and the memory used
+for the AST of each file to <filename>.
+)"),
+                                           cl::value_desc("filename"),
+                                           cl::cat(ClangTidyCategory));
+
 static cl::opt<bool> AnalyzeTemporaryDtors("analyze-temporary-dtors",
                                            cl::desc(R"(
 Enable temporary destructor-aware analysis in
@@ -182,6 +240,138 @@ code with clang-apply-replacements.
                                         cl::value_desc("filename"),
                                         cl::cat(ClangTidyCategory));
 
+static cl::opt<unsigned> Jobs("j", cl::desc(R"(
+Number of translation units to process in
+parallel. Each one uses a separate thread.
+The output is the same as with -j=1. Use -j=0
+to use all available hardware threads.
+)"),
+                              cl::init(1), cl::cat(ClangTidyCategory));
+
+static cl::opt<unsigned> MatchThreads("match-threads", cl::desc(R"(
+Number of threads running the matchers of each
+translation unit. The checks are split into as
+many groups, and the matches found are checked
+on the main thread. Only checks whose matchers
+are known to be thread-safe are split; the
+others are matched on the main thread. The output
+is the same as with -match-threads=1. Use 0 to
+use all available hardware threads.
+)"),
+                                      cl::init(1),
+                                      cl::cat(ClangTidyCategory));
+
+static cl::opt<std::string> CacheDirectory("cache-directory", cl::desc(R"(
+Directory to cache the results of each
+translation unit in. Translation units whose
+compile command, configuration and included
+files haven't changed since they were cached
+are not analyzed again. The directory can be
+shared by concurrently running clang-tidy
+processes.
+)"),
+                                           cl::value_desc("directory"),
+                                           cl::cat(ClangTidyCategory));
+
+static cl::opt<bool> AnalyzeHeadersOnce("analyze-headers-once", cl::desc(R"(
+Analyze each header only in the first
+translation unit that includes it with the
+same checks and options. Checks
+that need to see the whole translation unit
+still analyze all headers. Assumes that a
+header with the same contents produces the
+same diagnostics in all translation units.
+)"),
+                                        cl::init(false),
+                                        cl::cat(ClangTidyCategory));
+
+static cl::opt<bool> PruneFilteredCode("prune-filtered-code", cl::desc(R"(
+Don't run checks on code whose diagnostics
+would be filtered out by -header-filter,
+-system-headers or -line-filter. Warnings in
+such code are then not counted as suppressed.
+Checks that need to see the whole translation
+unit still analyze all code. The static
+analyzer only starts from functions in code
+that is not filtered out; the check option
+clang-analyzer-user-code-roots overrides this.
+)"),
+                                       cl::init(false),
+                                       cl::cat(ClangTidyCategory));
+
+static cl::opt<double> TranslationUnitTimeBudget("tu-time-budget",
+                                                 cl::desc(R"(
+Stop running checks on a translation unit after
+this many seconds, and run the static analyzer
+with reduced limits once half of them are spent.
+Each time a budget is exceeded, a
+'clang-tidy-budget' warning is emitted.
+0 means no limit.
+)"),
+                                                 cl::init(0),
+                                                 cl::value_desc("seconds"),
+                                                 cl::cat(ClangTidyCategory));
+
+static cl::opt<double> CheckTimeBudget("check-time-budget", cl::desc(R"(
+Disable a check for the rest of a translation
+unit once it has spent this many seconds on it.
+The static analyzer is only limited by
+-tu-time-budget. 0 means no limit.
+)"),
+                                       cl::init(0), cl::value_desc("seconds"),
+                                       cl::cat(ClangTidyCategory));
+
+static cl::opt<std::string> HistoryFile("history-file", cl::desc(R"(
+File to record the time and memory used for
+each source file in. Parallel runs start the
+files that took longest first, and -shard
+splits the files by their recorded time.
+Created if it doesn't exist.
+)"),
+                                        cl::value_desc("filename"),
+                                        cl::cat(ClangTidyCategory));
+
+static cl::opt<unsigned> MemoryLimit("memory-limit", cl::desc(R"(
+Don't start a source file while the memory
+recorded in -history-file for it and the
+files already being processed exceeds this
+many megabytes. Only the memory used for
+ASTs and source files is counted. 0 means no
+limit.
+)"),
+                                     cl::init(0), cl::value_desc("MB"),
+                                     cl::cat(ClangTidyCategory));
+
+static cl::opt<std::string> Shard("shard", cl::desc(R"(
+Only process part i (counted from zero) of the
+source files split into n parts, written as
+-shard=i/n. The parts have about the same
+total time recorded in -history-file, and
+together cover all files if all shards use the
+same files and the same history file. Without
+source files, all files of the compilation
+database are split.
+)"),
+                                  cl::value_desc("i/n"),
+                                  cl::cat(ClangTidyCategory));
+
+static cl::opt<bool> Server("server", cl::desc(R"(
+Run as a server for editors and other tools that
+lint files repeatedly. Requests are read from
+stdin, one JSON object per line, with the fields
+"id", "file", and optionally "content" (used
+instead of the file on disk) and "checks"
+(appended to the configured checks). For each
+request a JSON object with its "id" and the
+"diagnostics", or an "error", is written to a
+line of stdout. Configuration files and file
+system lookups are cached between requests.
+At the end of the input, the number of compile
+commands parsed with a precompiled preamble is
+written to stderr.
+)"),
+                            cl::init(false), cl::cat(ClangTidyCategory));
+
 namespace clang {
 namespace tidy {
 
@@ -211,47 +401,312 @@ static void printStats(const ClangTidyStats &Stats) {
                       "non-system headers. Use -system-headers to display "
                       "errors from system headers as well.\n";
   }
+  if (Stats.TimeBudgetsExceeded)
+    llvm::errs() << Stats.TimeBudgetsExceeded
+                 << " time budgets exceeded, results may be incomplete.\n";
+  if (Stats.CacheHits || Stats.CacheMisses)
+    llvm::errs() << "Reused cached results for " << Stats.CacheHits << " of "
+                 << Stats.CacheHits + Stats.CacheMisses
+                 << " compile commands.\n";
 }
 
-static void printProfileData(const ProfileData &Profile,
-                             llvm::raw_ostream &OS) {
-  // Time is first to allow for sorting by it.
-  std::vector<std::pair<llvm::TimeRecord, StringRef>> Timers;
-  TimeRecord Total;
+static bool isDiffMode() { return !Diff.empty() || !DiffRevisions.empty(); }
+
+// Runs 'git diff' on Revisions and stores its output in Text.
+static bool runGitDiff(StringRef Revisions, std::string &Text) {
+  llvm::ErrorOr<std::string> Git = llvm::sys::findProgramByName("git");
+  if (!Git) {
+    llvm::errs() << "Error: can't find git: " << Git.getError().message()
+                 << "\n";
+    return false;
+  }
+  SmallString<128> OutputPath;
+  if (std::error_code EC = llvm::sys::fs::createTemporaryFile(
+          "clang-tidy-diff", "diff", OutputPath)) {
+    llvm::errs() << "Error: can't create temporary file: " << EC.message()
+                 << "\n";
+    return false;
+  }
+  llvm::FileRemover OutputRemover(OutputPath);
+
+  std::string RevisionsArg = Revisions;
+  // Don't depend on the user's git configuration for the output format.
+  const char *Args[] = {"git",
+                        "diff",
+                        "-U0",
+                        "--no-color",
+                        "--no-ext-diff",
+                        "--src-prefix=a/",
+                        "--dst-prefix=b/",
+                        RevisionsArg.c_str(),
+                        "--",
+                        nullptr};
+  StringRef Output = OutputPath;
+  const StringRef *Redirects[] = {nullptr, &Output, nullptr};
+  std::string ErrorMessage;
+  int Result = llvm::sys::ExecuteAndWait(*Git, Args, /*env=*/nullptr,
+                                         Redirects, /*secondsToWait=*/0,
+                                         /*memoryLimit=*/0, &ErrorMessage);
+  if (Result != 0) {
+    llvm::errs() << "Error: 'git diff " << Revisions << "' failed";
+    if (!ErrorMessage.empty())
+      llvm::errs() << ": " << ErrorMessage;
+    llvm::errs() << "\n";
+    return false;
+  }
 
-  for (const auto& P : Profile.Records) {
-    Timers.emplace_back(P.getValue(), P.getKey());
-    Total += P.getValue();
+  llvm::ErrorOr<std::unique_ptr<MemoryBuffer>> Buffer =
+      MemoryBuffer::getFile(OutputPath);
+  if (!Buffer) {
+    llvm::errs() << "Error: can't read output of git: "
+                 << Buffer.getError().message() << "\n";
+    return false;
   }
+  Text = (*Buffer)->getBuffer();
+  return true;
+}
 
-  std::sort(Timers.begin(), Timers.end());
+static bool parseDiff(ClangTidyGlobalOptions &GlobalOptions) {
+  if (!LineFilter.empty()) {
+    llvm::errs() << "Error: -line-filter can't be used together with -diff or "
+                    "-diff-revisions.\n";
+    return false;
+  }
+  if (!Diff.empty() && !DiffRevisions.empty()) {
+    llvm::errs() << "Error: -diff and -diff-revisions are mutually "
+                    "exclusive.\n";
+    return false;
+  }
+  // The prefixes of the file names written by git are set by runGitDiff.
+  if (!DiffRevisions.empty() && DiffStrip.getNumOccurrences()) {
+    llvm::errs() << "Error: -diff-strip can't be used together with "
+                    "-diff-revisions.\n";
+    return false;
+  }
 
-  std::string Line = "===" + std::string(73, '-') + "===\n";
-  OS << Line;
+  std::string Text;
+  unsigned StripComponents = DiffStrip;
+  if (!Diff.empty()) {
+    llvm::ErrorOr<std::unique_ptr<MemoryBuffer>> Buffer =
+        MemoryBuffer::getFileOrSTDIN(Diff);
+    if (!Buffer) {
+      llvm::errs() << "Error: can't read " << Diff << ": "
+                   << Buffer.getError().message() << "\n";
+      return false;
+    }
+    Text = (*Buffer)->getBuffer();
+  } else {
+    if (!runGitDiff(DiffRevisions, Text))
+      return false;
+    StripComponents = 1;
+  }
 
-  if (Total.getUserTime())
-    OS << "   ---User Time---";
-  if (Total.getSystemTime())
-    OS << "   --System Time--";
-  if (Total.getProcessTime())
-    OS << "   --User+System--";
-  OS << "   ---Wall Time---";
-  if (Total.getMemUsed())
-    OS << "  ---Mem---";
-  OS << "  --- Name ---\n";
+  if (std::error_code Err =
+          parseUnifiedDiff(Text, StripComponents, GlobalOptions)) {
+    llvm::errs() << "Error: invalid diff: " << Err.message() << "\n";
+    return false;
+  }
+  return true;
+}
 
-  // Loop through all of the timing data, printing it out.
-  for (auto I = Timers.rbegin(), E = Timers.rend(); I != E; ++I) {
-    I->first.print(Total, OS);
-    OS << I->second << '\n';
+// Returns the value of the -p option of CommonOptionsParser, which it doesn't
+// expose, from the arguments before "--".
+static std::string getBuildPath(int argc, const char **argv) {
+  std::string BuildPath;
+  for (int I = 1; I < argc; ++I) {
+    StringRef Arg = argv[I];
+    if (Arg == "--")
+      break;
+    if (Arg.startswith("--"))
+      Arg = Arg.drop_front();
+    if (Arg == "-p" && I + 1 < argc)
+      BuildPath = argv[++I];
+    else if (Arg.startswith("-p="))
+      BuildPath = Arg.drop_front(3);
   }
+  return BuildPath;
+}
 
-  Total.print(Total, OS);
-  OS << "Total\n";
-  OS << Line << "\n";
+// CommonOptionsParser doesn't load a compilation database if no source files
+// are given, so do that for the files affected by a diff and for -server.
+static std::unique_ptr<CompilationDatabase>
+detectCompilationDatabase(std::string BuildPath) {
+  if (BuildPath.empty()) {
+    SmallString<256> CurrentDirectory;
+    if (std::error_code EC = llvm::sys::fs::current_path(CurrentDirectory)) {
+      llvm::errs() << "Error: can't get current directory: " << EC.message()
+                   << "\n";
+      return nullptr;
+    }
+    BuildPath = CurrentDirectory.str();
+  }
+
+  std::string ErrorMessage;
+  std::unique_ptr<CompilationDatabase> Compilations =
+      CompilationDatabase::autoDetectFromDirectory(BuildPath, ErrorMessage);
+  if (!Compilations)
+    llvm::errs() << "Error while trying to load a compilation database:\n"
+                 << ErrorMessage << "\n";
+  return Compilations;
+}
+
+/// \brief A request to the -server loop.
+struct ServerRequest {
+  ServerRequest() : ID("null"), IDIsString(false) {}
+
+  /// \brief The value of the "id" field, returned in the response. A number
+  /// or \c null is kept as written.
+  std::string ID;
+  bool IDIsString;
+  std::string File;
+  llvm::Optional<std::string> Content;
+  llvm::Optional<std::string> Checks;
+};
+
+// Parses a request from a line of JSON. Returns false and sets Error if the
+// request is invalid.
+static bool parseServerRequest(StringRef Line, ServerRequest &Request,
+                               std::string &Error) {
+  llvm::SourceMgr SM;
+  // Errors are reported in the response.
+  SM.setDiagHandler([](const llvm::SMDiagnostic &, void *) {});
+  llvm::yaml::Stream Stream(Line, SM);
+  llvm::yaml::document_iterator Document = Stream.begin();
+  auto *Root = Document == Stream.end()
+                   ? nullptr
+                   : dyn_cast_or_null<llvm::yaml::MappingNode>(
+                         Document->getRoot());
+  if (!Root) {
+    Error = "request is not a JSON object";
+    return false;
+  }
+  for (llvm::yaml::KeyValueNode &Field : *Root) {
+    auto *Key = dyn_cast_or_null<llvm::yaml::ScalarNode>(Field.getKey());
+    auto *Value = dyn_cast_or_null<llvm::yaml::ScalarNode>(Field.getValue());
+    if (!Key || !Value) {
+      Error = "request fields must be strings or numbers";
+      return false;
+    }
+    SmallString<16> KeyStorage;
+    SmallString<256> ValueStorage;
+    StringRef Name = Key->getValue(KeyStorage);
+    if (Name == "id") {
+      Request.ID = Value->getValue(ValueStorage).str();
+      StringRef Raw = Value->getRawValue();
+      Request.IDIsString = Raw.startswith("\"") || Raw.startswith("'");
+      if (!Request.IDIsString && Request.ID != "null" &&
+          !llvm::Regex("^-?(0|[1-9][0-9]*)(\\.[0-9]+)?([eE][-+]?[0-9]+)?$")
+               .match(Request.ID)) {
+        Request.ID = "null";
+        Error = "request \"id\" must be a string or a number";
+        return false;
+      }
+    } else if (Name == "file") {
+      Request.File = Value->getValue(ValueStorage).str();
+    } else if (Name == "content") {
+      Request.Content = Value->getValue(ValueStorage).str();
+    } else if (Name == "checks") {
+      Request.Checks = Value->getValue(ValueStorage).str();
+    }
+  }
+  if (Stream.failed()) {
+    Error = "invalid JSON";
+    return false;
+  }
+  if (Request.File.empty()) {
+    Error = "no \"file\" given";
+    return false;
+  }
+  return true;
+}
+
+static void writeJSONMessage(const ClangTidyMessage &Message,
+                             raw_ostream &OS) {
+  OS << "\"message\":";
+  writeJSONString(Message.Message, OS);
+  OS << ",\"file\":";
+  writeJSONString(Message.FilePath, OS);
+  OS << ",\"offset\":" << Message.FileOffset;
+}
+
+static void writeServerResponse(const ServerRequest &Request,
+                                ArrayRef<ClangTidyError> Errors,
+                                StringRef Error, raw_ostream &OS) {
+  OS << "{\"id\":";
+  if (Request.IDIsString)
+    writeJSONString(Request.ID, OS);
+  else
+    OS << Request.ID;
+  if (!Error.empty()) {
+    OS << ",\"error\":";
+    writeJSONString(Error, OS);
+  }
+  OS << ",\"diagnostics\":[";
+  for (const ClangTidyError &Diag : Errors) {
+    if (&Diag != Errors.begin())
+      OS << ",";
+    OS << "{\"check\":";
+    writeJSONString(Diag.CheckName, OS);
+    OS << ",\"level\":"
+       << (Diag.DiagLevel == ClangTidyError::Error || Diag.IsWarningAsError
+               ? "\"error\""
+               : "\"warning\"")
+       << ",";
+    writeJSONMessage(Diag.Message, OS);
+    OS << ",\"notes\":[";
+    for (const ClangTidyMessage &Note : Diag.Notes) {
+      if (&Note != Diag.Notes.begin())
+        OS << ",";
+      OS << "{";
+      writeJSONMessage(Note, OS);
+      OS << "}";
+    }
+    OS << "],\"replacements\":[";
+    bool First = true;
+    for (const tooling::Replacement &Replacement : Diag.Fix) {
+      OS << (First ? "{" : ",{") << "\"file\":";
+      First = false;
+      writeJSONString(Replacement.getFilePath(), OS);
+      OS << ",\"offset\":" << Replacement.getOffset()
+         << ",\"length\":" << Replacement.getLength() << ",\"text\":";
+      writeJSONString(Replacement.getReplacementText(), OS);
+      OS << "}";
+    }
+    OS << "]}";
+  }
+  OS << "]}\n";
   OS.flush();
 }
 
+// Serves lint requests read from stdin until the end of the input.
+static int runServer(std::unique_ptr<ClangTidyOptionsProvider> OptionsProvider,
+                     const CompilationDatabase &Compilations) {
+  ClangTidyServer Server(std::move(OptionsProvider), Compilations);
+  std::string Line;
+  while (std::getline(std::cin, Line)) {
+    if (StringRef(Line).trim().empty())
+      continue;
+    ServerRequest Request;
+    std::string Error;
+    std::vector<ClangTidyError> Errors;
+    if (parseServerRequest(Line, Request, Error)) {
+      llvm::Optional<StringRef> Content, Checks;
+      if (Request.Content)
+        Content = StringRef(*Request.Content);
+      if (Request.Checks)
+        Checks = StringRef(*Request.Checks);
+      if (!Server.run(Request.File, Content, Checks, Errors))
+        Error = "error while processing " + Request.File;
+    }
+    writeServerResponse(Request, Errors, Error, llvm::outs());
+  }
+  if (Server.getNumCommands())
+    llvm::errs() << "Parsed " << Server.getNumPreambleCommands() << " of "
+                 << Server.getNumCommands()
+                 << " compile commands with a precompiled preamble.\n";
+  return 0;
+}
+
 static std::unique_ptr<ClangTidyOptionsProvider> createOptionsProvider() {
   ClangTidyGlobalOptions GlobalOptions;
   if (std::error_code Err = parseLineFilter(LineFilter, GlobalOptions)) {
@@ -259,6 +714,18 @@ static std::unique_ptr<ClangTidyOptionsProvider> createOptionsProvider() {
     llvm::cl::PrintHelpMessage(/*Hidden=*/false, /*Categorized=*/true);
     return nullptr;
   }
+  if (isDiffMode() && !parseDiff(GlobalOptions))
+    return nullptr;
+  GlobalOptions.Jobs = Jobs;
+  GlobalOptions.MatchThreads = MatchThreads;
+  GlobalOptions.CacheDirectory = CacheDirectory;
+  GlobalOptions.AnalyzeHeadersOnce = AnalyzeHeadersOnce;
+  // Diagnostics outside the changed lines aren't displayed in diff mode.
+  GlobalOptions.PruneFilteredCode = PruneFilteredCode || isDiffMode();
+  GlobalOptions.TranslationUnitTimeBudget = TranslationUnitTimeBudget;
+  GlobalOptions.CheckTimeBudget = CheckTimeBudget;
+  GlobalOptions.HistoryFile = HistoryFile;
+  GlobalOptions.MemoryLimit = uint64_t(MemoryLimit) * 1024 * 1024;
 
   ClangTidyOptions DefaultOptions;
   DefaultOptions.Checks = DefaultChecks;
@@ -300,7 +767,26 @@ static std::unique_ptr<ClangTidyOptionsProvider> createOptionsProvider() {
                                                 OverrideOptions);
 }
 
+// Parses the -shard argument of the form "i/n".
+static bool parseShard(StringRef Text, unsigned &Index, unsigned &Count) {
+  StringRef IndexText, CountText;
+  std::tie(IndexText, CountText) = Text.split('/');
+  if (IndexText.getAsInteger(10, Index) || CountText.getAsInteger(10, Count) ||
+      Count == 0 || Index >= Count) {
+    llvm::errs() << "Error: invalid -shard=" << Text
+                 << ", expected i/n with 0 <= i < n.\n";
+    return false;
+  }
+  return true;
+}
+
 static int clangTidyMain(int argc, const char **argv) {
+  // CommonOptionsParser removes the compiler arguments after "--".
+  bool HasFixedCompilations =
+      std::find_if(argv, argv + argc, [](const char *Arg) {
+        return StringRef(Arg) == "--";
+      }) != argv + argc;
+  std::string BuildPath = getBuildPath(argc, argv);
   CommonOptionsParser OptionsParser(argc, argv, ClangTidyCategory,
                                     cl::ZeroOrMore);
 
@@ -353,12 +839,75 @@ static int clangTidyMain(int argc, const char **argv) {
     return 0;
   }
 
+  if (Server) {
+    // Without source files, CommonOptionsParser only loads compilation
+    // databases given after "--".
+    if (!PathList.empty() || HasFixedCompilations)
+      return runServer(std::move(OptionsProvider),
+                       OptionsParser.getCompilations());
+    std::unique_ptr<CompilationDatabase> Compilations =
+        detectCompilationDatabase(BuildPath);
+    if (!Compilations)
+      return 1;
+    return runServer(std::move(OptionsProvider), *Compilations);
+  }
+
   if (EnabledChecks.empty()) {
     llvm::errs() << "Error: no checks enabled.\n";
     llvm::cl::PrintHelpMessage(/*Hidden=*/false, /*Categorized=*/true);
     return 1;
   }
 
+  unsigned ShardIndex = 0, ShardCount = 1;
+  if (!Shard.empty() && !parseShard(Shard, ShardIndex, ShardCount))
+    return 1;
+
+  const CompilationDatabase *Compilations = nullptr;
+  std::unique_ptr<CompilationDatabase> DetectedCompilations;
+  if (isDiffMode()) {
+    const std::vector<FileFilter> &Changes =
+        OptionsProvider->getGlobalOptions().LineFilter;
+    if (Changes.empty()) {
+      llvm::errs() << "No changed lines found.\n";
+      return 0;
+    }
+    if (PathList.empty()) {
+      DetectedCompilations = detectCompilationDatabase(BuildPath);
+      if (!DetectedCompilations)
+        return 1;
+      Compilations = DetectedCompilations.get();
+      PathList = Compilations->getAllFiles();
+    } else {
+      Compilations = &OptionsParser.getCompilations();
+    }
+    PathList =
+        getAffectedFiles(*OptionsProvider, *Compilations, PathList, Changes);
+    if (PathList.empty()) {
+      llvm::errs() << "No translation units affected by the changes.\n";
+      return 0;
+    }
+  }
+
+  if (!Shard.empty()) {
+    if (PathList.empty() && !HasFixedCompilations) {
+      DetectedCompilations = detectCompilationDatabase(BuildPath);
+      if (!DetectedCompilations)
+        return 1;
+      Compilations = DetectedCompilations.get();
+      PathList = Compilations->getAllFiles();
+    }
+    // All shards must see the same costs, so use the history as it was before
+    // this run.
+    if (!PathList.empty()) {
+      PathList = selectShard(PathList, ClangTidyHistory(HistoryFile),
+                             ShardIndex, ShardCount);
+      if (PathList.empty()) {
+        llvm::errs() << "No source files in shard " << Shard << ".\n";
+        return 0;
+      }
+    }
+  }
+
   if (PathList.empty()) {
     llvm::errs() << "Error: no input files specified.\n";
     llvm::cl::PrintHelpMessage(/*Hidden=*/false, /*Categorized=*/true);
@@ -366,33 +915,50 @@ static int clangTidyMain(int argc, const char **argv) {
   }
 
   ProfileData Profile;
+  bool EnableProfile =
+      EnableCheckProfile || !ProfileTrace.empty() || !ProfileSummary.empty();
+
+  // Errors are displayed as each file is processed. Without -fix-errors, -fix
+  // only applies fixes if there are no compiler errors in any file, so the
+  // errors are only displayed when all files are processed.
+  bool DeferDisplay = Fix && !FixErrors;
+  MultiplexErrorSink Sinks;
+  std::unique_ptr<ReplacementsExportSink> Export;
+  if (!ExportFixes.empty()) {
+    Export = llvm::make_unique<ReplacementsExportSink>(ExportFixes);
+    Sinks.addSink(Export.get());
+  }
+  std::unique_ptr<SpillingErrorSink> Spill;
+  std::unique_ptr<ErrorDisplaySink> Display;
+  if (DeferDisplay) {
+    Spill = llvm::make_unique<SpillingErrorSink>();
+    Sinks.addSink(Spill.get());
+  } else {
+    // -fix-errors implies -fix.
+    Display = llvm::make_unique<ErrorDisplaySink>(FixErrors);
+    Sinks.addSink(Display.get());
+  }
 
-  std::vector<ClangTidyError> Errors;
+  if (!Compilations)
+    Compilations = &OptionsParser.getCompilations();
   ClangTidyStats Stats =
-      runClangTidy(std::move(OptionsProvider), OptionsParser.getCompilations(),
-                   PathList, &Errors,
-                   EnableCheckProfile ? &Profile : nullptr);
-  bool FoundErrors =
-      std::find_if(Errors.begin(), Errors.end(), [](const ClangTidyError &E) {
-        return E.DiagLevel == ClangTidyError::Error;
-      }) != Errors.end();
-
-  const bool DisableFixes = Fix && FoundErrors && !FixErrors;
-
-  unsigned WErrorCount = 0;
-
-  // -fix-errors implies -fix.
-  handleErrors(Errors, (FixErrors || Fix) && !DisableFixes, WErrorCount);
-
-  if (!ExportFixes.empty() && !Errors.empty()) {
-    std::error_code EC;
-    llvm::raw_fd_ostream OS(ExportFixes, EC, llvm::sys::fs::F_None);
-    if (EC) {
-      llvm::errs() << "Error opening output file: " << EC.message() << '\n';
+      runClangTidy(std::move(OptionsProvider), *Compilations, PathList, Sinks,
+                   EnableProfile ? &Profile : nullptr);
+
+  bool DisableFixes = false;
+  if (DeferDisplay) {
+    DisableFixes = Spill->hasCompilerErrors();
+    Display = llvm::make_unique<ErrorDisplaySink>(!DisableFixes);
+    if (!Spill->replay(*Display))
       return 1;
-    }
-    exportReplacements(Errors, OS);
   }
+  bool FixesWritten = Display->finish();
+  unsigned WErrorCount = Display->getWarningsAsErrorsCount();
+
+  if (Export && !Export->finish())
+    return 1;
+  if (!FixesWritten)
+    return 1;
 
   printStats(Stats);
   if (DisableFixes)
@@ -402,6 +968,12 @@ static int clangTidyMain(int argc, const char **argv) {
 
   if (EnableCheckProfile)
     printProfileData(Profile, llvm::errs());
+  if (!ProfileTrace.empty() &&
+      !writeProfile(ProfileTrace, Profile, writeProfileTrace))
+    return 1;
+  if (!ProfileSummary.empty() &&
+      !writeProfile(ProfileSummary, Profile, writeProfileSummary))
+    return 1;
 
   if (WErrorCount) {
     StringRef Plural = WErrorCount == 1 ? "" : "s";
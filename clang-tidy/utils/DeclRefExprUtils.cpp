@@ -8,90 +8,91 @@
 //===----------------------------------------------------------------------===//
 
 #include "DeclRefExprUtils.h"
-#include "clang/AST/ASTContext.h"
 #include "clang/AST/DeclCXX.h"
-#include "clang/ASTMatchers/ASTMatchFinder.h"
-#include "llvm/ADT/SmallPtrSet.h"
+#include "clang/AST/ExprCXX.h"
 
 namespace clang {
 namespace tidy {
 namespace utils {
 namespace decl_ref_expr {
 
-using namespace ::clang::ast_matchers;
-using llvm::SmallPtrSet;
-
 namespace {
 
-template <typename S> bool isSetDifferenceEmpty(const S &S1, const S &S2) {
-  for (const auto &E : S1)
-    if (S2.count(E) == 0)
-      return false;
-  return true;
+// Returns true if a parameter of Type can't be used to modify its argument.
+bool isConstReferenceOrValue(QualType Type) {
+  if (const auto *Ref = dyn_cast<ReferenceType>(Type.getTypePtr()))
+    return Ref->getPointeeType().isConstQualified();
+  return !isa<PointerType>(Type.getTypePtr());
 }
 
-// Extracts all Nodes keyed by ID from Matches and inserts them into Nodes.
-template <typename Node>
-void extractNodesByIdTo(ArrayRef<BoundNodes> Matches, StringRef ID,
-                        SmallPtrSet<const Node *, 16> &Nodes) {
-  for (const auto &Match : Matches)
-    Nodes.insert(Match.getNodeAs<Node>(ID));
+// Returns true if Arg, ignoring parentheses and casts, is passed to a const
+// reference or value parameter of Callee in a call with the arguments Args.
+bool isConstReferenceOrValueArgument(const FunctionDecl *Callee,
+                                     ArrayRef<const Expr *> Args,
+                                     const Expr *Arg) {
+  if (!Callee)
+    return false;
+  for (unsigned I = 0, E = Args.size(); I != E; ++I)
+    if (Args[I]->IgnoreParenCasts() == Arg && I < Callee->getNumParams() &&
+        isConstReferenceOrValue(Callee->getParamDecl(I)->getType()))
+      return true;
+  return false;
 }
 
-// Finds all DeclRefExprs to VarDecl in Stmt.
-SmallPtrSet<const DeclRefExpr *, 16>
-declRefExprs(const VarDecl &VarDecl, const Stmt &Stmt, ASTContext &Context) {
-  auto Matches = match(
-      findAll(declRefExpr(to(varDecl(equalsNode(&VarDecl)))).bind("declRef")),
-      Stmt, Context);
-  SmallPtrSet<const DeclRefExpr *, 16> DeclRefs;
-  extractNodesByIdTo(Matches, "declRef", DeclRefs);
-  return DeclRefs;
-}
+// Returns true if DeclRef is used as a const method's implicit object argument
+// or a const reference or value argument in the call or construction S.
+bool isConstUseIn(const Stmt *S, const DeclRefExpr *DeclRef) {
+  if (const auto *Construct = dyn_cast<CXXConstructExpr>(S))
+    return isConstReferenceOrValueArgument(
+        Construct->getConstructor(),
+        llvm::makeArrayRef(Construct->getArgs(), Construct->getNumArgs()),
+        DeclRef);
 
-// Finds all DeclRefExprs where a const method is called on VarDecl or VarDecl
-// is the a const reference or value argument to a CallExpr or CXXConstructExpr.
-SmallPtrSet<const DeclRefExpr *, 16>
-constReferenceDeclRefExprs(const VarDecl &VarDecl, const Stmt &Stmt,
-                           ASTContext &Context) {
-  auto DeclRefToVar =
-      declRefExpr(to(varDecl(equalsNode(&VarDecl)))).bind("declRef");
-  auto ConstMethodCallee = callee(cxxMethodDecl(isConst()));
-  // Match method call expressions where the variable is referenced as the this
-  // implicit object argument and opertor call expression for member operators
-  // where the variable is the 0-th argument.
-  auto Matches = match(
-      findAll(expr(anyOf(cxxMemberCallExpr(ConstMethodCallee, on(DeclRefToVar)),
-                         cxxOperatorCallExpr(ConstMethodCallee,
-                                             hasArgument(0, DeclRefToVar))))),
-      Stmt, Context);
-  SmallPtrSet<const DeclRefExpr *, 16> DeclRefs;
-  extractNodesByIdTo(Matches, "declRef", DeclRefs);
-  auto ConstReferenceOrValue =
-      qualType(anyOf(referenceType(pointee(qualType(isConstQualified()))),
-                     unless(anyOf(referenceType(), pointerType()))));
-  auto UsedAsConstRefOrValueArg = forEachArgumentWithParam(
-      DeclRefToVar, parmVarDecl(hasType(ConstReferenceOrValue)));
-  Matches = match(findAll(callExpr(UsedAsConstRefOrValueArg)), Stmt, Context);
-  extractNodesByIdTo(Matches, "declRef", DeclRefs);
-  Matches =
-      match(findAll(cxxConstructExpr(UsedAsConstRefOrValueArg)), Stmt, Context);
-  extractNodesByIdTo(Matches, "declRef", DeclRefs);
-  return DeclRefs;
+  const auto *Call = dyn_cast<CallExpr>(S);
+  if (!Call)
+    return false;
+  const auto *Method = dyn_cast_or_null<CXXMethodDecl>(Call->getCalleeDecl());
+  if (Method && Method->isConst()) {
+    if (const auto *MemberCall = dyn_cast<CXXMemberCallExpr>(Call)) {
+      const Expr *Object = MemberCall->getImplicitObjectArgument();
+      if (Object && Object->IgnoreParenImpCasts() == DeclRef)
+        return true;
+    }
+    if (isa<CXXOperatorCallExpr>(Call) && Call->getNumArgs() > 0 &&
+        Call->getArg(0)->IgnoreParenImpCasts() == DeclRef)
+      return true;
+  }
+  ArrayRef<const Expr *> Args(Call->getArgs(), Call->getNumArgs());
+  // The first argument of a member operator is the implicit object argument,
+  // which has no parameter.
+  if (isa<CXXOperatorCallExpr>(Call) && Method)
+    Args = Args.drop_front();
+  return isConstReferenceOrValueArgument(
+      dyn_cast_or_null<FunctionDecl>(Call->getCalleeDecl()), Args, DeclRef);
 }
 
 } // namespace
 
 bool isOnlyUsedAsConst(const VarDecl &Var, const Stmt &Stmt,
-                       ASTContext &Context) {
-  // Collect all DeclRefExprs to the loop variable and all CallExprs and
-  // CXXConstructExprs where the loop variable is used as argument to a const
-  // reference parameter.
-  // If the difference is empty it is safe for the loop variable to be a const
-  // reference.
-  auto AllDeclRefs = declRefExprs(Var, Stmt, Context);
-  auto ConstReferenceDeclRefs = constReferenceDeclRefExprs(Var, Stmt, Context);
-  return isSetDifferenceEmpty(AllDeclRefs, ConstReferenceDeclRefs);
+                       const ASTIndex &Index) {
+  // Check that each DeclRefExpr to the variable in Stmt is either the object
+  // of a const method call or an argument to a const reference or value
+  // parameter of a call or construction in Stmt. Such uses are always within
+  // the expression containing the DeclRefExpr.
+  for (const DeclRefExpr *DeclRef : Index.getDeclRefs(&Var)) {
+    if (!Index.isDescendant(DeclRef, &Stmt))
+      continue;
+    bool IsConstUse = false;
+    for (const clang::Stmt *S = DeclRef; S && !IsConstUse;
+         S = Index.getParent(S)) {
+      IsConstUse = isConstUseIn(S, DeclRef);
+      if (S == &Stmt || !isa<Expr>(S))
+        break;
+    }
+    if (!IsConstUse)
+      return false;
+  }
+  return true;
 }
 
 } // namespace decl_ref_expr
@@ -10,7 +10,7 @@
 #ifndef LLVM_CLANG_TOOLS_EXTRA_CLANG_TIDY_UTILS_DECLREFEXPRUTILS_H
 #define LLVM_CLANG_TOOLS_EXTRA_CLANG_TIDY_UTILS_DECLREFEXPRUTILS_H
 
-#include "clang/AST/ASTContext.h"
+#include "../ClangTidyASTIndex.h"
 #include "clang/AST/Type.h"
 
 namespace clang {
@@ -24,7 +24,7 @@ namespace decl_ref_expr {
 /// Returns true if only const methods or operators are called on the variable
 /// or the variable is a const reference or value argument to a callExpr().
 bool isOnlyUsedAsConst(const VarDecl &Var, const Stmt &Stmt,
-                       ASTContext &Context);
+                       const ASTIndex &Index);
 
 } // namespace decl_ref_expr
 } // namespace utils
@@ -16,13 +16,12 @@ namespace tidy {
 namespace utils {
 namespace fixit {
 
-FixItHint changeVarDeclToReference(const VarDecl &Var, ASTContext &Context) {
+FixItHint changeVarDeclToReference(const VarDecl &Var,
+                                   const TokenBuffer &Tokens) {
   SourceLocation AmpLocation = Var.getLocation();
-  auto Token = utils::lexer::getPreviousNonCommentToken(Context, AmpLocation);
+  auto Token = utils::lexer::getPreviousNonCommentToken(Tokens, AmpLocation);
   if (!Token.is(tok::unknown))
-    AmpLocation = Lexer::getLocForEndOfToken(Token.getLocation(), 0,
-                                             Context.getSourceManager(),
-                                             Context.getLangOpts());
+    AmpLocation = Token.getLocation().getLocWithOffset(Token.getLength());
   return FixItHint::CreateInsertion(AmpLocation, "&");
 }
 
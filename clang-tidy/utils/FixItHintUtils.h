@@ -10,6 +10,7 @@
 #ifndef LLVM_CLANG_TOOLS_EXTRA_CLANG_TIDY_UTILS_FIXITHINTUTILS_H
 #define LLVM_CLANG_TOOLS_EXTRA_CLANG_TIDY_UTILS_FIXITHINTUTILS_H
 
+#include "../ClangTidyTokenBuffer.h"
 #include "clang/AST/ASTContext.h"
 #include "clang/AST/Decl.h"
 
@@ -18,8 +19,10 @@ namespace tidy {
 namespace utils {
 namespace fixit {
 
-/// \brief Creates fix to make VarDecl a reference by adding '&'.
-FixItHint changeVarDeclToReference(const VarDecl &Var, ASTContext &Context);
+/// \brief Creates fix to make VarDecl a reference by adding '&'. \p Tokens
+/// are the tokens of the file containing the declaration.
+FixItHint changeVarDeclToReference(const VarDecl &Var,
+                                   const TokenBuffer &Tokens);
 
 /// \brief Creates fix to make VarDecl const qualified.
 FixItHint changeVarDeclToConst(const VarDecl &Var);
@@ -8,6 +8,8 @@
 //===----------------------------------------------------------------------===//
 
 #include "IncludeInserter.h"
+#include "clang/Frontend/CompilerInstance.h"
+#include "clang/Lex/Preprocessor.h"
 #include "clang/Lex/Token.h"
 
 namespace clang {
@@ -40,8 +42,17 @@ IncludeInserter::IncludeInserter(const SourceManager &SourceMgr,
                                  IncludeSorter::IncludeStyle Style)
     : SourceMgr(SourceMgr), LangOpts(LangOpts), Style(Style) {}
 
+IncludeInserter::IncludeInserter(CompilerInstance &Compiler,
+                                 IncludeSorter::IncludeStyle Style)
+    : IncludeInserter(Compiler.getSourceManager(), Compiler.getLangOpts(),
+                      Style) {
+  Compiler.getPreprocessor().addPPCallbacks(CreatePPCallbacks());
+}
+
 IncludeInserter::~IncludeInserter() {}
 
+const char IncludeInserter::ID = 0;
+
 std::unique_ptr<PPCallbacks> IncludeInserter::CreatePPCallbacks() {
   return llvm::make_unique<IncludeInserterCallback>(this);
 }
@@ -49,36 +60,43 @@ std::unique_ptr<PPCallbacks> IncludeInserter::CreatePPCallbacks() {
 llvm::Optional<FixItHint>
 IncludeInserter::CreateIncludeInsertion(FileID FileID, StringRef Header,
                                         bool IsAngled) {
-  // We assume the same Header will never be included both angled and not
-  // angled.
-  if (!InsertedHeaders[FileID].insert(Header).second)
-    return llvm::None;
+  return CreateIncludeInsertion(FileID, Header, IsAngled, Style);
+}
 
-  if (IncludeSorterByFile.find(FileID) == IncludeSorterByFile.end()) {
-    // This may happen if there have been no preprocessor directives in this
-    // file.
-    IncludeSorterByFile.insert(std::make_pair(
-        FileID,
-        llvm::make_unique<IncludeSorter>(
-            &SourceMgr, &LangOpts, FileID,
-            SourceMgr.getFilename(SourceMgr.getLocForStartOfFile(FileID)),
-            Style)));
-  }
-  return IncludeSorterByFile[FileID]->CreateIncludeInsertion(Header, IsAngled);
+llvm::Optional<FixItHint>
+IncludeInserter::CreateIncludeInsertion(FileID FileID, StringRef Header,
+                                        bool IsAngled,
+                                        IncludeSorter::IncludeStyle Style) {
+  return getIncludeSorter(FileID, Style)
+      .CreateIncludeInsertion(Header, IsAngled);
+}
+
+IncludeSorter &
+IncludeInserter::getIncludeSorter(FileID FileID,
+                                  IncludeSorter::IncludeStyle Style) {
+  std::unique_ptr<IncludeSorter> &Sorter =
+      IncludeSorters[std::make_pair(FileID, Style)];
+  if (Sorter)
+    return *Sorter;
+  // The file may have no inclusion directives at all.
+  Sorter = llvm::make_unique<IncludeSorter>(
+      &SourceMgr, &LangOpts, FileID,
+      SourceMgr.getFilename(SourceMgr.getLocForStartOfFile(FileID)), Style);
+  for (const Inclusion &I : InclusionsByFile.lookup(FileID))
+    Sorter->AddInclude(I.FileName, I.IsAngled, I.HashLocation, I.EndLocation);
+  return *Sorter;
 }
 
 void IncludeInserter::AddInclude(StringRef FileName, bool IsAngled,
                                  SourceLocation HashLocation,
                                  SourceLocation EndLocation) {
   FileID FileID = SourceMgr.getFileID(HashLocation);
-  if (IncludeSorterByFile.find(FileID) == IncludeSorterByFile.end()) {
-    IncludeSorterByFile.insert(std::make_pair(
-        FileID, llvm::make_unique<IncludeSorter>(
-                    &SourceMgr, &LangOpts, FileID,
-                    SourceMgr.getFilename(HashLocation), Style)));
-  }
-  IncludeSorterByFile[FileID]->AddInclude(FileName, IsAngled, HashLocation,
-                                          EndLocation);
+  InclusionsByFile[FileID].push_back(
+      {FileName.str(), IsAngled, HashLocation, EndLocation});
+  // Sorters created before this directive was seen are kept up to date.
+  for (auto &Entry : IncludeSorters)
+    if (Entry.first.first == FileID)
+      Entry.second->AddInclude(FileName, IsAngled, HashLocation, EndLocation);
 }
 
 } // namespace utils
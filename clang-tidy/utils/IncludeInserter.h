@@ -10,15 +10,21 @@
 #ifndef LLVM_CLANG_TOOLS_EXTRA_CLANG_TIDY_INCLUDEINSERTER_H
 #define LLVM_CLANG_TOOLS_EXTRA_CLANG_TIDY_INCLUDEINSERTER_H
 
+#include "../ClangTidyDiagnosticConsumer.h"
 #include "IncludeSorter.h"
 #include "clang/Basic/Diagnostic.h"
 #include "clang/Basic/LangOptions.h"
 #include "clang/Basic/SourceManager.h"
 #include "clang/Lex/PPCallbacks.h"
+#include <map>
 #include <memory>
 #include <string>
+#include <vector>
 
 namespace clang {
+
+class CompilerInstance;
+
 namespace tidy {
 namespace utils {
 
@@ -26,10 +32,7 @@ namespace utils {
 // class MyCheck : public ClangTidyCheck {
 //  public:
 //   void registerPPCallbacks(CompilerInstance& Compiler) override {
-//     Inserter.reset(new IncludeInserter(&Compiler.getSourceManager(),
-//                                        &Compiler.getLangOpts()));
-//     Compiler.getPreprocessor().addPPCallbacks(
-//         Inserter->CreatePPCallback());
+//     Inserter = &getSharedState<IncludeInserter>(Compiler, IncludeStyle);
 //   }
 //
 //   void registerMatchers(ast_matchers::MatchFinder* Finder) override { ... }
@@ -38,19 +41,33 @@ namespace utils {
 //     ...
 //     Inserter->CreateIncludeInsertion(
 //         Result.SourceManager->getMainFileID(), "path/to/Header.h",
-//         /*IsAngled=*/false);
+//         /*IsAngled=*/false, IncludeStyle);
 //     ...
 //   }
 //
 //  private:
-//   std::unique_ptr<IncludeInserter> Inserter;
+//   IncludeInserter *Inserter;
+//   const IncludeSorter::IncludeStyle IncludeStyle;
 // };
-class IncludeInserter {
+//
+// The inserter returned by getSharedState is shared by all checks of the
+// translation unit, so the include directives of each file are recorded once.
+// Every diagnostic gets its own insertion; identical insertions are merged when
+// the fixes are applied or exported.
+class IncludeInserter : public ClangTidySharedState {
 public:
   IncludeInserter(const SourceManager &SourceMgr, const LangOptions &LangOpts,
                   IncludeSorter::IncludeStyle Style);
+  // Creates an inserter that records the include directives of the
+  // preprocessor of Compiler.
+  IncludeInserter(CompilerInstance &Compiler,
+                  IncludeSorter::IncludeStyle Style);
   ~IncludeInserter();
 
+  // Identifies the inserter shared by checks, see
+  // ClangTidyContext::getSharedState.
+  static const char ID;
+
   // Create PPCallbacks for registration with the compiler's preprocessor.
   std::unique_ptr<PPCallbacks> CreatePPCallbacks();
 
@@ -59,12 +76,31 @@ public:
   llvm::Optional<FixItHint>
   CreateIncludeInsertion(FileID FileID, llvm::StringRef Header, bool IsAngled);
 
+  // Same as above, but places the inclusion directive according to Style
+  // instead of the style of the inserter.
+  llvm::Optional<FixItHint>
+  CreateIncludeInsertion(FileID FileID, llvm::StringRef Header, bool IsAngled,
+                         IncludeSorter::IncludeStyle Style);
+
 private:
+  struct Inclusion {
+    std::string FileName;
+    bool IsAngled;
+    SourceLocation HashLocation;
+    SourceLocation EndLocation;
+  };
+
   void AddInclude(StringRef FileName, bool IsAngled,
                   SourceLocation HashLocation, SourceLocation EndLocation);
+  IncludeSorter &getIncludeSorter(FileID FileID,
+                                  IncludeSorter::IncludeStyle Style);
 
-  llvm::DenseMap<FileID, std::unique_ptr<IncludeSorter>> IncludeSorterByFile;
-  llvm::DenseMap<FileID, std::set<std::string>> InsertedHeaders;
+  // The inclusion directives of each file, recorded once for all styles.
+  llvm::DenseMap<FileID, std::vector<Inclusion>> InclusionsByFile;
+  // The sorters of each file and style, created on first use.
+  std::map<std::pair<FileID, IncludeSorter::IncludeStyle>,
+           std::unique_ptr<IncludeSorter>>
+      IncludeSorters;
   const SourceManager &SourceMgr;
   const LangOptions &LangOpts;
   const IncludeSorter::IncludeStyle Style;
@@ -8,31 +8,43 @@
 //===----------------------------------------------------------------------===//
 
 #include "LexerUtils.h"
+#include "clang/Basic/SourceManager.h"
 
 namespace clang {
 namespace tidy {
 namespace utils {
 namespace lexer {
 
-Token getPreviousNonCommentToken(const ASTContext &Context,
+Token getPreviousNonCommentToken(const TokenBuffer &Tokens,
                                  SourceLocation Location) {
-  const auto &SourceManager = Context.getSourceManager();
-  Token Token;
-  Token.setKind(tok::unknown);
-  Location = Location.getLocWithOffset(-1);
-  auto StartOfFile =
-      SourceManager.getLocForStartOfFile(SourceManager.getFileID(Location));
-  while (Location != StartOfFile) {
-    Location = Lexer::GetBeginningOfToken(Location, SourceManager,
-                                          Context.getLangOpts());
-    if (!Lexer::getRawToken(Location, Token, SourceManager,
-                            Context.getLangOpts()) &&
-        !Token.is(tok::comment)) {
-      break;
-    }
-    Location = Location.getLocWithOffset(-1);
+  Token NotFound;
+  NotFound.startToken();
+  NotFound.setKind(tok::unknown);
+  ArrayRef<Token> AllTokens = Tokens.tokens();
+  size_t I = Tokens.findToken(Location);
+  if (I == AllTokens.size())
+    return NotFound;
+  // Include the token containing Location, if Location is not at its start.
+  if (AllTokens[I].getLocation() < Location)
+    ++I;
+  while (I > 0) {
+    --I;
+    if (!AllTokens[I].is(tok::comment))
+      return AllTokens[I];
   }
-  return Token;
+  return NotFound;
+}
+
+SourceLocation getLocForEndOfToken(const TokenBuffer &Tokens,
+                                   SourceLocation Location) {
+  const Token *Tok = Tokens.getTokenAt(Location);
+  if (!Tok)
+    return SourceLocation();
+  return Tok->getLocation().getLocWithOffset(Tok->getLength());
+}
+
+StringRef getTokenText(const Token &Tok, const SourceManager &SM) {
+  return StringRef(SM.getCharacterData(Tok.getLocation()), Tok.getLength());
 }
 
 } // namespace lexer
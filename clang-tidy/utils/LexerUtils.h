@@ -10,7 +10,7 @@
 #ifndef LLVM_CLANG_TOOLS_EXTRA_CLANG_TIDY_UTILS_LEXER_UTILS_H
 #define LLVM_CLANG_TOOLS_EXTRA_CLANG_TIDY_UTILS_LEXER_UTILS_H
 
-#include "clang/AST/ASTContext.h"
+#include "../ClangTidyTokenBuffer.h"
 #include "clang/Lex/Lexer.h"
 
 namespace clang {
@@ -19,10 +19,19 @@ namespace utils {
 namespace lexer {
 
 // Returns previous non-comment token skipping over any comment text or
-// tok::unknown if not found.
-Token getPreviousNonCommentToken(const ASTContext &Context,
+// tok::unknown if not found. \p Tokens are the tokens of the file containing
+// \p Location.
+Token getPreviousNonCommentToken(const TokenBuffer &Tokens,
                                  SourceLocation Location);
 
+// Returns the location just past the token containing \p Location, or an
+// invalid location if there is no such token in \p Tokens.
+SourceLocation getLocForEndOfToken(const TokenBuffer &Tokens,
+                                   SourceLocation Location);
+
+// Returns the text of \p Tok, which must be a token of a file in \p SM.
+StringRef getTokenText(const Token &Tok, const SourceManager &SM);
+
 } // namespace lexer
 } // namespace utils
 } // namespace tidy
@@ -0,0 +1,2 @@
+#include "semicolon.h"
+int y = undeclared;
@@ -0,0 +1 @@
+#include "semicolon.h"
@@ -0,0 +1,2 @@
+class A { A(int); };
+inline bool isNull(int *p) { return p == 0; }
@@ -0,0 +1,2 @@
+#include "../header.h"
+class D { D(int); };
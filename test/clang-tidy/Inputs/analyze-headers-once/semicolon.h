@@ -0,0 +1,4 @@
+inline void increment(int &x) {
+  if (x);
+    x++;
+}
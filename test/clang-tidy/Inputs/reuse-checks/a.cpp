@@ -0,0 +1,2 @@
+namespace n {}
+namespace unused_in_a = n;
@@ -0,0 +1,3 @@
+namespace m { int i; }
+namespace used_in_b = m;
+int j = used_in_b::i;
@@ -0,0 +1,28 @@
+// RUN: clang-tidy -checks='-*,google-explicit-constructor' -header-filter='.*' %S/Inputs/analyze-headers-once/a.cpp %S/Inputs/analyze-headers-once/b.cpp -- 2>&1 | FileCheck -check-prefix=CHECK-ALL %s
+// RUN: clang-tidy -checks='-*,google-explicit-constructor' -header-filter='.*' -analyze-headers-once %S/Inputs/analyze-headers-once/a.cpp %S/Inputs/analyze-headers-once/b.cpp -- 2>&1 | FileCheck %s
+// RUN: clang-tidy -checks='-*,google-explicit-constructor' -header-filter='.*' -analyze-headers-once -j=2 %S/Inputs/analyze-headers-once/a.cpp %S/Inputs/analyze-headers-once/b.cpp -- 2>&1 | FileCheck %s
+// RUN: clang-tidy -header-filter='.*' -analyze-headers-once %S/Inputs/analyze-headers-once/a.cpp %S/Inputs/analyze-headers-once/other/c.cpp -- 2>&1 | FileCheck -check-prefix=CHECK-CONFIG %s
+// RUN: clang-tidy -checks='-*,misc-suspicious-semicolon' -header-filter='.*' -analyze-headers-once %S/Inputs/analyze-headers-once/broken.cpp %S/Inputs/analyze-headers-once/fixed.cpp -- 2>&1 | FileCheck -check-prefix=CHECK-FAILED %s
+
+// CHECK: header.h:1:11: warning: single-argument constructors must be marked explicit
+// CHECK: a.cpp:2:11: warning: single-argument constructors must be marked explicit
+// CHECK-NOT: header.h:1:11: warning
+// CHECK: b.cpp:2:11: warning: single-argument constructors must be marked explicit
+// CHECK-NOT: header.h:1:11: warning
+
+// Without -analyze-headers-once, each translation unit reports the header.
+// CHECK-ALL: header.h:1:11: warning: single-argument constructors must be marked explicit
+// CHECK-ALL: a.cpp:2:11: warning: single-argument constructors must be marked explicit
+// CHECK-ALL: header.h:1:11: warning: single-argument constructors must be marked explicit
+// CHECK-ALL: b.cpp:2:11: warning: single-argument constructors must be marked explicit
+
+// A translation unit with another configuration analyzes the header again.
+// CHECK-CONFIG: header.h:1:11: warning: single-argument constructors must be marked explicit
+// CHECK-CONFIG: a.cpp:2:11: warning: single-argument constructors must be marked explicit
+// CHECK-CONFIG: header.h:2:{{[0-9]+}}: warning: use nullptr
+// CHECK-CONFIG: c.cpp:2:11: warning: single-argument constructors must be marked explicit
+
+// A translation unit that fails to compile releases the headers it claimed,
+// here without reporting a diagnostic in them, so the next one analyzes them.
+// CHECK-FAILED: broken.cpp:2:9: error: use of undeclared identifier 'undeclared'
+// CHECK-FAILED: semicolon.h:2:{{[0-9]+}}: warning: potentially unintended semicolon
@@ -0,0 +1,33 @@
+// REQUIRES: shell
+// RUN: rm -rf %T/cache-directory
+// RUN: mkdir -p %T/cache-directory
+// RUN: echo '#include "header.h"' > %T/cache-directory/main.cpp
+// RUN: echo 'int *P = 0;' >> %T/cache-directory/main.cpp
+// RUN: echo 'int *H = 0;' > %T/cache-directory/header.h
+// RUN: clang-tidy -checks='-*,modernize-use-nullptr' -header-filter='.*' -cache-directory=%T/cache-directory/cache %T/cache-directory/main.cpp -- 2>&1 | FileCheck --check-prefix=CHECK-MISS %s
+// RUN: clang-tidy -checks='-*,modernize-use-nullptr' -header-filter='.*' -cache-directory=%T/cache-directory/cache %T/cache-directory/main.cpp -- 2>&1 | FileCheck --check-prefix=CHECK-HIT %s
+// RUN: echo 'int *H2 = 0;' >> %T/cache-directory/header.h
+// RUN: clang-tidy -checks='-*,modernize-use-nullptr' -header-filter='.*' -cache-directory=%T/cache-directory/cache %T/cache-directory/main.cpp -- 2>&1 | FileCheck --check-prefix=CHECK-CHANGED %s
+// RUN: clang-tidy -checks='-*,modernize-use-nullptr' -header-filter='' -cache-directory=%T/cache-directory/cache %T/cache-directory/main.cpp -- 2>&1 | FileCheck --check-prefix=CHECK-OPTIONS %s
+// RUN: echo 'int *B = undeclared;' > %T/cache-directory/broken.cpp
+// RUN: clang-tidy -checks='-*,modernize-use-nullptr' -cache-directory=%T/cache-directory/cache %T/cache-directory/broken.cpp -- 2>&1 | FileCheck --check-prefix=CHECK-FAILED %s
+
+// CHECK-MISS: header.h:1:10: warning: use nullptr
+// CHECK-MISS: main.cpp:2:10: warning: use nullptr
+// CHECK-MISS: Reused cached results for 0 of 1 compile commands.
+
+// CHECK-HIT: header.h:1:10: warning: use nullptr
+// CHECK-HIT: main.cpp:2:10: warning: use nullptr
+// CHECK-HIT: Reused cached results for 1 of 1 compile commands.
+
+// CHECK-CHANGED: header.h:2:11: warning: use nullptr
+// CHECK-CHANGED: Reused cached results for 0 of 1 compile commands.
+
+// CHECK-OPTIONS-NOT: header.h
+// CHECK-OPTIONS: main.cpp:2:10: warning: use nullptr
+// CHECK-OPTIONS: Suppressed 2 warnings (2 in non-user code)
+// CHECK-OPTIONS: Reused cached results for 0 of 1 compile commands.
+
+// Failed runs aren't stored, but they are still counted as misses.
+// CHECK-FAILED: broken.cpp:1:10: error: use of undeclared identifier 'undeclared'
+// CHECK-FAILED: Reused cached results for 0 of 1 compile commands.
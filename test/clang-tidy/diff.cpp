@@ -0,0 +1,20 @@
+// RUN: clang-tidy -checks='-*,google-explicit-constructor' -header-filter='.*' -diff=%S/Inputs/diff/source.diff %s -- -I %S/Inputs/diff 2>&1 | FileCheck %s
+// RUN: clang-tidy -checks='-*,google-explicit-constructor' -header-filter='.*' -diff=%S/Inputs/diff/header.diff %s -- -I %S/Inputs/diff 2>&1 | FileCheck --check-prefix=CHECK-HEADER %s
+// RUN: clang-tidy -checks='-*,google-explicit-constructor' -header-filter='.*' -diff=%S/Inputs/diff/unrelated.diff %s -- -I %S/Inputs/diff 2>&1 | FileCheck --check-prefix=CHECK-UNRELATED %s
+// RUN: not clang-tidy -checks='-*,google-explicit-constructor' -line-filter='[]' -diff=%S/Inputs/diff/source.diff %s -- 2>&1 | FileCheck --check-prefix=CHECK-LINE-FILTER %s
+// RUN: not clang-tidy -checks='-*,google-explicit-constructor' -diff-strip=0 -diff-revisions=HEAD %s -- 2>&1 | FileCheck --check-prefix=CHECK-STRIP %s
+
+#include "header.h"
+// CHECK-NOT: header.h:{{.*}} warning
+// CHECK-HEADER: header.h:2:12: warning: single-argument constructors must be marked explicit
+// CHECK-HEADER-NOT: warning:
+
+class A { A(int); };
+// CHECK-NOT: :[[@LINE-1]]:{{.*}} warning
+class B { B(int); };
+// CHECK: :[[@LINE-1]]:11: warning: single-argument constructors must be marked explicit
+// CHECK-NOT: warning:
+
+// CHECK-UNRELATED: No translation units affected by the changes.
+// CHECK-LINE-FILTER: Error: -line-filter can't be used together with -diff or -diff-revisions.
+// CHECK-STRIP: Error: -diff-strip can't be used together with -diff-revisions.
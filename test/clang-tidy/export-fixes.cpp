@@ -0,0 +1,40 @@
+// RUN: clang-tidy %s -checks='-*,google-explicit-constructor,llvm-namespace-comment' -export-fixes=%t.yaml -- > %t.msg 2>&1
+// RUN: FileCheck -input-file=%t.yaml %s
+// RUN: rm -rf %t.cache
+// RUN: clang-tidy %s -checks='-*,google-explicit-constructor,llvm-namespace-comment' -export-fixes=%t.yaml -cache-directory=%t.cache -- > %t.msg 2>&1
+// RUN: FileCheck -input-file=%t.yaml %s
+// RUN: rm -rf %t.dir && mkdir -p %t.dir
+// RUN: grep -Ev "// *[A-Z-]+:" %s > %t.dir/a.cpp
+// RUN: grep -Ev "// *[A-Z-]+:" %s > %t.dir/b.cpp
+// RUN: clang-tidy %t.dir/a.cpp %t.dir/b.cpp -checks='-*,google-explicit-constructor' -export-fixes=%t.dir/fixes.yaml -- > %t.msg 2>&1
+// RUN: FileCheck -check-prefix=CHECK-TWO -input-file=%t.dir/fixes.yaml %s
+// RUN: clang-apply-replacements %t.dir
+// RUN: FileCheck -check-prefix=CHECK-APPLIED -input-file=%t.dir/a.cpp %s
+// RUN: FileCheck -check-prefix=CHECK-APPLIED -input-file=%t.dir/b.cpp %s
+
+namespace i {
+}
+
+class A { A(int i); };
+
+// CHECK: ---
+// CHECK-NEXT: MainSourceFile: ''
+// CHECK-NEXT: Replacements:
+// CHECK-NEXT: - FilePath: '{{.*}}export-fixes.cpp'
+// CHECK-NEXT: Offset:
+// CHECK-NEXT: Length: 0
+// CHECK-NEXT: ReplacementText: ' // namespace i'
+// CHECK-NEXT: - FilePath: '{{.*}}export-fixes.cpp'
+// CHECK-NEXT: Offset:
+// CHECK-NEXT: Length: 0
+// CHECK-NEXT: ReplacementText: 'explicit '
+// CHECK-NEXT: ...
+
+// The fixes of all translation units are written as a single document.
+// CHECK-TWO: ---
+// CHECK-TWO: ReplacementText: 'explicit '
+// CHECK-TWO-NOT: ---
+// CHECK-TWO: ReplacementText: 'explicit '
+// CHECK-TWO-NEXT: ...
+// CHECK-TWO-NOT: ---
+// CHECK-APPLIED: class A { explicit A(int i); };
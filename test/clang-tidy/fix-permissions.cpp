@@ -0,0 +1,10 @@
+// REQUIRES: shell
+// RUN: grep -Ev "// *[A-Z-]+:" %s > %t.cpp
+// RUN: chmod 755 %t.cpp
+// RUN: clang-tidy %t.cpp -checks='-*,google-explicit-constructor' -fix -- > %t.msg 2>&1
+// RUN: FileCheck -input-file=%t.cpp %s
+// RUN: test -x %t.cpp
+
+// A fixed file keeps the permissions of the original.
+class A { A(int i); };
+// CHECK: class A { explicit A(int i); };
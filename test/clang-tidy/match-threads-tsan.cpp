@@ -0,0 +1,22 @@
+// REQUIRES: tsan
+// RUN: env TSAN_OPTIONS=halt_on_error=1 clang-tidy -checks='-*,google-readability-casting,misc-bool-pointer-implicit-conversion,misc-swapped-arguments,modernize-use-nullptr,readability-else-after-return,readability-braces-around-statements' -match-threads=4 %s -- 2>&1 | FileCheck %s -implicit-check-not='ThreadSanitizer'
+
+// The checks that can match concurrently are spread over four groups. A data
+// race between their matchers makes ThreadSanitizer abort the run.
+void g(int x, double y);
+
+int f(int *p, bool *b, double d) {
+  if (b)
+    return 1;
+  // CHECK: :[[@LINE-2]]:7: warning: dubious check of 'bool *' against 'nullptr'
+  g(d, 1);
+  // CHECK: :[[@LINE-1]]:3: warning: argument with implicit conversion from 'double' to 'int' followed by argument converted from 'int' to 'double', potentially swapped arguments.
+  if (p == 0) {
+    return (int)d;
+  } else {
+    return 0;
+  }
+  // CHECK: :[[@LINE-5]]:12: warning: use nullptr
+  // CHECK: :[[@LINE-5]]:12: warning: C-style casts are discouraged
+  // CHECK: :[[@LINE-5]]:5: warning: don't use else after return
+}
@@ -0,0 +1,16 @@
+// RUN: clang-tidy -checks='-*,misc-unused-alias-decls,modernize-use-nullptr,readability-braces-around-statements,google-readability-casting' -match-threads=4 %s -- 2>&1 | FileCheck %s -implicit-check-not='{{warning:|error:}}'
+
+// Checks matched on worker threads and checks matched on the main thread report
+// the same diagnostics as in a serial run.
+namespace n {}
+namespace unused = n;
+// CHECK: :[[@LINE-1]]:11: warning: namespace alias decl 'unused' is unused
+
+int f(int *p, double d) {
+  if (p == 0)
+    return (int)d;
+  // CHECK: :[[@LINE-2]]:12: warning: use nullptr
+  // CHECK: :[[@LINE-3]]:{{[0-9]+}}: warning: statement should be inside braces
+  // CHECK: :[[@LINE-3]]:12: warning: C-style casts are discouraged
+  return 0;
+}
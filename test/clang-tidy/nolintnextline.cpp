@@ -0,0 +1,34 @@
+// RUN: %check_clang_tidy %s google-explicit-constructor,clang-diagnostic-unused-variable %t -- -extra-arg=-Wunused-variable --
+
+// NOLINTNEXTLINE
+class A { A(int i); };
+
+// NOLINTNEXTLINE(for-some-other-check)
+class B { B(int i); };
+// CHECK-MESSAGES: :[[@LINE-1]]:11: warning: single-argument constructors must be marked explicit
+
+// NOLINTNEXTLINE(google-explicit-constructor)
+class C { C(int i); };
+
+// NOLINTNEXTLINE
+// Only the next line is suppressed.
+class D { D(int i); };
+// CHECK-MESSAGES: :[[@LINE-1]]:11: warning: single-argument constructors must be marked explicit
+
+// NOLINTBEGIN(google-explicit-constructor)
+class E { E(int i); };
+void f() {
+  int i;
+// CHECK-MESSAGES: :[[@LINE-1]]:7: warning: unused variable 'i' [clang-diagnostic-unused-variable]
+}
+// NOLINTEND(google-explicit-constructor)
+
+class F { F(int i); };
+// CHECK-MESSAGES: :[[@LINE-1]]:11: warning: single-argument constructors must be marked explicit
+
+// NOLINTBEGIN
+class G { G(int i); };
+void g() { int j; }
+// NOLINTEND
+
+// CHECK-MESSAGES: Suppressed 5 warnings (5 NOLINT)
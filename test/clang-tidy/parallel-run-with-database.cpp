@@ -0,0 +1,22 @@
+// REQUIRES: shell
+// RUN: mkdir -p %T/parallel-test/include
+// RUN: mkdir -p %T/parallel-test/a
+// RUN: mkdir -p %T/parallel-test/b
+// RUN: echo 'int *AA = 0;' > %T/parallel-test/a/a.cpp
+// RUN: echo 'int *AB = 0;' > %T/parallel-test/a/b.cpp
+// RUN: echo 'int *BB = 0;' > %T/parallel-test/b/b.cpp
+// RUN: echo 'int *BC = 0;' > %T/parallel-test/b/c.cpp
+// RUN: echo 'int *HP = 0;' > %T/parallel-test/include/header.h
+// RUN: echo '#include "header.h"' > %T/parallel-test/b/d.cpp
+// RUN: mkdir -p %T/parallel-test/db
+// RUN: sed 's|test_dir|%T/parallel-test|g' %S/Inputs/compilation-database/template.json > %T/parallel-test/db/compile_commands.json
+// RUN: clang-tidy --checks=-*,modernize-use-nullptr -p %T/parallel-test/db %T/parallel-test/a/a.cpp %T/parallel-test/a/b.cpp %T/parallel-test/b/b.cpp %T/parallel-test/b/c.cpp %T/parallel-test/b/d.cpp -header-filter=.* > %T/parallel-test/serial.txt
+// RUN: clang-tidy --checks=-*,modernize-use-nullptr -p %T/parallel-test/db %T/parallel-test/a/a.cpp %T/parallel-test/a/b.cpp %T/parallel-test/b/b.cpp %T/parallel-test/b/c.cpp %T/parallel-test/b/d.cpp -header-filter=.* -j=3 > %T/parallel-test/parallel.txt
+// RUN: diff %T/parallel-test/serial.txt %T/parallel-test/parallel.txt
+// RUN: FileCheck -input-file=%T/parallel-test/parallel.txt %s
+
+// CHECK: a.cpp:1:11: warning: use nullptr
+// CHECK: b.cpp:1:11: warning: use nullptr
+// CHECK: b.cpp:1:11: warning: use nullptr
+// CHECK: c.cpp:1:11: warning: use nullptr
+// CHECK: header.h:1:11: warning: use nullptr
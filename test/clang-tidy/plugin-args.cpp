@@ -0,0 +1,16 @@
+// RUN: c-index-test -test-load-source-reparse 2 all %s -Xclang -add-plugin -Xclang clang-tidy -Xclang -plugin-arg-clang-tidy -Xclang -checks='-*,google-explicit-constructor' -Xclang -plugin-arg-clang-tidy -Xclang -warnings-as-errors='*' -Xclang -plugin-arg-clang-tidy -Xclang -export-fixes=%t.yaml 2>&1 | FileCheck %s
+// RUN: FileCheck -input-file=%t.yaml -check-prefix=CHECK-YAML %s
+// RUN: c-index-test -test-load-source-reparse 2 all %s -Xclang -add-plugin -Xclang clang-tidy -Xclang -plugin-arg-clang-tidy -Xclang -checks='-*,google-explicit-constructor' -Xclang -plugin-arg-clang-tidy -Xclang -export-fixes=%t/missing/fixes.yaml 2>&1 | FileCheck -check-prefix=CHECK-EXPORT %s
+
+struct A {
+  A(int);
+  // CHECK: :[[@LINE-1]]:3: error: single-argument constructors must be marked explicit {{.*}} [google-explicit-constructor,-warnings-as-errors]
+};
+
+struct B {
+  B(int); // NOLINT
+};
+// CHECK-NOT: :[[@LINE-2]]:3:
+
+// CHECK-YAML: ReplacementText: 'explicit '
+// CHECK-EXPORT: error: can't write clang-tidy fixes to '{{.*}}fixes.yaml'
@@ -0,0 +1,27 @@
+// RUN: clang-tidy %s -checks='-*,google-explicit-constructor' -profile-trace=%t.json -profile-summary=%t.yaml -- > %t.msg 2>&1
+// RUN: FileCheck -input-file=%t.json -check-prefix=CHECK-TRACE %s
+// RUN: FileCheck -input-file=%t.yaml -check-prefix=CHECK-SUMMARY %s
+// RUN: rm -rf %t.cache
+// RUN: clang-tidy %s -checks='-*,google-explicit-constructor' -profile-trace=%t.json -cache-directory=%t.cache -- > %t.msg 2>&1
+// RUN: FileCheck -input-file=%t.json -check-prefix=CHECK-TRACE %s
+
+class A { A(int i); };
+
+// CHECK-TRACE: {"traceEvents":[
+// CHECK-TRACE-NEXT: {"name":"{{.*}}profile.cpp","cat":"File","ph":"X","pid":0,"tid":0,"ts":0,"dur":{{[0-9]+}},"args":{"memory":{{[1-9][0-9]*}}}},
+// CHECK-TRACE-NEXT: {"name":"Parsing","cat":"Phase"
+// CHECK-TRACE-NEXT: {"name":"Matching","cat":"Phase",{{.*}}"args":{"google-explicit-constructor":{{[0-9]+}}}},
+// CHECK-TRACE-NEXT: {"name":"Diagnostics","cat":"Phase"
+// CHECK-TRACE-NEXT: ],"displayTimeUnit":"ms"}
+
+// CHECK-SUMMARY: Checks:
+// CHECK-SUMMARY-NEXT: - Name: google-explicit-constructor
+// CHECK-SUMMARY: Phases:
+// CHECK-SUMMARY-DAG: - Name: Parsing
+// CHECK-SUMMARY-DAG: - Name: Matching
+// CHECK-SUMMARY-DAG: - Name: Diagnostics
+// CHECK-SUMMARY: Rendering:
+// CHECK-SUMMARY: Files:
+// CHECK-SUMMARY-NEXT: - File: {{.*}}profile.cpp
+// CHECK-SUMMARY-NEXT: Wall:
+// CHECK-SUMMARY-NEXT: Memory: {{[1-9][0-9]*}}
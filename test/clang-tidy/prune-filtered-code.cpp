@@ -0,0 +1,25 @@
+// RUN: clang-tidy -checks='-*,google-explicit-constructor' -header-filter='header2\.h' -prune-filtered-code %s -- -I %S/Inputs/file-filter -isystem %S/Inputs/file-filter/system 2>&1 | FileCheck %s
+// RUN: clang-tidy -checks='-*,google-explicit-constructor' -header-filter='.*' -line-filter='[{"name":"prune-filtered-code.cpp","lines":[[18,19]]}]' -prune-filtered-code %s -- -I %S/Inputs/file-filter -isystem %S/Inputs/file-filter/system 2>&1 | FileCheck --check-prefix=CHECK2 %s
+
+#include "header1.h"
+// CHECK-NOT: header1.h:{{.*}} warning
+// CHECK2-NOT: header1.h:{{.*}} warning
+
+#include "header2.h"
+// CHECK: header2.h:1:12: warning: single-argument constructors
+// CHECK2-NOT: header2.h:{{.*}} warning
+
+#include <system-header.h>
+
+class A { A(int); };
+// CHECK: :[[@LINE-1]]:11: warning: single-argument constructors
+// CHECK2-NOT: :[[@LINE-2]]:{{.*}} warning
+class B {
+  B(int);
+// CHECK: :[[@LINE-1]]:3: warning: single-argument constructors
+// CHECK2: :[[@LINE-2]]:3: warning: single-argument constructors
+};
+
+// Warnings in pruned code are never produced, so they aren't counted.
+// CHECK-NOT: Suppressed
+// CHECK2-NOT: Suppressed
@@ -0,0 +1,5 @@
+// RUN: clang-tidy -checks='-*,misc-unused-alias-decls' %S/Inputs/reuse-checks/a.cpp %S/Inputs/reuse-checks/b.cpp -- 2>&1 | FileCheck %s -implicit-check-not='{{warning:|error:}}'
+
+// The check is reused for both files, and must not report the matches of the
+// first one again.
+// CHECK: a.cpp:2:11: warning: namespace alias decl 'unused_in_a' is unused
@@ -0,0 +1,38 @@
+// RUN: echo '{"id":1,"file":"%s"}' > %t.in
+// RUN: echo '{"id":2,"file":"%s"}' >> %t.in
+// RUN: echo '{"id":3,"file":"%s","content":"#include \"Inputs/server-preamble/a.h\"\nstruct C { C(A a); };"}' >> %t.in
+// RUN: echo '{"id":4,"file":"%s","content":"struct D { D(int i); };"}' >> %t.in
+// RUN: echo '{"id":5,"file":"%s","checks":"-*,modernize-pass-by-value"}' >> %t.in
+// RUN: echo '{"id":6,"file":"%s","checks":"-*,modernize-pass-by-value"}' >> %t.in
+// RUN: clang-tidy -server -checks='-*,google-explicit-constructor' -- -std=c++11 < %t.in 2> %t.err | FileCheck %s
+// RUN: FileCheck -check-prefix=CHECK-STATS -input-file=%t.err %s
+
+#include "Inputs/server-preamble/a.h"
+
+class B { B(A a); };
+
+struct Movable {
+  Movable(const Movable &) {}
+  Movable(Movable &&) {}
+};
+
+struct P {
+  P(const Movable &M, int) : M(M) {}
+  Movable M;
+};
+
+// The second request reuses the preamble of the first one, and must report the
+// same diagnostics.
+// CHECK: {"id":1,"diagnostics":[{"check":"google-explicit-constructor",{{.*}}"file":"{{.*}}server-preamble.cpp"{{.*}}}]}
+// CHECK-NEXT: {"id":2,"diagnostics":[{"check":"google-explicit-constructor",{{.*}}"file":"{{.*}}server-preamble.cpp"{{.*}}}]}
+// CHECK-NEXT: {"id":3,"diagnostics":[{"check":"google-explicit-constructor",{{.*}}"offset":49,{{.*}}}]}
+// CHECK-NEXT: {"id":4,"diagnostics":[{"check":"google-explicit-constructor",{{.*}}"offset":11,{{.*}}}]}
+
+// The inclusion directives of the preamble are replayed to the checks that
+// insert includes, so the sixth request inserts <utility> after them too.
+// CHECK-NEXT: {"id":5,"diagnostics":[{"check":"modernize-pass-by-value",{{.*}}"offset":[[OFFSET:[1-9][0-9]*]],"length":0,"text":"#include <utility>\u000a"}
+// CHECK-NEXT: {"id":6,"diagnostics":[{"check":"modernize-pass-by-value",{{.*}}"offset":[[OFFSET]],"length":0,"text":"#include <utility>\u000a"}
+
+// Requests 2, 3 and 6 reuse a preamble. The fourth request has none, and the
+// first and fifth ones are the first with their set of checks.
+// CHECK-STATS: Parsed 3 of 6 compile commands with a precompiled preamble.
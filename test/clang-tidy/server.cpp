@@ -0,0 +1,20 @@
+// RUN: echo '{"id":1,"file":"%s"}' > %t.in
+// RUN: echo '{"id":"two","file":"%s","checks":"-*,llvm-namespace-comment"}' >> %t.in
+// RUN: echo '{"id":3,"file":"%s","content":"struct B { B(int i); };"}' >> %t.in
+// RUN: echo '{"id":4}' >> %t.in
+// RUN: echo 'not json' >> %t.in
+// RUN: echo "{\"id\":'five',\"file\":\"%s\",\"content\":\"\"}" >> %t.in
+// RUN: echo '{"id":true,"file":"%s"}' >> %t.in
+// RUN: clang-tidy -server -checks='-*,google-explicit-constructor,llvm-namespace-comment' -- < %t.in | FileCheck %s
+
+namespace n {
+class A { A(int i); };
+}
+
+// CHECK: {"id":1,"diagnostics":[{"check":"google-explicit-constructor","level":"warning","message":"single-argument constructors must be marked explicit to avoid unintentional implicit conversions","file":"{{.*}}server.cpp","offset":{{[0-9]+}},"notes":[],"replacements":[{"file":"{{.*}}server.cpp","offset":{{[0-9]+}},"length":0,"text":"explicit "}]},{"check":"llvm-namespace-comment",{{.*}}}]}
+// CHECK-NEXT: {"id":"two","diagnostics":[{"check":"llvm-namespace-comment",{{.*}}}]}
+// CHECK-NEXT: {"id":3,"diagnostics":[{"check":"google-explicit-constructor",{{.*}}"offset":11,{{.*}}}]}
+// CHECK-NEXT: {"id":4,"error":"no \"file\" given","diagnostics":[]}
+// CHECK-NEXT: {"id":null,"error":"request is not a JSON object","diagnostics":[]}
+// CHECK-NEXT: {"id":"five","diagnostics":[]}
+// CHECK-NEXT: {"id":null,"error":"request \"id\" must be a string or a number","diagnostics":[]}
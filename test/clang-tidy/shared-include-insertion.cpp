@@ -0,0 +1,40 @@
+// RUN: grep -Ev "// *[A-Z-]+:" %s > %t.cpp
+// RUN: clang-tidy %t.cpp -checks='-*,misc-move-constructor-init,modernize-pass-by-value' -fix -export-fixes=%t.yaml -- -std=c++11 -isystem %S/Inputs/Headers > %t.msg 2>&1
+// RUN: FileCheck -input-file=%t.cpp %s
+// RUN: FileCheck -input-file=%t.yaml -check-prefix=CHECK-YAML %s
+// RUN: grep -Ev "// *[A-Z-]+:" %s | sed -e 's|ByValue(Movable M) : M(M) {}|& // NOLINT|' > %t-nolint.cpp
+// RUN: clang-tidy %t-nolint.cpp -checks='-*,misc-move-constructor-init,modernize-pass-by-value' -fix -- -std=c++11 -isystem %S/Inputs/Headers > %t-nolint.msg 2>&1
+// RUN: FileCheck -input-file=%t-nolint.cpp -check-prefix=CHECK-NOLINT %s
+
+// Both checks insert <utility> with each diagnostic, and the identical
+// insertions are merged when the fixes are applied or exported. If the first
+// diagnostic is suppressed, the fix of the other one still inserts the header.
+
+#include <s.h>
+// CHECK: #include <s.h>
+// CHECK: #include <utility>
+// CHECK-NOT: #include <utility>
+// CHECK-YAML: #include <utility>
+// CHECK-YAML-NOT: #include <utility>
+// CHECK-NOLINT: #include <utility>
+// CHECK-NOLINT-NOT: #include <utility>
+
+struct Movable {
+  Movable() = default;
+  Movable(const Movable &) {}
+  Movable(Movable &&) {}
+};
+
+struct ByValue {
+  ByValue(Movable M) : M(M) {}
+  Movable M;
+};
+// CHECK: ByValue(Movable M) : M(std::move(M)) {}
+// CHECK-NOLINT: ByValue(Movable M) : M(M) {} // NOLINT
+
+struct ByConstRef {
+  ByConstRef(const Movable &M) : M(M) {}
+  Movable M;
+};
+// CHECK: ByConstRef(Movable M) : M(std::move(M)) {}
+// CHECK-NOLINT: ByConstRef(Movable M) : M(std::move(M)) {}
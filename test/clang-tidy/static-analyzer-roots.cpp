@@ -0,0 +1,21 @@
+// RUN: clang-tidy %s -checks='-*,clang-analyzer-cplusplus.NewDelete' -line-filter='[{"name":"static-analyzer-roots.cpp","lines":[[5,9]]}]' -- 2>&1 | FileCheck --check-prefix=CHECK-ALL %s
+// RUN: clang-tidy %s -checks='-*,clang-analyzer-cplusplus.NewDelete' -line-filter='[{"name":"static-analyzer-roots.cpp","lines":[[5,9]]}]' -prune-filtered-code -- 2>&1 | FileCheck %s
+// RUN: clang-tidy %s -checks='-*,clang-analyzer-cplusplus.NewDelete' -line-filter='[{"name":"static-analyzer-roots.cpp","lines":[[5,9]]}]' -config='{CheckOptions: [{key: clang-analyzer-user-code-roots, value: true}]}' -- 2>&1 | FileCheck %s
+
+void changed() {
+  int *p = new int(42);
+  delete p;
+  delete p;
+}
+// CHECK-ALL: :[[@LINE-2]]:3: warning: Attempt to free released memory
+// CHECK: :[[@LINE-3]]:3: warning: Attempt to free released memory
+
+void unchanged() {
+  int *q = new int(42);
+  delete q;
+  delete q;
+}
+
+// Paths starting in unchanged() are only explored without restricted roots.
+// CHECK-ALL: Suppressed 1 warnings (1 due to line filter)
+// CHECK-NOT: Suppressed
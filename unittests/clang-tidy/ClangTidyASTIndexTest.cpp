@@ -0,0 +1,70 @@
+#include "ClangTidyASTIndex.h"
+#include "clang/ASTMatchers/ASTMatchFinder.h"
+#include "clang/Frontend/ASTUnit.h"
+#include "clang/Tooling/Tooling.h"
+#include "gtest/gtest.h"
+
+namespace clang {
+namespace tidy {
+namespace test {
+
+using namespace ast_matchers;
+
+namespace {
+template <typename T> const T *getDecl(StringRef Name, ASTContext &Context) {
+  return selectFirst<T>("D",
+                        match(namedDecl(hasName(Name)).bind("D"), Context));
+}
+} // namespace
+
+TEST(ASTIndexTest, Calls) {
+  std::unique_ptr<ASTUnit> AST = tooling::buildASTFromCode(
+      "void f(int);\n"
+      "void g() { f(1); f(2); }\n"
+      "void h() { f(3); }");
+  ASTContext &Context = AST->getASTContext();
+  ASTIndex Index(Context);
+
+  const auto *F = getDecl<FunctionDecl>("f", Context);
+  const auto *G = getDecl<FunctionDecl>("g", Context);
+  ASSERT_TRUE(F != nullptr);
+  ASSERT_TRUE(G != nullptr);
+  EXPECT_EQ(3u, Index.getCalls(F).size());
+  EXPECT_TRUE(Index.getCalls(G).empty());
+
+  unsigned CallsInG = 0;
+  for (const CallExpr *Call : Index.getCalls(F))
+    if (Index.isDescendant(Call, G->getBody()))
+      ++CallsInG;
+  EXPECT_EQ(2u, CallsInG);
+}
+
+TEST(ASTIndexTest, DeclRefsAndParents) {
+  std::unique_ptr<ASTUnit> AST = tooling::buildASTFromCode(
+      "struct S { int M; };\n"
+      "int f(S s) { int x = s.M; return x + s.M; }");
+  ASTContext &Context = AST->getASTContext();
+  ASTIndex Index(Context);
+
+  const auto *Param = getDecl<ParmVarDecl>("s", Context);
+  const auto *Field = getDecl<FieldDecl>("M", Context);
+  const auto *X = getDecl<VarDecl>("x", Context);
+  ASSERT_TRUE(Param != nullptr);
+  ASSERT_TRUE(Field != nullptr);
+  ASSERT_TRUE(X != nullptr);
+  EXPECT_EQ(2u, Index.getDeclRefs(Param).size());
+  EXPECT_EQ(2u, Index.getMemberRefs(Field).size());
+  ASSERT_EQ(1u, Index.getDeclRefs(X).size());
+
+  const DeclStmt *XDecl = Index.getDeclParents().lookup(X);
+  ASSERT_TRUE(XDecl != nullptr);
+  EXPECT_TRUE(isa<CompoundStmt>(Index.getParent(XDecl)));
+  EXPECT_TRUE(Index.isDescendant(Index.getDeclRefs(X)[0],
+                                 Index.getParent(XDecl)));
+  EXPECT_FALSE(Index.isDescendant(Index.getParent(XDecl), XDecl));
+  EXPECT_TRUE(Index.getParent(Index.getParent(XDecl)) == nullptr);
+}
+
+} // namespace test
+} // namespace tidy
+} // namespace clang
@@ -1,6 +1,8 @@
 #include "ClangTidy.h"
 #include "ClangTidyTest.h"
+#include "llvm/Support/Timer.h"
 #include "gtest/gtest.h"
+#include <thread>
 
 namespace clang {
 namespace tidy {
@@ -29,6 +31,37 @@ TEST(ClangTidyDiagnosticConsumer, SortsErrors) {
   EXPECT_EQ("variable", Errors[1].Message.Message);
 }
 
+TEST(InternedString, Interning) {
+  InternedString Empty;
+  EXPECT_TRUE(Empty.empty());
+  EXPECT_EQ(Empty, InternedString::get(""));
+
+  std::string Path = "dir/file.cpp";
+  InternedString A = InternedString::get(Path);
+  Path[0] = 'D';
+  InternedString B = InternedString::get("dir/file.cpp");
+  EXPECT_EQ(A, B);
+  EXPECT_EQ("dir/file.cpp", A.str());
+  EXPECT_EQ(A.str().data(), B.str().data());
+
+  InternedString C = InternedString::get(Path);
+  EXPECT_NE(A, C);
+  EXPECT_TRUE(C < A);
+  EXPECT_FALSE(A < C);
+  EXPECT_FALSE(A < B);
+  EXPECT_TRUE(Empty < A);
+}
+
+TEST(InternedString, SameHandleOnEachThread) {
+  InternedString Main = InternedString::get("shared/file.cpp");
+  InternedString Other;
+  std::thread Thread(
+      [&Other] { Other = InternedString::get("shared/file.cpp"); });
+  Thread.join();
+  EXPECT_EQ(Main, Other);
+  EXPECT_EQ(Main.str().data(), Other.str().data());
+}
+
 TEST(GlobList, Empty) {
   GlobList Filter("");
 
@@ -82,6 +115,146 @@ TEST(GlobList, Complex) {
   EXPECT_TRUE(Filter.contains("asdfqwEasdf"));
 }
 
+TEST(GlobList, MayContainPrefix) {
+  GlobList Filter("-*,google-*,misc-unused-*,-llvm-*,cert-err58-cpp");
+
+  EXPECT_TRUE(Filter.mayContainPrefix("google-"));
+  EXPECT_TRUE(Filter.mayContainPrefix("misc-"));
+  EXPECT_TRUE(Filter.mayContainPrefix("cert-"));
+  EXPECT_FALSE(Filter.mayContainPrefix("llvm-"));
+  EXPECT_FALSE(Filter.mayContainPrefix("modernize-"));
+  EXPECT_FALSE(Filter.mayContainPrefix("clang-analyzer-"));
+  EXPECT_TRUE(GlobList("*").mayContainPrefix("clang-analyzer-"));
+  EXPECT_TRUE(GlobList("clang-*").mayContainPrefix("clang-analyzer-"));
+}
+
+TEST(GlobList, Wildcards) {
+  GlobList Filter("a*b*c,-*bb*");
+
+  EXPECT_TRUE(Filter.contains("abc"));
+  EXPECT_TRUE(Filter.contains("axxbxxc"));
+  EXPECT_TRUE(Filter.contains("abcbc"));
+  EXPECT_FALSE(Filter.contains("abbc"));
+  EXPECT_FALSE(Filter.contains("abcd"));
+  EXPECT_FALSE(Filter.contains("xabc"));
+}
+
+TEST(GlobList, RepeatedQueries) {
+  GlobList Filter("-*,google-*,-google-runtime-*");
+
+  for (int I = 0; I < 2; ++I) {
+    EXPECT_TRUE(Filter.contains("google-explicit-constructor"));
+    EXPECT_FALSE(Filter.contains("google-runtime-int"));
+    EXPECT_FALSE(Filter.contains("misc-unused-parameters"));
+  }
+}
+
+// Run with --gtest_also_run_disabled_tests to measure filtering with a long
+// check list.
+TEST(GlobList, DISABLED_Benchmark) {
+  std::string Globs = "-*";
+  std::vector<std::string> Names;
+  for (int I = 0; I < 150; ++I) {
+    Globs += (I % 3 ? ",module" : ",-module") + std::to_string(I) + "-*";
+    Names.push_back("module" + std::to_string(I) + "-check");
+  }
+
+  llvm::TimeRecord Start = llvm::TimeRecord::getCurrentTime(true);
+  unsigned Count = 0;
+  for (int Iteration = 0; Iteration < 1000; ++Iteration) {
+    GlobList Filter(Globs);
+    for (int Query = 0; Query < 100; ++Query)
+      for (const std::string &Name : Names)
+        Count += Filter.contains(Name);
+  }
+  llvm::TimeRecord Elapsed = llvm::TimeRecord::getCurrentTime(false);
+  Elapsed -= Start;
+  EXPECT_EQ(1000u * 100u * 100u, Count);
+  llvm::errs() << "GlobList: " << Elapsed.getWallTime() << "s\n";
+}
+
+TEST(NoLintIndex, SameLine) {
+  NoLintIndex Index("a\n"
+                    "b // NOLINT\n"
+                    "c // NOLINT(check-a, module-*)\n"
+                    "d // NOLINT(unclosed\n"
+                    "e // NOLINT()\n");
+  EXPECT_FALSE(Index.isSuppressed(1, "check-a"));
+  EXPECT_TRUE(Index.isSuppressed(2, "check-a"));
+  EXPECT_TRUE(Index.isSuppressed(3, "check-a"));
+  EXPECT_TRUE(Index.isSuppressed(3, "module-check"));
+  EXPECT_FALSE(Index.isSuppressed(3, "check-b"));
+  EXPECT_TRUE(Index.isSuppressed(4, "check-b"));
+  EXPECT_TRUE(Index.isSuppressed(5, "check-b"));
+  EXPECT_FALSE(Index.isSuppressed(6, "check-a"));
+}
+
+TEST(NoLintIndex, NextLine) {
+  NoLintIndex Index("// NOLINTNEXTLINE\n"
+                    "a\n"
+                    "// NOLINTNEXTLINE(check-a)\n"
+                    "b // NOLINT(check-b)\n");
+  EXPECT_FALSE(Index.isSuppressed(1, "check-a"));
+  EXPECT_TRUE(Index.isSuppressed(2, "check-a"));
+  EXPECT_FALSE(Index.isSuppressed(3, "check-a"));
+  EXPECT_TRUE(Index.isSuppressed(4, "check-a"));
+  EXPECT_TRUE(Index.isSuppressed(4, "check-b"));
+  EXPECT_FALSE(Index.isSuppressed(4, "check-c"));
+}
+
+TEST(NoLintIndex, Blocks) {
+  NoLintIndex Index("a\n"
+                    "// NOLINTBEGIN(check-a)\n"
+                    "b\n"
+                    "// NOLINTBEGIN(check-b)\n"
+                    "c\n"
+                    "// NOLINTEND(check-a)\n"
+                    "d\n"
+                    "// NOLINTEND(check-b)\n"
+                    "// NOLINTEND\n"
+                    "e\n"
+                    "// NOLINTBEGIN\n"
+                    "f\n");
+  EXPECT_FALSE(Index.isSuppressed(1, "check-a"));
+  EXPECT_TRUE(Index.isSuppressed(2, "check-a"));
+  EXPECT_TRUE(Index.isSuppressed(3, "check-a"));
+  EXPECT_FALSE(Index.isSuppressed(3, "check-b"));
+  EXPECT_TRUE(Index.isSuppressed(5, "check-a"));
+  EXPECT_TRUE(Index.isSuppressed(5, "check-b"));
+  EXPECT_TRUE(Index.isSuppressed(6, "check-a"));
+  EXPECT_FALSE(Index.isSuppressed(7, "check-a"));
+  EXPECT_TRUE(Index.isSuppressed(7, "check-b"));
+  EXPECT_TRUE(Index.isSuppressed(8, "check-b"));
+  EXPECT_FALSE(Index.isSuppressed(10, "check-b"));
+  EXPECT_TRUE(Index.isSuppressed(11, "check-c"));
+  EXPECT_TRUE(Index.isSuppressed(1000, "check-c"));
+}
+
+TEST(ClangTidyContext, CheckTimeBudget) {
+  ClangTidyGlobalOptions GlobalOptions;
+  GlobalOptions.CheckTimeBudget = 1;
+  ClangTidyContext Context(llvm::make_unique<DefaultOptionsProvider>(
+      GlobalOptions, ClangTidyOptions()));
+  Context.setCurrentFile("file.cpp");
+  EXPECT_TRUE(Context.hasTimeBudgets());
+
+  Context.addCheckTime("check-a", 0.6);
+  Context.addCheckTime("check-b", 0.6);
+  EXPECT_FALSE(Context.isOverTimeBudget("check-a"));
+  Context.addCheckTime("check-a", 0.6);
+  Context.addCheckTime("check-a", 0.6);
+  EXPECT_TRUE(Context.isOverTimeBudget("check-a"));
+  EXPECT_FALSE(Context.isOverTimeBudget("check-b"));
+  ASSERT_EQ(1u, Context.getErrors().size());
+  EXPECT_EQ("clang-tidy-budget", Context.getErrors()[0].CheckName);
+  EXPECT_EQ("file.cpp", Context.getErrors()[0].Message.FilePath);
+  EXPECT_EQ(1u, Context.getStats().TimeBudgetsExceeded);
+
+  // Budgets apply to each translation unit.
+  Context.setCurrentFile("other.cpp");
+  EXPECT_FALSE(Context.isOverTimeBudget("check-a"));
+}
+
 } // namespace test
 } // namespace tidy
 } // namespace clang
@@ -0,0 +1,75 @@
+#include "ClangTidyHistory.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/FileSystem.h"
+#include "gtest/gtest.h"
+#include <algorithm>
+
+namespace clang {
+namespace tidy {
+namespace test {
+
+TEST(ClangTidyHistory, EstimatesUnknownFiles) {
+  ClangTidyHistory History;
+  EXPECT_EQ(1, History.estimate("/a.cpp").Seconds);
+  History.record("/a.cpp", ClangTidyHistory::Cost(2, 100));
+  History.record("/b.cpp", ClangTidyHistory::Cost(4, 300));
+  EXPECT_EQ(2, History.estimate("/a.cpp").Seconds);
+  EXPECT_EQ(3, History.estimate("/c.cpp").Seconds);
+  EXPECT_EQ(200u, History.estimate("/c.cpp").Memory);
+  EXPECT_FALSE(History.lookup("/c.cpp"));
+}
+
+TEST(ClangTidyHistory, EstimatesAfterReplacedCosts) {
+  ClangTidyHistory History;
+  History.record("/a.cpp", ClangTidyHistory::Cost(2, 100));
+  History.record("/b.cpp", ClangTidyHistory::Cost(4, 300));
+  History.record("/a.cpp", ClangTidyHistory::Cost(6, 500));
+  EXPECT_EQ(5, History.estimate("/c.cpp").Seconds);
+  EXPECT_EQ(400u, History.estimate("/c.cpp").Memory);
+}
+
+TEST(ClangTidyHistory, SavesAndLoads) {
+  SmallString<128> Path;
+  ASSERT_FALSE(
+      llvm::sys::fs::createTemporaryFile("clang-tidy-history", "yaml", Path));
+  ClangTidyHistory History;
+  History.record("/a.cpp", ClangTidyHistory::Cost(1.5, 1024));
+  History.record("/b.cpp", ClangTidyHistory::Cost(0.5, 2048));
+  ASSERT_TRUE(History.save(Path));
+
+  ClangTidyHistory Loaded(Path);
+  llvm::Optional<ClangTidyHistory::Cost> A = Loaded.lookup("/a.cpp");
+  ASSERT_TRUE(A.hasValue());
+  EXPECT_EQ(1.5, A->Seconds);
+  EXPECT_EQ(1024u, A->Memory);
+  ASSERT_TRUE(Loaded.lookup("/b.cpp").hasValue());
+  EXPECT_EQ(1, Loaded.estimate("/c.cpp").Seconds);
+  llvm::sys::fs::remove(Path);
+}
+
+TEST(ClangTidyHistory, SelectShard) {
+  ClangTidyHistory History;
+  std::vector<std::string> Files;
+  for (const char *Name : {"/a.cpp", "/b.cpp", "/c.cpp", "/d.cpp", "/e.cpp"})
+    Files.push_back(Name);
+  History.record("/a.cpp", ClangTidyHistory::Cost(10, 0));
+  History.record("/b.cpp", ClangTidyHistory::Cost(6, 0));
+  History.record("/c.cpp", ClangTidyHistory::Cost(5, 0));
+  History.record("/d.cpp", ClangTidyHistory::Cost(3, 0));
+  History.record("/e.cpp", ClangTidyHistory::Cost(2, 0));
+
+  std::vector<std::string> First = selectShard(Files, History, 0, 2);
+  std::vector<std::string> Second = selectShard(Files, History, 1, 2);
+  EXPECT_EQ(std::vector<std::string>({"/a.cpp", "/d.cpp"}), First);
+  EXPECT_EQ(std::vector<std::string>({"/b.cpp", "/c.cpp", "/e.cpp"}), Second);
+
+  // The order of the input doesn't change the shards.
+  std::reverse(Files.begin(), Files.end());
+  EXPECT_EQ(std::vector<std::string>({"/d.cpp", "/a.cpp"}),
+            selectShard(Files, History, 0, 2));
+  EXPECT_TRUE(selectShard(Files, History, 0, 1).size() == Files.size());
+}
+
+} // namespace test
+} // namespace tidy
+} // namespace clang
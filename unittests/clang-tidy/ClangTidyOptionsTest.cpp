@@ -1,4 +1,8 @@
 #include "ClangTidyOptions.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
 #include "gtest/gtest.h"
 
 namespace clang {
@@ -53,6 +57,50 @@ TEST(ParseLineFilter, ValidFilter) {
   EXPECT_EQ(1000u, Options.LineFilter[2].LineRanges[0].second);
 }
 
+TEST(ParseUnifiedDiff, ChangedLines) {
+  ClangTidyGlobalOptions Options;
+  std::error_code Error = parseUnifiedDiff(
+      "diff --git a/dir/file1.cpp b/dir/file1.cpp\n"
+      "--- a/dir/file1.cpp\n"
+      "+++ b/dir/file1.cpp\n"
+      "@@ -3,2 +3,3 @@ void f() {\n"
+      " context\n"
+      "-removed\n"
+      "+++ added, not a header\n"
+      "+added\n"
+      "@@ -10 +11,0 @@\n"
+      "-removed\n"
+      "@@ -20,0 +20 @@\n"
+      "+added\n"
+      "--- a/file2.h\t2016-01-01 00:00:00\n"
+      "+++ b/file2.h\t2016-01-01 00:00:00\n"
+      "@@ -1 +0,0 @@\n"
+      "-removed\n"
+      "--- a/file3.h\n"
+      "+++ /dev/null\n"
+      "@@ -1 +0,0 @@\n"
+      "-removed\n",
+      1, Options);
+  EXPECT_FALSE(Error);
+  ASSERT_EQ(1u, Options.LineFilter.size());
+  EXPECT_EQ("dir/file1.cpp", Options.LineFilter[0].Name);
+  ASSERT_EQ(2u, Options.LineFilter[0].LineRanges.size());
+  EXPECT_EQ(3u, Options.LineFilter[0].LineRanges[0].first);
+  EXPECT_EQ(5u, Options.LineFilter[0].LineRanges[0].second);
+  EXPECT_EQ(20u, Options.LineFilter[0].LineRanges[1].first);
+  EXPECT_EQ(20u, Options.LineFilter[0].LineRanges[1].second);
+}
+
+TEST(ParseUnifiedDiff, InvalidDiff) {
+  ClangTidyGlobalOptions Options;
+  EXPECT_TRUE(!!parseUnifiedDiff("@@ -1 +1 @@\n", 0, Options));
+  EXPECT_TRUE(!!parseUnifiedDiff("+++ file.cpp\n@@ -a +1 @@\n", 0, Options));
+  EXPECT_TRUE(!!parseUnifiedDiff("+++ file.cpp\n", 1, Options));
+  EXPECT_TRUE(
+      !!parseUnifiedDiff("+++ file.cpp\n@@ -1,2 +1,2 @@\n+a\n", 0, Options));
+  EXPECT_TRUE(Options.LineFilter.empty());
+}
+
 TEST(ParseConfiguration, ValidConfiguration) {
   llvm::ErrorOr<ClangTidyOptions> Options =
       parseConfiguration("Checks: \"-*,misc-*\"\n"
@@ -66,6 +114,46 @@ TEST(ParseConfiguration, ValidConfiguration) {
   EXPECT_EQ("some.user", *Options->User);
 }
 
+static void writeFile(StringRef Path, StringRef Contents) {
+  std::error_code EC;
+  llvm::raw_fd_ostream OS(Path, EC, llvm::sys::fs::F_Text);
+  ASSERT_FALSE(EC);
+  OS << Contents;
+}
+
+TEST(FileOptionsProvider, SharesMergedOptions) {
+  SmallString<128> Root;
+  ASSERT_FALSE(llvm::sys::fs::createUniqueDirectory("clang-tidy-test", Root));
+  SmallString<128> Sub(Root);
+  llvm::sys::path::append(Sub, "sub");
+  ASSERT_FALSE(llvm::sys::fs::create_directory(Sub));
+  SmallString<128> Config(Root);
+  llvm::sys::path::append(Config, ".clang-tidy");
+  writeFile(Config, "Checks: 'misc-*'\n");
+
+  FileOptionsProvider Provider(ClangTidyGlobalOptions(), ClangTidyOptions(),
+                               ClangTidyOptions());
+  auto A = Provider.getMergedOptions((Root + "/a.cpp").str());
+  auto B = Provider.getMergedOptions((Root + "/b.cpp").str());
+  auto C = Provider.getMergedOptions((Sub + "/c.cpp").str());
+  EXPECT_EQ(A, B);
+  EXPECT_EQ(A, C);
+  EXPECT_EQ("misc-*", *A->Checks);
+  // Unset options are taken from the defaults.
+  EXPECT_TRUE(A->SystemHeaders.hasValue());
+
+  writeFile(Config, "Checks: 'google-*'\n");
+  Provider.refresh();
+  auto D = Provider.getMergedOptions((Root + "/a.cpp").str());
+  EXPECT_NE(A, D);
+  EXPECT_EQ("google-*", *D->Checks);
+  EXPECT_EQ("misc-*", *A->Checks);
+
+  llvm::sys::fs::remove(Config);
+  llvm::sys::fs::remove(Sub);
+  llvm::sys::fs::remove(Root);
+}
+
 } // namespace test
 } // namespace tidy
 } // namespace clang
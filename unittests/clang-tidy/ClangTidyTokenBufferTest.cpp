@@ -0,0 +1,46 @@
+#include "ClangTidyTokenBuffer.h"
+#include "utils/LexerUtils.h"
+#include "clang/Frontend/ASTUnit.h"
+#include "clang/Tooling/Tooling.h"
+#include "gtest/gtest.h"
+
+namespace clang {
+namespace tidy {
+namespace test {
+
+TEST(TokenBufferTest, Lookup) {
+  std::unique_ptr<ASTUnit> AST =
+      tooling::buildASTFromCode("int  x /* c */ = 1; // d\n");
+  const SourceManager &SM = AST->getSourceManager();
+  TokenBuffer Tokens(SM, SM.getMainFileID(), AST->getLangOpts());
+  SourceLocation Start = SM.getLocForStartOfFile(SM.getMainFileID());
+
+  ArrayRef<Token> AllTokens = Tokens.tokens();
+  ASSERT_EQ(8u, AllTokens.size());
+  EXPECT_TRUE(AllTokens[0].is(tok::raw_identifier));
+  EXPECT_TRUE(AllTokens[2].is(tok::comment));
+  EXPECT_TRUE(AllTokens[6].is(tok::comment));
+  EXPECT_TRUE(AllTokens[7].is(tok::eof));
+
+  // Inside 'int', in the whitespace after it and at 'x'.
+  EXPECT_EQ(0u, Tokens.findToken(Start.getLocWithOffset(1)));
+  EXPECT_EQ(1u, Tokens.findToken(Start.getLocWithOffset(4)));
+  EXPECT_EQ(1u, Tokens.findToken(Start.getLocWithOffset(5)));
+  EXPECT_TRUE(Tokens.getTokenAt(Start.getLocWithOffset(4)) == nullptr);
+  EXPECT_EQ(&AllTokens[1], Tokens.getTokenAt(Start.getLocWithOffset(5)));
+  EXPECT_EQ(7u, Tokens.findToken(Start.getLocWithOffset(25)));
+  EXPECT_EQ(AllTokens.size(), Tokens.findToken(SourceLocation()));
+
+  // The previous token of '=' skips the comment.
+  Token Previous = utils::lexer::getPreviousNonCommentToken(
+      Tokens, AllTokens[3].getLocation());
+  EXPECT_EQ(AllTokens[1].getLocation(), Previous.getLocation());
+  EXPECT_TRUE(utils::lexer::getPreviousNonCommentToken(
+                  Tokens, AllTokens[0].getLocation())
+                  .is(tok::unknown));
+  EXPECT_EQ("/* c */", utils::lexer::getTokenText(AllTokens[2], SM));
+}
+
+} // namespace test
+} // namespace tidy
+} // namespace clang